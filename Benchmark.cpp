@@ -0,0 +1,128 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+using Gfx::Benchmark;
+
+// min/mean/max and nearest-rank percentiles
+static nlohmann::json summarize(std::vector<double> samples) {
+    if (samples.empty()) {
+        return nlohmann::json::object();
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double p) {
+        auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+        return samples[std::max<size_t>(rank, 1) - 1];
+    };
+
+    double sum = 0.0;
+    for (auto sample : samples) {
+        sum += sample;
+    }
+
+    return {
+        { "min", samples.front() },
+        { "mean", sum / static_cast<double>(samples.size()) },
+        { "p50", percentile(50.0) },
+        { "p95", percentile(95.0) },
+        { "p99", percentile(99.0) },
+        { "max", samples.back() },
+    };
+}
+
+Benchmark::Benchmark(uint32_t warmupFrames, uint32_t measuredFrames) :
+    m_warmupFrames(warmupFrames),
+    m_measuredFrames(measuredFrames)
+{
+    m_frames.reserve(measuredFrames);
+}
+
+void Benchmark::addFrame(const FrameTiming& timing)
+{
+    if (timing.frame < m_warmupFrames || isFinished()) {
+        return;
+    }
+    if (!m_frames.empty() && timing.frame <= m_frames.back().frame) {
+        return;
+    }
+
+    m_frames.push_back(timing);
+}
+
+void Benchmark::writeReport(const std::string& path, const RHI& rhi, const nlohmann::json& scene) const
+{
+    nlohmann::json report{};
+    report["device"] = getDeviceInfo(rhi);
+    report["scene"] = scene;
+    report["warmupFrames"] = m_warmupFrames;
+    report["measuredFrames"] = m_frames.size();
+
+    // the passes are the same every frame, so the first frame names them
+    size_t passCount = m_frames.empty() ? 0 : m_frames.front().passes.size();
+
+    std::vector<double> frameCpu{}, frameGpu{};
+    std::vector<std::vector<double>> passCpu(passCount), passGpu(passCount);
+    auto samples = nlohmann::json::array();
+
+    for (const auto& frame : m_frames) {
+        frameCpu.push_back(frame.cpuMilliseconds);
+        frameGpu.push_back(frame.gpuMilliseconds);
+
+        auto passSamples = nlohmann::json::array();
+        for (size_t i = 0; i < passCount; ++i) {
+            passCpu[i].push_back(frame.passes[i].cpuMilliseconds);
+            passGpu[i].push_back(frame.passes[i].gpuMilliseconds);
+            passSamples.push_back({ { "cpuMilliseconds", frame.passes[i].cpuMilliseconds }, { "gpuMilliseconds", frame.passes[i].gpuMilliseconds } });
+        }
+
+        samples.push_back({
+            { "frame", frame.frame },
+            { "cpuMilliseconds", frame.cpuMilliseconds },
+            { "gpuMilliseconds", frame.gpuMilliseconds },
+            { "passes", std::move(passSamples) },
+        });
+    }
+
+    report["frame"] = {
+        { "cpuMilliseconds", summarize(frameCpu) },
+        { "gpuMilliseconds", summarize(frameGpu) },
+    };
+
+    auto passes = nlohmann::json::array();
+    for (size_t i = 0; i < passCount; ++i) {
+        passes.push_back({
+            { "name", m_frames.front().passes[i].name },
+            { "cpuMilliseconds", summarize(passCpu[i]) },
+            { "gpuMilliseconds", summarize(passGpu[i]) },
+        });
+    }
+    report["passes"] = std::move(passes);
+
+    report["memory"] = rhi.getMemorySnapshot().toJson();
+
+    report["samples"] = std::move(samples);
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open benchmark report " + path + "!");
+    }
+
+    file << report.dump(2) << std::endl;
+}
+
+nlohmann::json Benchmark::getDeviceInfo(const RHI& rhi)
+{
+    auto properties = rhi.getPhysicalDevice().getProperties();
+
+    return {
+        { "name", std::string(properties.deviceName.data()) },
+        { "apiVersion", std::to_string(VK_API_VERSION_MAJOR(properties.apiVersion)) + "." +
+                        std::to_string(VK_API_VERSION_MINOR(properties.apiVersion)) + "." +
+                        std::to_string(VK_API_VERSION_PATCH(properties.apiVersion)) },
+        { "driverVersion", properties.driverVersion },
+    };
+}
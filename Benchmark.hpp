@@ -0,0 +1,37 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "RenderGraph.hpp"
+
+namespace Gfx
+{
+	// Collects the frame timings of a benchmark run and writes them out as a JSON report.
+	//
+	// - The first warmupFrames frames are dropped (shader caches, driver warmup, clocks ramping up)
+	// - The report holds min/mean/max and p50/p95/p99 of the CPU and GPU times, for whole frames and
+	//   for every pass, the device memory in use, and every measured frame so runs can be diffed
+	class Benchmark
+	{
+	public:
+		Benchmark(uint32_t warmupFrames, uint32_t measuredFrames);
+		Benchmark(const Benchmark&) = delete;
+
+		// Adds a completed frame, frames already added or still in the warmup are ignored
+		void addFrame(const FrameTiming& timing);
+		bool isFinished() const { return m_frames.size() >= m_measuredFrames; }
+
+		// `scene` is copied into the report as-is, to tell apart runs with different scene settings
+		void writeReport(const std::string& path, const RHI& rhi, const nlohmann::json& scene) const;
+
+		// Device name, API and driver version, shared by every report
+		static nlohmann::json getDeviceInfo(const RHI& rhi);
+
+	private:
+		uint32_t m_warmupFrames;
+		uint32_t m_measuredFrames;
+		std::vector<FrameTiming> m_frames;
+	};
+}
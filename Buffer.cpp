@@ -1,12 +1,17 @@
 #include "Buffer.hpp"
 
+#include <atomic>
+
 using Gfx::Buffer;
 
-Buffer::Buffer(vk::raii::Buffer&& buffer, vk::raii::DeviceMemory&& bufferMemory, vk::DeviceSize size): 
+Buffer::Buffer(vk::raii::Buffer&& buffer, vk::raii::DeviceMemory&& bufferMemory, vk::DeviceSize size, MemoryTracker::Allocation&& allocation): 
 	m_buffer(std::move(buffer)), 
 	m_bufferMemory(std::move(bufferMemory)), 
-	m_size(size)
+	m_size(size),
+	m_allocation(std::move(allocation))
 {
+	static std::atomic<uint64_t> nextId{ 1 };
+	m_id = nextId++;
 }
 
 void Buffer::map() {
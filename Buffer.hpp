@@ -1,5 +1,6 @@
 #pragma once
 
+#include "MemoryTracker.hpp"
 #include "RHI.hpp"
 
 namespace Gfx
@@ -9,7 +10,7 @@ namespace Gfx
     private:
         friend class RHI;
 
-        Buffer(vk::raii::Buffer&& buffer, vk::raii::DeviceMemory&& bufferMemory, vk::DeviceSize size);
+        Buffer(vk::raii::Buffer&& buffer, vk::raii::DeviceMemory&& bufferMemory, vk::DeviceSize size, MemoryTracker::Allocation&& allocation);
 
     public:
         Buffer(nullptr_t):
@@ -26,11 +27,17 @@ namespace Gfx
         void map();
         void unmap();
 		void* getMappedData() const { return m_mappedData; }
+		vk::DeviceMemory getMemory() const { return *m_bufferMemory; } // for flushing/invalidating non-coherent mappings
+
+		// Unique for the lifetime of the process, unlike the handle, which the driver may hand out again once the buffer is destroyed
+		uint64_t getId() const { return m_id; }
 
     private:
         vk::raii::Buffer m_buffer;
         vk::raii::DeviceMemory m_bufferMemory;
         vk::DeviceSize m_size;
 		void* m_mappedData = nullptr;
+		MemoryTracker::Allocation m_allocation;
+		uint64_t m_id = 0;
     };
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using Gfx::DynamicResolution;
+
+// The scale aims this far below the target, leaving room for the frame-to-frame noise
+static const double targetHeadroom = 0.9;
+
+// Frames faster than this fraction of the target count towards raising the scale, after this many in a row
+static const double raiseThreshold = 0.8;
+static const uint32_t raiseFrames = 30;
+static const float maxRaiseStep = 0.05f;
+
+// Scales are rounded to this step, so noise doesn't change the resolution every frame
+static const float scaleStep = 1.0f / 64.0f;
+
+// Frames older than this many frames are dropped if they never get measured
+static const size_t maxPendingFrames = 16;
+
+DynamicResolution::DynamicResolution(double targetMilliseconds, float minScale, float maxScale) :
+    m_targetMilliseconds(targetMilliseconds),
+    m_minScale(minScale),
+    m_maxScale(maxScale),
+    m_scale(maxScale)
+{
+    if (targetMilliseconds <= 0.0 || minScale <= 0.0f || minScale > maxScale) {
+        throw std::runtime_error("invalid dynamic resolution settings!");
+    }
+}
+
+void DynamicResolution::addFrame(uint64_t frame, double scaledMilliseconds, double fixedMilliseconds)
+{
+    while (!m_frameScales.empty() && m_frameScales.front().first < frame) {
+        m_frameScales.pop_front();
+    }
+    if (m_frameScales.empty() || m_frameScales.front().first != frame) {
+        return;
+    }
+
+    float frameScale = m_frameScales.front().second;
+    m_frameScales.pop_front();
+
+    if (scaledMilliseconds <= 0.0) {
+        return; // no timestamps
+    }
+
+    // only the scaled part shrinks with the scale; when the fixed part alone takes the budget, nothing but the
+    // smallest scale comes close
+    fixedMilliseconds = std::max(fixedMilliseconds, 0.0);
+    auto gpuMilliseconds = scaledMilliseconds + fixedMilliseconds;
+    auto scaledBudget = m_targetMilliseconds * targetHeadroom - fixedMilliseconds;
+    auto estimate = scaledBudget > 0.0
+        ? static_cast<float>(frameScale * std::sqrt(scaledBudget / scaledMilliseconds))
+        : m_minScale;
+
+    if (gpuMilliseconds > m_targetMilliseconds) {
+        // frames rendered before the last drop give an estimate relative to their own scale, so they
+        // don't drop it any further than the first one did
+        m_fastFrames = 0;
+        if (estimate < m_scale) {
+            setScale(estimate);
+        }
+    }
+    else if (gpuMilliseconds < m_targetMilliseconds * raiseThreshold && frameScale == m_scale) {
+        if (++m_fastFrames >= raiseFrames) {
+            m_fastFrames = 0;
+            setScale(std::min(estimate, m_scale + maxRaiseStep));
+        }
+    }
+    else {
+        m_fastFrames = 0;
+    }
+}
+
+float DynamicResolution::beginFrame(uint64_t frame)
+{
+    m_frameScales.emplace_back(frame, m_scale);
+    if (m_frameScales.size() > maxPendingFrames) {
+        m_frameScales.pop_front();
+    }
+
+    return m_scale;
+}
+
+void DynamicResolution::setScale(float scale)
+{
+    // rounded down, a drop always lands under the estimate
+    scale = std::floor(scale / scaleStep) * scaleStep;
+    m_scale = std::clamp(scale, m_minScale, m_maxScale);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace Gfx
+{
+	// Picks the render scale of every frame from the GPU times of the finished ones, so the GPU frame time
+	// stays under a target as the load changes.
+	//
+	// - A frame's GPU time is split into a part that grows with the rendered pixels, the scale squared, and a
+	//   fixed part that doesn't (shadow maps, upscaling, postprocessing at the output size). A measured frame then
+	//   gives the scale at which its scaled part would fit into the target minus its fixed part, relative to the
+	//   scale that frame was rendered at
+	// - Over the target the scale drops to that estimate at once. Well under it the scale only rises after a
+	//   run of such frames, and by a limited step, so it doesn't oscillate around the target or react to
+	//   single fast frames; in between it stays where it is
+	// - Timings arrive a few frames late (frames in flight), which the per-frame scales account for
+	class DynamicResolution
+	{
+	public:
+		DynamicResolution(double targetMilliseconds, float minScale, float maxScale);
+		DynamicResolution(const DynamicResolution&) = delete;
+
+		// Feeds the GPU time of a finished frame, split into the passes rendered at the render scale and the rest
+		// of the frame; frames that weren't started through beginFrame(), or were fed before, are ignored, as are
+		// frames without a GPU time
+		void addFrame(uint64_t frame, double scaledMilliseconds, double fixedMilliseconds);
+
+		// Returns the scale to render the frame at, both axes
+		float beginFrame(uint64_t frame);
+
+		float getScale() const { return m_scale; }
+		double getTargetMilliseconds() const { return m_targetMilliseconds; }
+
+	private:
+		void setScale(float scale);
+
+	private:
+		double m_targetMilliseconds;
+		float m_minScale;
+		float m_maxScale;
+		float m_scale;
+
+		std::deque<std::pair<uint64_t, float>> m_frameScales{}; // frames started but not measured yet
+		uint32_t m_fastFrames = 0; // consecutive frames well under the target at the current scale
+	};
+}
@@ -0,0 +1,149 @@
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <windows.h>
+
+using Gfx::FramePacer;
+
+#undef min
+#undef max
+
+static const double bucketMilliseconds = 0.1;
+static const size_t bucketCount = 2500; // up to 250 ms, plus one bucket for longer intervals
+
+// An interval this much longer than the expected one counts as a stutter
+static const double stutterFactor = 1.5;
+
+// Woken up this long before the deadline to spin the rest; the OS sleep is only that precise
+static const auto spinMarginHighResolution = std::chrono::microseconds(500);
+static const auto spinMarginDefault = std::chrono::milliseconds(2);
+
+FramePacer::FramePacer(double maxFps)
+{
+    if (maxFps > 0.0) {
+        m_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / maxFps));
+    }
+
+    // Windows 10 1803+, plain sleeps are only as precise as the 15.6 ms system tick otherwise
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+}
+
+FramePacer::~FramePacer()
+{
+    if (m_timer) {
+        CloseHandle(m_timer);
+    }
+}
+
+void FramePacer::wait()
+{
+    auto now = Clock::now();
+
+    if (m_period != Clock::duration::zero() && m_hasLastFrame) {
+        if (now < m_deadline) {
+            sleepUntil(m_deadline);
+            now = Clock::now();
+        }
+        else {
+            m_deadline = now; // late, start over from this frame instead of rushing the next ones
+        }
+        m_deadline += m_period;
+    }
+    else {
+        m_deadline = now + m_period;
+    }
+
+    if (m_hasLastFrame) {
+        auto milliseconds = std::chrono::duration<double, std::milli>(now - m_lastFrame).count();
+        m_total.add(milliseconds);
+        m_window.add(milliseconds);
+    }
+
+    m_lastFrame = now;
+    m_hasLastFrame = true;
+}
+
+void FramePacer::resync()
+{
+    m_hasLastFrame = false;
+}
+
+void FramePacer::sleepUntil(Clock::time_point deadline)
+{
+    auto margin = m_timer ? spinMarginHighResolution : spinMarginDefault;
+    auto sleepTime = deadline - margin - Clock::now();
+
+    if (sleepTime > Clock::duration::zero()) {
+        if (m_timer) {
+            // relative due time in 100 ns units
+            LARGE_INTEGER dueTime{};
+            dueTime.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(sleepTime).count() / 100);
+            SetWaitableTimer(m_timer, &dueTime, 0, nullptr, nullptr, FALSE);
+            WaitForSingleObject(m_timer, INFINITE);
+        }
+        else {
+            std::this_thread::sleep_for(sleepTime);
+        }
+    }
+
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+FramePacer::Histogram::Histogram() :
+    m_buckets(bucketCount + 1, 0)
+{
+}
+
+void FramePacer::Histogram::add(double milliseconds)
+{
+    auto bucket = std::min(static_cast<size_t>(milliseconds / bucketMilliseconds), bucketCount);
+    ++m_buckets[bucket];
+    ++m_count;
+    m_sum += milliseconds;
+    m_max = std::max(m_max, milliseconds);
+}
+
+// Upper edge of the bucket holding the nearest-rank percentile
+double FramePacer::Histogram::getPercentile(double p) const
+{
+    auto rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(m_count))), 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_buckets.size(); ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            return i < bucketCount ? static_cast<double>(i + 1) * bucketMilliseconds : m_max;
+        }
+    }
+    return m_max;
+}
+
+Gfx::PacingStats FramePacer::Histogram::getStats(Clock::duration period) const
+{
+    PacingStats stats{};
+    if (m_count == 0) {
+        return stats;
+    }
+
+    stats.frames = m_count;
+    stats.meanMilliseconds = m_sum / static_cast<double>(m_count);
+    stats.p50Milliseconds = getPercentile(50.0);
+    stats.p95Milliseconds = getPercentile(95.0);
+    stats.p99Milliseconds = getPercentile(99.0);
+    stats.maxMilliseconds = m_max;
+
+    auto expected = period != Clock::duration::zero()
+        ? std::chrono::duration<double, std::milli>(period).count()
+        : stats.p50Milliseconds;
+    auto firstStutterBucket = static_cast<size_t>(std::ceil(stutterFactor * expected / bucketMilliseconds));
+
+    for (size_t i = std::min(firstStutterBucket, bucketCount); i < m_buckets.size(); ++i) {
+        stats.stutters += m_buckets[i];
+    }
+
+    return stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace Gfx
+{
+	struct PacingStats
+	{
+		uint64_t frames = 0; // intervals measured, one per frame after the first
+		double meanMilliseconds = 0.0;
+		double p50Milliseconds = 0.0;
+		double p95Milliseconds = 0.0;
+		double p99Milliseconds = 0.0;
+		double maxMilliseconds = 0.0;
+		uint64_t stutters = 0; // intervals longer than 1.5x the target interval, or the median without a limit
+	};
+
+	// Caps the frame rate and measures frame-to-frame intervals.
+	//
+	// - wait() sleeps on a high-resolution timer until shortly before the next frame is due, then spins the rest,
+	//   so frames start within a few microseconds of their deadline without burning a core the whole interval
+	// - A frame that is already late starts right away and the schedule restarts from it, there are no
+	//   catch-up bursts after a hitch
+	// - Intervals go into 0.1 ms histogram buckets, both for the whole run and for a window reset by the caller
+	class FramePacer
+	{
+	public:
+		// maxFps == 0 only measures
+		explicit FramePacer(double maxFps = 0.0);
+		FramePacer(const FramePacer&) = delete;
+		~FramePacer();
+
+		// Call right before starting a frame: waits for its deadline and records the interval since the last one
+		void wait();
+
+		// Forget the last frame, e.g. after idling; the next interval isn't measured and the schedule restarts
+		void resync();
+
+		PacingStats getStats() const { return m_total.getStats(m_period); }
+		PacingStats getWindowStats() const { return m_window.getStats(m_period); }
+		void resetWindow() { m_window = Histogram(); }
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		class Histogram
+		{
+		public:
+			Histogram();
+			void add(double milliseconds);
+			PacingStats getStats(Clock::duration period) const;
+
+		private:
+			double getPercentile(double p) const;
+
+		private:
+			std::vector<uint32_t> m_buckets; // the last bucket holds everything longer
+			uint64_t m_count = 0;
+			double m_sum = 0.0;
+			double m_max = 0.0;
+		};
+
+		void sleepUntil(Clock::time_point deadline);
+
+	private:
+		Clock::duration m_period{}; // zero without a limit
+		Clock::time_point m_deadline{};
+		Clock::time_point m_lastFrame{};
+		bool m_hasLastFrame = false;
+		void* m_timer = nullptr; // high-resolution waitable timer, null where the OS has none
+
+		Histogram m_total{};
+		Histogram m_window{};
+	};
+}
@@ -0,0 +1,171 @@
+#include "GoldenImageTest.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+using Gfx::GoldenImageTest;
+
+static void writePng(const std::string& path, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+    if (!stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), 4, rgba.data(), static_cast<int>(width * 4))) {
+        throw std::runtime_error("failed to write " + path + "!");
+    }
+}
+
+GoldenImageTest::GoldenImageTest(const std::string& directory, bool update) :
+    m_directory(directory),
+    m_update(update)
+{
+    std::filesystem::create_directories(m_directory);
+
+    std::ifstream file(m_directory + "/golden.json");
+    if (file.is_open()) {
+        auto config = nlohmann::json::parse(file);
+        m_pixelThreshold = config.value("pixelThreshold", m_pixelThreshold);
+        m_maxDifferingFraction = config.value("maxDifferingFraction", m_maxDifferingFraction);
+        if (config.contains("gpuBudgetsMilliseconds")) {
+            m_gpuBudgets = config["gpuBudgetsMilliseconds"].get<std::map<std::string, double>>();
+        }
+    }
+
+    m_report["images"] = nlohmann::json::array();
+    m_report["budgets"] = nlohmann::json::array();
+}
+
+bool GoldenImageTest::checkImage(const std::string& name, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height)
+{
+    auto referencePath = m_directory + "/" + name + ".png";
+    nlohmann::json result{ { "name", name } };
+
+    if (m_update) {
+        writePng(referencePath, rgba, width, height);
+        result["updated"] = true;
+        m_report["images"].push_back(std::move(result));
+        std::cout << name << ": reference updated" << std::endl;
+        return true;
+    }
+
+    int referenceWidth = 0, referenceHeight = 0, channels = 0;
+    auto reference = stbi_load(referencePath.c_str(), &referenceWidth, &referenceHeight, &channels, STBI_rgb_alpha);
+
+    bool passed = false;
+    if (!reference) {
+        result["error"] = "missing reference " + referencePath;
+    }
+    else if (static_cast<uint32_t>(referenceWidth) != width || static_cast<uint32_t>(referenceHeight) != height) {
+        result["error"] = "reference is " + std::to_string(referenceWidth) + "x" + std::to_string(referenceHeight) +
+                          ", rendered " + std::to_string(width) + "x" + std::to_string(height);
+    }
+    else {
+        const size_t pixelCount = static_cast<size_t>(width) * height;
+        std::vector<uint8_t> diff(pixelCount * 4);
+        size_t differingPixels = 0;
+        int maxDelta = 0;
+        double squaredError = 0.0;
+
+        // alpha is ignored, the swapchain is composited opaque
+        for (size_t i = 0; i < pixelCount * 4; i += 4) {
+            int pixelDelta = 0;
+            for (size_t c = 0; c < 3; ++c) {
+                int delta = std::abs(static_cast<int>(rgba[i + c]) - static_cast<int>(reference[i + c]));
+                pixelDelta = std::max(pixelDelta, delta);
+                squaredError += static_cast<double>(delta * delta);
+            }
+            maxDelta = std::max(maxDelta, pixelDelta);
+
+            // differing pixels in red, the rest as a dimmed copy of the reference for orientation
+            if (pixelDelta > m_pixelThreshold) {
+                differingPixels++;
+                diff[i + 0] = static_cast<uint8_t>(128 + pixelDelta / 2);
+                diff[i + 1] = 0;
+                diff[i + 2] = 0;
+            }
+            else {
+                auto luminance = static_cast<uint8_t>((reference[i] + reference[i + 1] + reference[i + 2]) / 12);
+                diff[i + 0] = diff[i + 1] = diff[i + 2] = luminance;
+            }
+            diff[i + 3] = 255;
+        }
+
+        double differingFraction = static_cast<double>(differingPixels) / static_cast<double>(pixelCount);
+        passed = differingFraction <= m_maxDifferingFraction;
+
+        result["differingPixels"] = differingPixels;
+        result["differingFraction"] = differingFraction;
+        result["maxChannelDelta"] = maxDelta;
+        result["rmse"] = std::sqrt(squaredError / static_cast<double>(pixelCount * 3));
+
+        if (!passed) {
+            writePng(m_directory + "/" + name + ".actual.png", rgba, width, height);
+            writePng(m_directory + "/" + name + ".diff.png", diff, width, height);
+        }
+    }
+
+    if (reference) {
+        stbi_image_free(reference);
+    }
+
+    result["passed"] = passed;
+    m_passed = m_passed && passed;
+
+    std::cout << name << ": " << (passed ? "passed" : "FAILED");
+    if (result.contains("error")) {
+        std::cout << " (" << result["error"].get<std::string>() << ")";
+    }
+    else {
+        std::cout << " (" << result["differingPixels"] << " differing pixels, max delta " << result["maxChannelDelta"] << ")";
+    }
+    std::cout << std::endl;
+
+    m_report["images"].push_back(std::move(result));
+    return passed;
+}
+
+bool GoldenImageTest::checkBudgets(const std::vector<FrameTiming>& frames)
+{
+    bool allPassed = true;
+
+    for (const auto& [passName, budget] : m_gpuBudgets) {
+        std::vector<double> times{};
+        for (const auto& frame : frames) {
+            for (const auto& pass : frame.passes) {
+                if (pass.name == passName) {
+                    times.push_back(pass.gpuMilliseconds);
+                }
+            }
+        }
+
+        nlohmann::json result{ { "pass", passName }, { "budgetMilliseconds", budget } };
+        bool passed = false;
+
+        if (times.empty()) {
+            result["error"] = "no timings for the pass";
+        }
+        else {
+            // the median keeps a single slow frame (clock ramp-up, compositor) from failing the budget
+            std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+            double median = times[times.size() / 2];
+            result["medianMilliseconds"] = median;
+            passed = median <= budget;
+        }
+
+        result["passed"] = passed;
+        allPassed = allPassed && passed;
+
+        std::cout << passName << " GPU budget " << budget << " ms: " << (passed ? "passed" : "FAILED");
+        if (result.contains("medianMilliseconds")) {
+            std::cout << " (median " << result["medianMilliseconds"].get<double>() << " ms)";
+        }
+        std::cout << std::endl;
+
+        m_report["budgets"].push_back(std::move(result));
+    }
+
+    m_passed = m_passed && allPassed;
+    return allPassed;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <map>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "RenderGraph.hpp"
+
+namespace Gfx
+{
+	// Compares rendered frames against reference PNGs and pass GPU times against budgets.
+	//
+	// The directory holds <name>.png references and an optional golden.json:
+	//   { "pixelThreshold": 8, "maxDifferingFraction": 0.001, "gpuBudgetsMilliseconds": { "GBufferPass": 2.0 } }
+	//
+	// - A pixel differs when any channel is off by more than pixelThreshold (0-255); an image fails when
+	//   more than maxDifferingFraction of its pixels differ, so driver-level rounding noise passes
+	// - Failing images are written next to the reference as <name>.actual.png and <name>.diff.png
+	// - In update mode the rendered images become the new references instead
+	class GoldenImageTest
+	{
+	public:
+		GoldenImageTest(const std::string& directory, bool update);
+		GoldenImageTest(const GoldenImageTest&) = delete;
+
+		// `rgba` is tightly packed RGBA8, top row first
+		bool checkImage(const std::string& name, const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height);
+
+		// Compares the median GPU time of every budgeted pass over `frames` with its budget
+		bool checkBudgets(const std::vector<FrameTiming>& frames);
+
+		bool hasPassed() const { return m_passed; }
+		const nlohmann::json& getReport() const { return m_report; }
+
+	private:
+		std::string m_directory;
+		bool m_update;
+		uint8_t m_pixelThreshold = 8;
+		double m_maxDifferingFraction = 0.001;
+		std::map<std::string, double> m_gpuBudgets{};
+
+		bool m_passed = true;
+		nlohmann::json m_report{};
+	};
+}
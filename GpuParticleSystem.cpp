@@ -0,0 +1,298 @@
+#include "GpuParticleSystem.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using Gfx::GpuParticleSystem;
+
+// Layout of the counter buffer, matches Shaders/particles.fxh
+static const vk::DeviceSize emitArgsOffset = 4 * sizeof(uint32_t);
+static const vk::DeviceSize simulateArgsOffset = 7 * sizeof(uint32_t);
+static const vk::DeviceSize drawArgsOffset = 10 * sizeof(uint32_t);
+static const vk::DeviceSize counterBufferSize = 15 * sizeof(uint32_t);
+
+// PARTICLE_GROUP_SIZE and PARTICLE_MAX_GROUPS, larger counts loop inside the shaders
+static const uint32_t groupSize = 64;
+static const uint32_t maxGroups = 65535;
+
+static const vk::DeviceSize particleSize = 8 * sizeof(float);
+
+static vk::DescriptorBufferInfo getBufferInfo(const Gfx::Buffer& buffer, vk::DeviceSize size) {
+    return { buffer, 0, size };
+}
+
+GpuParticleSystem::GpuParticleSystem(RHI& rhi, uint32_t maxParticles, vk::Format colorFormat, vk::Format depthFormat) :
+    m_rhi(rhi),
+    m_maxParticles(maxParticles),
+    m_particles(nullptr),
+    m_deadList(nullptr),
+    m_aliveLists(nullptr),
+    m_counters(nullptr),
+    m_quadIndices(nullptr),
+    m_resetPipeline(nullptr),
+    m_emitArgsPipeline(nullptr),
+    m_emitPipeline(nullptr),
+    m_simulatePipeline(nullptr),
+    m_drawArgsPipeline(nullptr),
+    m_drawPipeline(nullptr)
+{
+    if (m_maxParticles == 0) {
+        throw std::runtime_error("particle system needs at least one particle!");
+    }
+
+    // the particle buffer is the largest one bound as a whole
+    auto maxStorageBufferRange = m_rhi.getPhysicalDevice().getProperties().limits.maxStorageBufferRange;
+    if (particleSize * m_maxParticles > maxStorageBufferRange) {
+        throw std::runtime_error(std::to_string(m_maxParticles) + " particles exceed the device limit of " + std::to_string(maxStorageBufferRange / particleSize) + "!");
+    }
+
+    createBuffers();
+    createPipelines(colorFormat, depthFormat);
+    createDescriptorSets();
+}
+
+void GpuParticleSystem::createBuffers()
+{
+    auto storageUsage = vk::BufferUsageFlagBits::eStorageBuffer;
+
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.usage = storageUsage;
+
+    bufferInfo.size = particleSize * m_maxParticles;
+    m_particles = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry);
+
+    bufferInfo.size = sizeof(uint32_t) * m_maxParticles;
+    m_deadList = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry);
+
+    bufferInfo.size = 2 * sizeof(uint32_t) * m_maxParticles;
+    m_aliveLists = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry);
+
+    bufferInfo.size = counterBufferSize;
+    bufferInfo.usage = storageUsage | vk::BufferUsageFlagBits::eIndirectBuffer;
+    m_counters = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry);
+
+    // corners 0..3 of every billboard, see particle_draw.vert.hlsl
+    const std::vector<uint32_t> quadIndices = { 0, 1, 2, 2, 1, 3 };
+    bufferInfo.size = sizeof(uint32_t) * quadIndices.size();
+    bufferInfo.usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst;
+    m_quadIndices = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry);
+    m_rhi.updateBuffer(m_quadIndices, quadIndices);
+
+    bufferInfo.size = sizeof(Params);
+    bufferInfo.usage = vk::BufferUsageFlagBits::eUniformBuffer;
+    m_paramBuffers.reserve(m_rhi.getMaxFramesInFlight());
+    for (uint32_t i = 0; i < m_rhi.getMaxFramesInFlight(); i++) {
+        auto paramBuffer = m_rhi.createBuffer(bufferInfo,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+            MemoryCategory::Uniform);
+        paramBuffer.map();
+        m_paramBuffers.emplace_back(std::move(paramBuffer));
+    }
+}
+
+void GpuParticleSystem::createPipelines(vk::Format colorFormat, vk::Format depthFormat)
+{
+    ComputePipelineCreateInfo computeCreateInfo{};
+    computeCreateInfo.descriptorSetLayoutBindings = {
+        { 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+        { 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+        { 2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+        { 3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+        { 4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+    };
+
+    computeCreateInfo.name = "particle reset";
+    computeCreateInfo.shader = { "Shaders/particle_reset.comp.hlsl", vk::ShaderStageFlagBits::eCompute };
+    m_resetPipeline = m_rhi.createComputePipeline(computeCreateInfo);
+
+    computeCreateInfo.name = "particle emit args";
+    computeCreateInfo.shader = { "Shaders/particle_args.comp.hlsl", vk::ShaderStageFlagBits::eCompute };
+    computeCreateInfo.shader.setConstant(0, 0u);
+    m_emitArgsPipeline = m_rhi.createComputePipeline(computeCreateInfo);
+
+    computeCreateInfo.name = "particle draw args";
+    computeCreateInfo.shader = { "Shaders/particle_args.comp.hlsl", vk::ShaderStageFlagBits::eCompute };
+    computeCreateInfo.shader.setConstant(0, 1u);
+    m_drawArgsPipeline = m_rhi.createComputePipeline(computeCreateInfo);
+
+    computeCreateInfo.name = "particle emit";
+    computeCreateInfo.shader = { "Shaders/particle_emit.comp.hlsl", vk::ShaderStageFlagBits::eCompute };
+    m_emitPipeline = m_rhi.createComputePipeline(computeCreateInfo);
+
+    computeCreateInfo.name = "particle simulate";
+    computeCreateInfo.shader = { "Shaders/particle_simulate.comp.hlsl", vk::ShaderStageFlagBits::eCompute };
+    m_simulatePipeline = m_rhi.createComputePipeline(computeCreateInfo);
+
+    // additive, so the particles need no sorting; depth tested against the scene but not written
+    ColorAttachmentDesc colorAttachment{ colorFormat };
+    colorAttachment.blendEnable = true;
+    colorAttachment.srcBlendFactor = vk::BlendFactor::eOne;
+    colorAttachment.dstBlendFactor = vk::BlendFactor::eOne;
+
+    GraphicsPipelineCreateInfo drawCreateInfo{};
+    drawCreateInfo.name = "particle draw";
+    drawCreateInfo.shaders = {
+        { "Shaders/particle_draw.vert.hlsl", vk::ShaderStageFlagBits::eVertex },
+        { "Shaders/particle_draw.frag.hlsl", vk::ShaderStageFlagBits::eFragment },
+    };
+    drawCreateInfo.descriptorSetLayoutBindings = {
+        { 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
+        { 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
+        { 2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
+    };
+    drawCreateInfo.colorAttachments = { colorAttachment };
+    drawCreateInfo.depthAttachment = { depthFormat };
+    drawCreateInfo.state.cullMode = vk::CullModeFlagBits::eNone;
+    drawCreateInfo.state.depthWriteEnable = false;
+    m_drawPipeline = m_rhi.createGraphicsPipeline(drawCreateInfo);
+}
+
+void GpuParticleSystem::createDescriptorSets()
+{
+    std::vector<vk::DescriptorBufferInfo> paramInfos{};
+    paramInfos.reserve(m_paramBuffers.size());
+    for (const auto& paramBuffer : m_paramBuffers) {
+        paramInfos.push_back(getBufferInfo(paramBuffer, sizeof(Params)));
+    }
+
+    auto particlesInfo = getBufferInfo(m_particles, particleSize * m_maxParticles);
+    auto aliveListsInfo = getBufferInfo(m_aliveLists, 2 * sizeof(uint32_t) * m_maxParticles);
+
+    std::vector<DescriptorBinding> computeBindings = {
+        { vk::DescriptorType::eUniformBuffer, paramInfos },
+        { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ particlesInfo } },
+        { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ getBufferInfo(m_deadList, sizeof(uint32_t) * m_maxParticles) } },
+        { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ aliveListsInfo } },
+        { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ getBufferInfo(m_counters, counterBufferSize) } },
+    };
+
+    std::vector<DescriptorBinding> drawBindings = {
+        { vk::DescriptorType::eUniformBuffer, paramInfos },
+        { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ particlesInfo } },
+        { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ aliveListsInfo } },
+    };
+
+    std::vector<DescriptorSetConfig> configs = {
+        { *m_resetPipeline.getDescriptorSetLayout(), computeBindings, "particle reset descriptor set" },
+        { *m_emitArgsPipeline.getDescriptorSetLayout(), computeBindings, "particle emit args descriptor set" },
+        { *m_emitPipeline.getDescriptorSetLayout(), computeBindings, "particle emit descriptor set" },
+        { *m_simulatePipeline.getDescriptorSetLayout(), computeBindings, "particle simulate descriptor set" },
+        { *m_drawArgsPipeline.getDescriptorSetLayout(), computeBindings, "particle draw args descriptor set" },
+        { *m_drawPipeline.getDescriptorSetLayout(), drawBindings, "particle draw descriptor set" },
+    };
+
+    auto sets = m_rhi.createDescriptorSets(configs);
+    m_resetDescriptorSets = std::move(sets[0]);
+    m_emitArgsDescriptorSets = std::move(sets[1]);
+    m_emitDescriptorSets = std::move(sets[2]);
+    m_simulateDescriptorSets = std::move(sets[3]);
+    m_drawArgsDescriptorSets = std::move(sets[4]);
+    m_drawDescriptorSets = std::move(sets[5]);
+}
+
+void GpuParticleSystem::update(const vk::raii::CommandBuffer& cmd, uint32_t frameIndex, float deltaTime)
+{
+    // the CPU only decides how many particles to ask for, the GPU limits it to the free ones
+    auto rate = m_emitter.rate > 0.0f
+        ? static_cast<double>(m_emitter.rate)
+        : 2.0 * m_maxParticles / std::max(m_emitter.lifetimeMin + m_emitter.lifetimeMax, 1e-3f);
+    m_emitAccumulator += rate * deltaTime;
+    auto emitCount = static_cast<uint32_t>(std::min(m_emitAccumulator, static_cast<double>(m_maxParticles)));
+    m_emitAccumulator = std::min(m_emitAccumulator - emitCount, 1.0);
+
+    m_params.emitterPosition = glm::vec4(m_emitter.position, m_emitter.radius);
+    m_params.emitterVelocity = glm::vec4(m_emitter.velocity, m_emitter.spread);
+    m_params.gravity = glm::vec4(m_emitter.gravity, m_emitter.drag);
+    m_params.startColour = m_emitter.startColour;
+    m_params.endColour = m_emitter.endColour;
+    m_params.deltaTime = deltaTime;
+    m_params.lifetimeMin = m_emitter.lifetimeMin;
+    m_params.lifetimeMax = m_emitter.lifetimeMax;
+    m_params.emitCount = emitCount;
+    m_params.maxParticles = m_maxParticles;
+    m_params.current = m_updates & 1;
+    m_params.seed = m_updates;
+    writeParams(frameIndex);
+    ++m_updates;
+
+    // the previous frame's draw still reads the lists rewritten below
+    vk::MemoryBarrier2 drawBarrier{};
+    drawBarrier.srcStageMask = vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eDrawIndirect;
+    drawBarrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+
+    vk::DependencyInfo dependencyInfo{};
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &drawBarrier;
+    cmd.pipelineBarrier2(dependencyInfo);
+
+    auto computeStage = vk::PipelineStageFlagBits2::eComputeShader;
+    auto computeAccess = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+    auto indirectStage = computeStage | vk::PipelineStageFlagBits2::eDrawIndirect;
+    auto indirectAccess = computeAccess | vk::AccessFlagBits2::eIndirectCommandRead;
+
+    if (m_reset) {
+        dispatch(cmd, m_resetPipeline, m_resetDescriptorSets, frameIndex, std::min((m_maxParticles + groupSize - 1) / groupSize, maxGroups));
+        recordBarrier(cmd, computeStage, computeAccess);
+        m_reset = false;
+    }
+
+    dispatch(cmd, m_emitArgsPipeline, m_emitArgsDescriptorSets, frameIndex, 1);
+    recordBarrier(cmd, indirectStage, indirectAccess);
+
+    dispatchIndirect(cmd, m_emitPipeline, m_emitDescriptorSets, frameIndex, emitArgsOffset);
+    recordBarrier(cmd, computeStage, computeAccess);
+
+    dispatchIndirect(cmd, m_simulatePipeline, m_simulateDescriptorSets, frameIndex, simulateArgsOffset);
+    recordBarrier(cmd, computeStage, computeAccess);
+
+    dispatch(cmd, m_drawArgsPipeline, m_drawArgsDescriptorSets, frameIndex, 1);
+    recordBarrier(cmd, vk::PipelineStageFlagBits2::eVertexShader | indirectStage, vk::AccessFlagBits2::eShaderStorageRead | indirectAccess);
+}
+
+void GpuParticleSystem::draw(const vk::raii::CommandBuffer& cmd, uint32_t frameIndex, const glm::mat4& view, const glm::mat4& proj)
+{
+    // billboards face the camera, its right and up axes are the first two rows of the view rotation
+    m_params.viewProj = proj * view;
+    m_params.cameraRight = glm::vec4(view[0][0], view[1][0], view[2][0], m_emitter.size);
+    m_params.cameraUp = glm::vec4(view[0][1], view[1][1], view[2][1], 0.0f);
+    writeParams(frameIndex);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, m_drawPipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_drawPipeline.getPipelineLayout(), 0, *m_drawDescriptorSets[frameIndex], nullptr);
+    cmd.bindIndexBuffer(*m_quadIndices, 0, vk::IndexType::eUint32);
+    cmd.drawIndexedIndirect(*m_counters, drawArgsOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuParticleSystem::dispatch(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const std::vector<DescriptorSet>& descriptorSets, uint32_t frameIndex, uint32_t groupCount) const
+{
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline.getPipelineLayout(), 0, *descriptorSets[frameIndex], nullptr);
+    cmd.dispatch(groupCount, 1, 1);
+}
+
+void GpuParticleSystem::dispatchIndirect(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const std::vector<DescriptorSet>& descriptorSets, uint32_t frameIndex, vk::DeviceSize offset) const
+{
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline.getPipelineLayout(), 0, *descriptorSets[frameIndex], nullptr);
+    cmd.dispatchIndirect(*m_counters, offset);
+}
+
+void GpuParticleSystem::recordBarrier(const vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask) const
+{
+    vk::MemoryBarrier2 barrier{};
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+    barrier.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite;
+    barrier.dstStageMask = dstStageMask;
+    barrier.dstAccessMask = dstAccessMask;
+
+    vk::DependencyInfo dependencyInfo{};
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &barrier;
+    cmd.pipelineBarrier2(dependencyInfo);
+}
+
+void GpuParticleSystem::writeParams(uint32_t frameIndex) const
+{
+    memcpy(m_paramBuffers[frameIndex].getMappedData(), &m_params, sizeof(m_params));
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+
+#include <glm/glm.hpp>
+
+#include "Buffer.hpp"
+#include "DescriptorSet.hpp"
+#include "Pipeline.hpp"
+#include "RHI.hpp"
+
+namespace Gfx
+{
+	struct ParticleEmitter
+	{
+		glm::vec3 position{ 0.0f, 0.0f, 0.0f };
+		float radius = 0.05f; // particles spawn inside this sphere
+		glm::vec3 velocity{ 0.0f, 0.0f, 1.5f };
+		float spread = 0.5f; // random velocity added in every direction
+		glm::vec3 gravity{ 0.0f, 0.0f, -1.5f };
+		float drag = 0.2f; // fraction of the velocity lost per second
+		glm::vec4 startColour{ 1.0f, 0.7f, 0.3f, 1.0f };
+		glm::vec4 endColour{ 0.6f, 0.1f, 0.05f, 0.0f };
+		float lifetimeMin = 1.0f; // seconds
+		float lifetimeMax = 3.0f;
+		float rate = 0.0f; // particles per second, 0 keeps the pool about full
+		float size = 0.005f; // billboard half extent in world units
+	};
+
+	// GPU-driven particles: the pool, the free list and all dispatch and draw arguments live in device memory,
+	// the CPU writes one uniform buffer per frame whatever the particle count.
+	//
+	// - Emit pops particles off the free list (a consume buffer) and appends them to the current alive list
+	// - Simulate ages and moves the current alive list, appending survivors to the other alive list and
+	//   expired particles back to the free list; the two alive lists swap roles every update
+	// - Single-thread dispatches turn the counters into dispatchIndirect and drawIndexedIndirect arguments
+	// - update() and draw() record their own barriers; the state persists across frames, so every
+	//   frame in flight shares one pool and the queue order keeps them consistent
+	class GpuParticleSystem
+	{
+	public:
+		// Draws into a color attachment of colorFormat, depth tested against depthFormat
+		GpuParticleSystem(RHI& rhi, uint32_t maxParticles, vk::Format colorFormat, vk::Format depthFormat);
+		GpuParticleSystem(const GpuParticleSystem&) = delete;
+
+		void setEmitter(const ParticleEmitter& emitter) { m_emitter = emitter; }
+		const ParticleEmitter& getEmitter() const { return m_emitter; }
+		uint32_t getMaxParticles() const { return m_maxParticles; }
+
+		// Emits and simulates deltaTime seconds, outside of a render pass
+		void update(const vk::raii::CommandBuffer& cmd, uint32_t frameIndex, float deltaTime);
+
+		// Draws what the last update() left alive as additive billboards, inside a render pass
+		void draw(const vk::raii::CommandBuffer& cmd, uint32_t frameIndex, const glm::mat4& view, const glm::mat4& proj);
+
+	private:
+		// Matches ParticleParams in Shaders/particles.fxh
+		struct Params
+		{
+			glm::mat4 viewProj;
+			glm::vec4 cameraRight; // w: billboard half size
+			glm::vec4 cameraUp;
+			glm::vec4 emitterPosition; // w: spawn radius
+			glm::vec4 emitterVelocity; // w: random spread
+			glm::vec4 gravity; // w: drag
+			glm::vec4 startColour;
+			glm::vec4 endColour;
+			float deltaTime;
+			float lifetimeMin;
+			float lifetimeMax;
+			uint32_t emitCount;
+			uint32_t maxParticles;
+			uint32_t current;
+			uint32_t seed;
+			uint32_t padding;
+		};
+
+		void createBuffers();
+		void createPipelines(vk::Format colorFormat, vk::Format depthFormat);
+		void createDescriptorSets();
+		void dispatch(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const std::vector<DescriptorSet>& descriptorSets, uint32_t frameIndex, uint32_t groupCount) const;
+		void dispatchIndirect(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const std::vector<DescriptorSet>& descriptorSets, uint32_t frameIndex, vk::DeviceSize offset) const;
+		void recordBarrier(const vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask) const;
+		void writeParams(uint32_t frameIndex) const;
+
+	private:
+		RHI& m_rhi;
+		uint32_t m_maxParticles;
+		ParticleEmitter m_emitter{};
+
+		Buffer m_particles;
+		Buffer m_deadList;
+		Buffer m_aliveLists;
+		Buffer m_counters; // counters and indirect arguments
+		Buffer m_quadIndices;
+		std::vector<Buffer> m_paramBuffers{}; // per frame in flight, persistently mapped
+
+		Pipeline m_resetPipeline;
+		Pipeline m_emitArgsPipeline;
+		Pipeline m_emitPipeline;
+		Pipeline m_simulatePipeline;
+		Pipeline m_drawArgsPipeline;
+		Pipeline m_drawPipeline;
+
+		std::vector<DescriptorSet> m_resetDescriptorSets{};
+		std::vector<DescriptorSet> m_emitArgsDescriptorSets{};
+		std::vector<DescriptorSet> m_emitDescriptorSets{};
+		std::vector<DescriptorSet> m_simulateDescriptorSets{};
+		std::vector<DescriptorSet> m_drawArgsDescriptorSets{};
+		std::vector<DescriptorSet> m_drawDescriptorSets{};
+
+		Params m_params{};
+		bool m_reset = true; // the free list is filled by the first update
+		double m_emitAccumulator = 0.0; // fractional particles carried over to the next update
+		uint32_t m_updates = 0;
+	};
+}
@@ -0,0 +1,281 @@
+#include "GpuPrimitives.hpp"
+
+#include <algorithm>
+#include <string>
+
+using Gfx::GpuPrimitives;
+
+// PRIMITIVE_GROUP_SIZE * PRIMITIVE_ITEMS_PER_THREAD and RADIX_BITS in Shaders/primitives.fxh
+static const uint32_t blockSize = 1024;
+static const uint32_t radixBits = 4;
+static const uint32_t radixBins = 1 << radixBits;
+
+// every block is one group, so counts stay within the guaranteed maxComputeWorkGroupCount
+static const uint32_t maxBlocks = 65535;
+
+static uint32_t getBlockCount(uint32_t count) {
+    return std::max((count + blockSize - 1) / blockSize, 1u);
+}
+
+template<typename T>
+static uint64_t toKey(T handle) {
+    return reinterpret_cast<uint64_t>(static_cast<typename T::CType>(handle));
+}
+
+GpuPrimitives::GpuPrimitives(RHI& rhi, uint32_t maxElements) :
+    m_rhi(rhi),
+    m_maxElements(maxElements),
+    m_compactOffsets(nullptr),
+    m_sortKeys(nullptr),
+    m_sortValues(nullptr),
+    m_histograms(nullptr),
+    m_scanPipeline(nullptr),
+    m_predicateScanPipeline(nullptr),
+    m_scanAddPipeline(nullptr),
+    m_compactPipeline(nullptr),
+    m_compactIndicesPipeline(nullptr),
+    m_radixCountPipeline(nullptr),
+    m_radixScatterPipeline(nullptr)
+{
+    if (m_maxElements == 0 || getBlockCount(m_maxElements) > maxBlocks) {
+        throw std::runtime_error("GPU primitives support 1 to " + std::to_string(maxBlocks * blockSize) + " elements!");
+    }
+
+    // WaveGetLaneCount and WavePrefixSum
+    m_waveOps = m_rhi.isWaveOpsSupported(vk::ShaderStageFlagBits::eCompute, vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eArithmetic);
+
+    // the sort scans one histogram entry per digit and block, which can outgrow the element count of tiny sorts
+    auto scanCapacity = std::max(m_maxElements, radixBins * getBlockCount(m_maxElements));
+
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+
+    auto levelCount = scanCapacity;
+    do {
+        levelCount = getBlockCount(levelCount);
+        bufferInfo.size = sizeof(uint32_t) * levelCount;
+        m_blockTotals.emplace_back(m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Other));
+    } while (levelCount > 1);
+
+    createPipelines();
+}
+
+void GpuPrimitives::createPipelines()
+{
+    ComputePipelineCreateInfo createInfo{};
+    createInfo.pushConstantSize = sizeof(Constants);
+
+    auto createPipeline = [&](const std::string& name, const std::string& path, uint32_t bindingCount, const bool* constant) {
+        createInfo.name = name;
+        createInfo.shader = { path, vk::ShaderStageFlagBits::eCompute };
+        if (m_waveOps) {
+            createInfo.shader.defines = { "USE_WAVE_OPS=1" };
+        }
+        if (constant) {
+            createInfo.shader.setConstant(0, static_cast<vk::Bool32>(*constant));
+        }
+
+        createInfo.descriptorSetLayoutBindings.clear();
+        for (uint32_t i = 0; i < bindingCount; ++i) {
+            createInfo.descriptorSetLayoutBindings.push_back({ i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr });
+        }
+
+        return m_rhi.createComputePipeline(createInfo);
+    };
+
+    const bool off = false;
+    const bool on = true;
+
+    m_scanPipeline = createPipeline("scan", "Shaders/scan_local.comp.hlsl", 3, &off);
+    m_predicateScanPipeline = createPipeline("predicate scan", "Shaders/scan_local.comp.hlsl", 3, &on);
+    m_scanAddPipeline = createPipeline("scan add", "Shaders/scan_add.comp.hlsl", 2, nullptr);
+    m_compactPipeline = createPipeline("compact", "Shaders/compact_scatter.comp.hlsl", 5, &off);
+    m_compactIndicesPipeline = createPipeline("compact indices", "Shaders/compact_scatter.comp.hlsl", 5, &on);
+    m_radixCountPipeline = createPipeline("radix count", "Shaders/radix_count.comp.hlsl", 2, nullptr);
+    m_radixScatterPipeline = createPipeline("radix scatter", "Shaders/radix_scatter.comp.hlsl", 5, nullptr);
+}
+
+void GpuPrimitives::createCompactionBuffers()
+{
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    bufferInfo.size = sizeof(uint32_t) * m_maxElements;
+    m_compactOffsets = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Other);
+}
+
+void GpuPrimitives::createSortBuffers()
+{
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    bufferInfo.size = sizeof(uint32_t) * m_maxElements;
+    m_sortKeys = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Other);
+    m_sortValues = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Other);
+
+    bufferInfo.size = sizeof(uint32_t) * radixBins * getBlockCount(m_maxElements);
+    m_histograms = m_rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Other);
+}
+
+void GpuPrimitives::checkCount(uint32_t count) const
+{
+    if (count > m_maxElements) {
+        throw std::runtime_error("GPU primitive of " + std::to_string(count) + " elements exceeds the capacity of " + std::to_string(m_maxElements) + "!");
+    }
+}
+
+void GpuPrimitives::exclusiveScan(const vk::raii::CommandBuffer& cmd, const Buffer& input, const Buffer& output, uint32_t count)
+{
+    checkCount(count);
+
+    scan(cmd, m_scanPipeline, input, output, count, 0);
+    recordResultBarrier(cmd);
+}
+
+void GpuPrimitives::compact(const vk::raii::CommandBuffer& cmd, const Buffer& input, const Buffer& flags, const Buffer& output, const Buffer& outputCount, uint32_t count)
+{
+    checkCount(count);
+    if (!*m_compactOffsets) {
+        createCompactionBuffers();
+    }
+
+    scan(cmd, m_predicateScanPipeline, flags, m_compactOffsets, count, 0);
+    recordBarrier(cmd);
+
+    dispatch(cmd, m_compactPipeline, { &input, &flags, &m_compactOffsets, &output, &outputCount }, { count, getBlockCount(count), 0, 0 });
+    recordResultBarrier(cmd);
+}
+
+void GpuPrimitives::compactIndices(const vk::raii::CommandBuffer& cmd, const Buffer& flags, const Buffer& output, const Buffer& outputCount, uint32_t count)
+{
+    checkCount(count);
+    if (!*m_compactOffsets) {
+        createCompactionBuffers();
+    }
+
+    scan(cmd, m_predicateScanPipeline, flags, m_compactOffsets, count, 0);
+    recordBarrier(cmd);
+
+    // the input binding is not read, any storage buffer will do
+    dispatch(cmd, m_compactIndicesPipeline, { &flags, &flags, &m_compactOffsets, &output, &outputCount }, { count, getBlockCount(count), 0, 0 });
+    recordResultBarrier(cmd);
+}
+
+void GpuPrimitives::sortKeyValue(const vk::raii::CommandBuffer& cmd, const Buffer& keys, const Buffer& values, uint32_t count, uint32_t keyBits)
+{
+    checkCount(count);
+    if (keyBits == 0 || keyBits > 32 || keyBits % 8 != 0) {
+        throw std::runtime_error("radix sort key bits must be 8, 16, 24 or 32!");
+    }
+    if (!*m_sortKeys) {
+        createSortBuffers();
+    }
+
+    Constants constants{ count, getBlockCount(count), 0, 0 };
+
+    // an even number of passes, so the last one scatters back into the caller's buffers
+    const Buffer* sourceKeys = &keys;
+    const Buffer* sourceValues = &values;
+    const Buffer* targetKeys = &m_sortKeys;
+    const Buffer* targetValues = &m_sortValues;
+
+    for (constants.shift = 0; constants.shift < keyBits; constants.shift += radixBits) {
+        if (constants.shift > 0) {
+            recordBarrier(cmd);
+        }
+
+        dispatch(cmd, m_radixCountPipeline, { sourceKeys, &m_histograms }, constants);
+        recordBarrier(cmd);
+
+        scan(cmd, m_scanPipeline, m_histograms, m_histograms, radixBins * constants.blockCount, 0);
+        recordBarrier(cmd);
+
+        dispatch(cmd, m_radixScatterPipeline, { sourceKeys, sourceValues, &m_histograms, targetKeys, targetValues }, constants);
+
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourceValues, targetValues);
+    }
+
+    recordResultBarrier(cmd);
+}
+
+void GpuPrimitives::scan(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const Buffer& input, const Buffer& output, uint32_t count, size_t level)
+{
+    Constants constants{ count, getBlockCount(count), 0, 0 };
+    const Buffer& blockTotals = m_blockTotals[level];
+
+    dispatch(cmd, pipeline, { &input, &output, &blockTotals }, constants);
+    if (constants.blockCount == 1) {
+        return;
+    }
+
+    // the block totals become the offsets of the blocks, scanned in place
+    recordBarrier(cmd);
+    scan(cmd, m_scanPipeline, blockTotals, blockTotals, constants.blockCount, level + 1);
+    recordBarrier(cmd);
+
+    dispatch(cmd, m_scanAddPipeline, { &output, &blockTotals }, constants);
+}
+
+void GpuPrimitives::dispatch(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const std::vector<const Buffer*>& buffers, const Constants& constants)
+{
+    const auto& descriptorSet = getBindings(pipeline, buffers);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline.getPipelineLayout(), 0, *descriptorSet, nullptr);
+    cmd.pushConstants<Constants>(*pipeline.getPipelineLayout(), vk::ShaderStageFlagBits::eCompute, 0, constants);
+    cmd.dispatch(constants.blockCount, 1, 1);
+}
+
+const Gfx::DescriptorSet& GpuPrimitives::getBindings(const Pipeline& pipeline, const std::vector<const Buffer*>& buffers)
+{
+    vk::DescriptorSetLayout layout = *pipeline.getDescriptorSetLayout();
+
+    std::vector<uint64_t> key{ toKey(layout) };
+    for (auto buffer : buffers) {
+        key.push_back(buffer->getId());
+    }
+
+    auto it = m_bindings.find(key);
+    if (it == m_bindings.end()) {
+        DescriptorSetConfig config{ layout, {}, "gpu primitives descriptor set" };
+        for (auto buffer : buffers) {
+            config.bindings.push_back({ vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ { **buffer, 0, VK_WHOLE_SIZE } } });
+        }
+
+        auto sets = m_rhi.createDescriptorSets(std::vector<DescriptorSetConfig>{ config });
+        it = m_bindings.emplace(std::move(key), std::move(sets[0])).first;
+    }
+
+    // the buffers are the same for every frame in flight
+    return it->second[0];
+}
+
+void GpuPrimitives::recordBarrier(const vk::raii::CommandBuffer& cmd) const
+{
+    vk::MemoryBarrier2 barrier{};
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+    barrier.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite;
+    barrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+    barrier.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+
+    vk::DependencyInfo dependencyInfo{};
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &barrier;
+    cmd.pipelineBarrier2(dependencyInfo);
+}
+
+void GpuPrimitives::recordResultBarrier(const vk::raii::CommandBuffer& cmd) const
+{
+    // also orders the next call's writes to the scratch buffers after this one's reads
+    vk::MemoryBarrier2 barrier{};
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+    barrier.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite;
+    barrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect |
+        vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eTransfer;
+    barrier.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite |
+        vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eTransferWrite;
+
+    vk::DependencyInfo dependencyInfo{};
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers = &barrier;
+    cmd.pipelineBarrier2(dependencyInfo);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "DescriptorSet.hpp"
+#include "Pipeline.hpp"
+#include "RHI.hpp"
+
+namespace Gfx
+{
+	// Data-parallel building blocks on uint32 storage buffers: exclusive prefix sum, stream compaction and
+	// key-value radix sort, for culling, compaction, light binning and sorting on the GPU.
+	//
+	// - Every group handles a block of 1024 elements; scans of more than one block scan the block totals
+	//   recursively and add them back, so any size up to the capacity takes a handful of dispatches
+	// - Blocks are scanned with wave intrinsics when the device has subgroup arithmetic in compute shaders,
+	//   with a shared-memory scan otherwise
+	// - The sort is a stable LSD radix sort with 4-bit digits: per pass a histogram per block, one scan over
+	//   all histograms and a scatter into the other buffer pair; the result ends up in the caller's buffers
+	// - Calls record their own barriers and end with one that makes the results visible to compute shaders,
+	//   indirect commands and transfers; making the inputs visible before the call is up to the caller
+	// - Descriptor sets are cached per combination of buffers, so calls with the same buffers every frame
+	//   allocate nothing after the first one. The cache is keyed on Buffer::getId(), which is never reused,
+	//   so a buffer created where a destroyed one was can't pick up the old one's sets.
+	class GpuPrimitives
+	{
+	public:
+		// maxElements bounds the count of every call, the scratch buffers are sized for it
+		GpuPrimitives(RHI& rhi, uint32_t maxElements);
+		GpuPrimitives(const GpuPrimitives&) = delete;
+
+		uint32_t getMaxElements() const { return m_maxElements; }
+		bool isUsingWaveOps() const { return m_waveOps; }
+
+		// output[i] = input[0] + ... + input[i - 1], wrapping on overflow. output may be the input buffer.
+		void exclusiveScan(const vk::raii::CommandBuffer& cmd, const Buffer& input, const Buffer& output, uint32_t count);
+
+		// Copies input[i] for every flags[i] != 0 to the front of output, in order, and the number of them to outputCount[0]
+		void compact(const vk::raii::CommandBuffer& cmd, const Buffer& input, const Buffer& flags, const Buffer& output, const Buffer& outputCount, uint32_t count);
+
+		// Same as compact(), but writes the indices i instead of the values
+		void compactIndices(const vk::raii::CommandBuffer& cmd, const Buffer& flags, const Buffer& output, const Buffer& outputCount, uint32_t count);
+
+		// Sorts keys ascending and moves the values along, keeping the order of equal keys.
+		// Only the low keyBits bits are compared, a multiple of 8 up to 32; every 4 bits cost one pass.
+		void sortKeyValue(const vk::raii::CommandBuffer& cmd, const Buffer& keys, const Buffer& values, uint32_t count, uint32_t keyBits = 32);
+
+		// Drops the cached descriptor sets, so the ones of buffers passed in before and since destroyed don't pile up.
+		// No command buffer using them may still be in flight.
+		void releaseBindings() { m_bindings.clear(); }
+
+	private:
+		// Matches PrimitiveConstants in Shaders/primitives.fxh
+		struct Constants
+		{
+			uint32_t count;
+			uint32_t blockCount;
+			uint32_t shift;
+			uint32_t padding;
+		};
+
+		void createPipelines();
+		void createCompactionBuffers();
+		void createSortBuffers();
+		void checkCount(uint32_t count) const;
+
+		// Scans count elements with `pipeline` (plain or predicate scan), using the block totals from `level` on
+		void scan(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const Buffer& input, const Buffer& output, uint32_t count, size_t level);
+		void dispatch(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const std::vector<const Buffer*>& buffers, const Constants& constants);
+		const DescriptorSet& getBindings(const Pipeline& pipeline, const std::vector<const Buffer*>& buffers);
+		void recordBarrier(const vk::raii::CommandBuffer& cmd) const;
+		void recordResultBarrier(const vk::raii::CommandBuffer& cmd) const;
+
+	private:
+		RHI& m_rhi;
+		uint32_t m_maxElements;
+		bool m_waveOps = false;
+
+		std::vector<Buffer> m_blockTotals{}; // one per scan level, the last one holds a single total
+		Buffer m_compactOffsets;
+		Buffer m_sortKeys;
+		Buffer m_sortValues;
+		Buffer m_histograms;
+
+		Pipeline m_scanPipeline;
+		Pipeline m_predicateScanPipeline;
+		Pipeline m_scanAddPipeline;
+		Pipeline m_compactPipeline;
+		Pipeline m_compactIndicesPipeline;
+		Pipeline m_radixCountPipeline;
+		Pipeline m_radixScatterPipeline;
+
+		// keyed by the descriptor set layout followed by the buffer ids, in binding order
+		std::map<std::vector<uint64_t>, std::vector<DescriptorSet>> m_bindings{};
+	};
+}
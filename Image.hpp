@@ -1,5 +1,6 @@
 #pragma once
 
+#include "MemoryTracker.hpp"
 #include "RHI.hpp"
 
 namespace Gfx
@@ -9,7 +10,7 @@ namespace Gfx
     private:
         friend class RHI;
 
-        Image(vk::raii::Image&& image, vk::raii::DeviceMemory&& bufferMemory, vk::raii::ImageView&& imageView, vk::Extent3D extent, vk::Format format);
+        Image(vk::raii::Image&& image, vk::raii::DeviceMemory&& bufferMemory, vk::raii::ImageView&& imageView, vk::Extent3D extent, vk::Format format, MemoryTracker::Allocation&& allocation);
 
     public:
         Image(nullptr_t):
@@ -33,5 +34,6 @@ namespace Gfx
         vk::raii::ImageView m_imageView;
         vk::Extent3D m_extent;
         vk::Format m_format;
+        MemoryTracker::Allocation m_allocation;
     };
 }
\ No newline at end of file
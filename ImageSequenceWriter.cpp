@@ -0,0 +1,78 @@
+#include "ImageSequenceWriter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <stb_image_write.h>
+#include <stdexcept>
+#include <thread>
+
+using Gfx::ImageSequenceWriter;
+
+// Encoding is the expensive part of writing a frame, the render thread and the RHI workers keep the other half
+static uint32_t getDefaultThreadCount() {
+    return std::max(std::thread::hardware_concurrency() / 2, 1u);
+}
+
+ImageSequenceWriter::ImageSequenceWriter(const std::string& directory, uint32_t threadCount, uint32_t maxPendingFrames) :
+    m_directory(directory),
+    m_workers(threadCount ? threadCount : getDefaultThreadCount())
+{
+    m_maxPendingFrames = maxPendingFrames ? maxPendingFrames : 4 * m_workers.getThreadCount();
+
+    std::filesystem::create_directories(m_directory);
+}
+
+ImageSequenceWriter::~ImageSequenceWriter()
+{
+    // errors are only reported through finish(), the frames still have to be written before the pool goes away
+    for (auto& pending : m_pending) {
+        pending.wait();
+    }
+}
+
+void ImageSequenceWriter::write(uint32_t frame, std::vector<uint8_t> pixels, uint32_t width, uint32_t height, bool bgra)
+{
+    if (m_pending.size() >= m_maxPendingFrames) {
+        auto start = std::chrono::steady_clock::now();
+        retireOldest();
+        m_blockedMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "/frame_%05u.png", frame);
+    auto path = m_directory + name;
+
+    m_pending.push_back(m_workers.submit([path, pixels = std::move(pixels), width, height, bgra]() mutable {
+        auto start = std::chrono::steady_clock::now();
+
+        if (bgra) {
+            for (size_t i = 0; i < pixels.size(); i += 4) {
+                std::swap(pixels[i], pixels[i + 2]);
+            }
+        }
+
+        if (!stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), 4, pixels.data(), static_cast<int>(width * 4))) {
+            throw std::runtime_error("failed to write " + path + "!");
+        }
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }));
+}
+
+void ImageSequenceWriter::finish()
+{
+    while (!m_pending.empty()) {
+        retireOldest();
+    }
+}
+
+void ImageSequenceWriter::retireOldest()
+{
+    auto pending = std::move(m_pending.front());
+    m_pending.pop_front();
+
+    m_encodeMilliseconds += pending.get();
+    ++m_writtenFrames;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace Gfx
+{
+	// Encodes rendered frames to <directory>/frame_NNNNN.png on its own writer threads.
+	//
+	// - write() only queues the frame, so encoding and disk I/O overlap with rendering the next frames
+	// - At most maxPendingFrames frames are queued; past that write() waits for the oldest one, which bounds
+	//   the memory held by frames when the disk can't keep up (getBlockedMilliseconds() shows how long)
+	class ImageSequenceWriter
+	{
+	public:
+		// threadCount == 0 picks half the hardware threads, maxPendingFrames == 0 picks four per thread
+		ImageSequenceWriter(const std::string& directory, uint32_t threadCount = 0, uint32_t maxPendingFrames = 0);
+		ImageSequenceWriter(const ImageSequenceWriter&) = delete;
+		~ImageSequenceWriter();
+
+		// `pixels` is tightly packed 8-bit RGBA, or BGRA when `bgra` is set, top row first
+		void write(uint32_t frame, std::vector<uint8_t> pixels, uint32_t width, uint32_t height, bool bgra);
+
+		// Waits for every queued frame, rethrows the first failed write
+		void finish();
+
+		uint32_t getWrittenFrames() const { return m_writtenFrames; }
+		double getEncodeMilliseconds() const { return m_encodeMilliseconds; } // summed over all writer threads
+		double getBlockedMilliseconds() const { return m_blockedMilliseconds; } // spent in write() waiting for a free slot
+
+	private:
+		void retireOldest();
+
+	private:
+		std::string m_directory;
+		size_t m_maxPendingFrames;
+		std::deque<std::future<double>> m_pending{}; // encode time of every queued frame, in write order
+
+		uint32_t m_writtenFrames = 0;
+		double m_encodeMilliseconds = 0.0;
+		double m_blockedMilliseconds = 0.0;
+
+		// Declared last so its threads are joined before the queue they report to is destroyed
+		ThreadPool m_workers;
+	};
+}
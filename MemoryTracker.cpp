@@ -0,0 +1,145 @@
+#include "MemoryTracker.hpp"
+
+#include <nlohmann/json.hpp>
+
+using Gfx::MemoryTracker;
+
+const char* Gfx::toString(MemoryCategory category)
+{
+    switch (category) {
+    case MemoryCategory::GBuffer:      return "gbuffer";
+    case MemoryCategory::Shadow:       return "shadow";
+    case MemoryCategory::RenderTarget: return "renderTarget";
+    case MemoryCategory::Texture:      return "texture";
+    case MemoryCategory::Geometry:     return "geometry";
+    case MemoryCategory::Uniform:      return "uniform";
+    case MemoryCategory::Staging:      return "staging";
+    default:                           return "other";
+    }
+}
+
+MemoryTracker::Allocation::Allocation(MemoryTracker& tracker, uint32_t heapIndex, MemoryCategory category, vk::DeviceSize size) :
+    m_tracker(&tracker),
+    m_heapIndex(heapIndex),
+    m_category(category),
+    m_size(size)
+{
+    m_tracker->m_heaps[m_heapIndex].add(m_size);
+    m_tracker->m_categories[static_cast<size_t>(m_category)].add(m_size);
+    m_tracker->m_total.add(m_size);
+}
+
+MemoryTracker::Allocation::Allocation(Allocation&& other) noexcept :
+    m_tracker(other.m_tracker),
+    m_heapIndex(other.m_heapIndex),
+    m_category(other.m_category),
+    m_size(other.m_size)
+{
+    other.m_tracker = nullptr;
+}
+
+MemoryTracker::Allocation& MemoryTracker::Allocation::operator=(Allocation&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_tracker = other.m_tracker;
+        m_heapIndex = other.m_heapIndex;
+        m_category = other.m_category;
+        m_size = other.m_size;
+        other.m_tracker = nullptr;
+    }
+    return *this;
+}
+
+MemoryTracker::Allocation::~Allocation()
+{
+    release();
+}
+
+void MemoryTracker::Allocation::release()
+{
+    if (m_tracker) {
+        m_tracker->m_heaps[m_heapIndex].remove(m_size);
+        m_tracker->m_categories[static_cast<size_t>(m_category)].remove(m_size);
+        m_tracker->m_total.remove(m_size);
+        m_tracker = nullptr;
+    }
+}
+
+MemoryTracker::Usage MemoryTracker::getHeapUsage(uint32_t heapIndex) const
+{
+    return m_heaps[heapIndex].load();
+}
+
+MemoryTracker::Usage MemoryTracker::getCategoryUsage(MemoryCategory category) const
+{
+    return m_categories[static_cast<size_t>(category)].load();
+}
+
+MemoryTracker::Usage MemoryTracker::getTotalUsage() const
+{
+    return m_total.load();
+}
+
+void MemoryTracker::Counters::add(vk::DeviceSize size)
+{
+    auto current = bytes.fetch_add(size) + size;
+    allocationCount.fetch_add(1);
+
+    auto peak = peakBytes.load();
+    while (current > peak && !peakBytes.compare_exchange_weak(peak, current)) {
+    }
+}
+
+void MemoryTracker::Counters::remove(vk::DeviceSize size)
+{
+    bytes.fetch_sub(size);
+    allocationCount.fetch_sub(1);
+}
+
+MemoryTracker::Usage MemoryTracker::Counters::load() const
+{
+    Usage usage{};
+    usage.bytes = bytes.load();
+    usage.peakBytes = peakBytes.load();
+    usage.allocationCount = allocationCount.load();
+    return usage;
+}
+
+static nlohmann::json toJson(const MemoryTracker::Usage& usage) {
+    return {
+        { "bytes", usage.bytes },
+        { "peakBytes", usage.peakBytes },
+        { "allocations", usage.allocationCount },
+    };
+}
+
+nlohmann::json Gfx::MemorySnapshot::toJson() const
+{
+    auto heapsJson = nlohmann::json::array();
+    for (size_t i = 0; i < heaps.size(); ++i) {
+        const auto& heap = heaps[i];
+
+        auto heapJson = ::toJson(heap.tracked);
+        heapJson["index"] = i;
+        heapJson["size"] = heap.size;
+        heapJson["deviceLocal"] = heap.deviceLocal;
+        if (hasBudget) {
+            heapJson["budget"] = heap.budget;
+            heapJson["usage"] = heap.usage;
+            heapJson["overBudget"] = heap.isOverBudget();
+        }
+        heapsJson.push_back(std::move(heapJson));
+    }
+
+    auto categoriesJson = nlohmann::json::object();
+    for (size_t i = 0; i < categories.size(); ++i) {
+        categoriesJson[toString(static_cast<MemoryCategory>(i))] = ::toJson(categories[i]);
+    }
+
+    return {
+        { "total", ::toJson(total) },
+        { "heaps", std::move(heapsJson) },
+        { "categories", std::move(categoriesJson) },
+    };
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <nlohmann/json_fwd.hpp>
+#include <vector>
+#include <vulkan/vulkan_raii.hpp>
+
+namespace Gfx
+{
+	// What an allocation is used for, so a scene over budget shows which subsystem to trim
+	enum class MemoryCategory
+	{
+		Other,
+		GBuffer,
+		Shadow,
+		RenderTarget, // depth and intermediate color targets outside the G-buffer
+		Texture,
+		Geometry, // vertex, index, indirect and instance data
+		Uniform,
+		Staging, // uploads and readbacks
+		Count
+	};
+
+	const char* toString(MemoryCategory category);
+
+	// Counts the device memory allocated through RHI, per memory heap and per category.
+	//
+	// - Every Buffer/Image owns an Allocation that is subtracted again when the resource is destroyed
+	// - Lock-free, so resources can be created and destroyed on any thread
+	class MemoryTracker
+	{
+	public:
+		struct Usage
+		{
+			vk::DeviceSize bytes = 0;
+			vk::DeviceSize peakBytes = 0; // high-water mark since the tracker was created
+			uint32_t allocationCount = 0;
+		};
+
+		// Move-only token for one tracked allocation
+		class Allocation
+		{
+		public:
+			Allocation() = default;
+			Allocation(MemoryTracker& tracker, uint32_t heapIndex, MemoryCategory category, vk::DeviceSize size);
+			Allocation(Allocation&& other) noexcept;
+			Allocation& operator=(Allocation&& other) noexcept;
+			Allocation(const Allocation&) = delete;
+			~Allocation();
+
+			vk::DeviceSize getSize() const { return m_size; }
+
+		private:
+			void release();
+
+		private:
+			MemoryTracker* m_tracker = nullptr;
+			uint32_t m_heapIndex = 0;
+			MemoryCategory m_category = MemoryCategory::Other;
+			vk::DeviceSize m_size = 0;
+		};
+
+		MemoryTracker() = default;
+		MemoryTracker(const MemoryTracker&) = delete;
+
+		Allocation track(uint32_t heapIndex, MemoryCategory category, vk::DeviceSize size) { return Allocation(*this, heapIndex, category, size); }
+
+		Usage getHeapUsage(uint32_t heapIndex) const;
+		Usage getCategoryUsage(MemoryCategory category) const;
+		Usage getTotalUsage() const;
+
+	private:
+		struct Counters
+		{
+			std::atomic<vk::DeviceSize> bytes{ 0 };
+			std::atomic<vk::DeviceSize> peakBytes{ 0 };
+			std::atomic<uint32_t> allocationCount{ 0 };
+
+			void add(vk::DeviceSize size);
+			void remove(vk::DeviceSize size);
+			Usage load() const;
+		};
+
+		std::array<Counters, VK_MAX_MEMORY_HEAPS> m_heaps{};
+		std::array<Counters, static_cast<size_t>(MemoryCategory::Count)> m_categories{};
+		Counters m_total{};
+	};
+
+	struct MemoryHeapSnapshot
+	{
+		vk::DeviceSize size = 0;
+		bool deviceLocal = false;
+		MemoryTracker::Usage tracked{}; // allocated through RHI
+
+		// From VK_EXT_memory_budget, 0 without it. Usage covers the whole process (and the driver's own allocations),
+		// the budget is what the process can allocate before it risks eviction or failed allocations.
+		vk::DeviceSize budget = 0;
+		vk::DeviceSize usage = 0;
+
+		bool isOverBudget() const { return budget != 0 && usage > budget; }
+	};
+
+	// Point-in-time view of the device memory, see RHI::getMemorySnapshot()
+	struct MemorySnapshot
+	{
+		std::vector<MemoryHeapSnapshot> heaps;
+		std::array<MemoryTracker::Usage, static_cast<size_t>(MemoryCategory::Count)> categories{};
+		MemoryTracker::Usage total{};
+		bool hasBudget = false;
+
+		nlohmann::json toJson() const;
+	};
+}
@@ -2,9 +2,41 @@
 
 using Gfx::Pipeline;
 
-Pipeline::Pipeline(vk::raii::Pipeline&& pipeline, vk::raii::PipelineLayout&& pipelineLayout, vk::raii::DescriptorSetLayout&& descriptorSetLayout):
-	m_pipeline(std::move(pipeline)),
-	m_pipelineLayout(std::move(pipelineLayout)),
-	m_descriptorSetLayout(std::move(descriptorSetLayout))
+Pipeline::Pipeline(const std::shared_ptr<vk::raii::Pipeline>& pipeline, const std::shared_ptr<vk::raii::PipelineLayout>& pipelineLayout, vk::raii::DescriptorSetLayout&& descriptorSetLayout, const std::shared_ptr<PipelineStats>& stats):
+	m_pipeline(pipeline),
+	m_pipelineLayout(pipelineLayout),
+	m_descriptorSetLayout(std::move(descriptorSetLayout)),
+	m_stats(stats)
 {
 }
+
+void Pipeline::setState(const vk::raii::CommandBuffer& cmd, const GraphicsState& state) const
+{
+	for (auto dynamicState : m_dynamicStates) {
+		switch (dynamicState) {
+		case vk::DynamicState::ePrimitiveTopology:
+			cmd.setPrimitiveTopology(state.topology);
+			break;
+		case vk::DynamicState::ePolygonModeEXT:
+			cmd.setPolygonModeEXT(state.polygonMode);
+			break;
+		case vk::DynamicState::eCullMode:
+			cmd.setCullMode(state.cullMode);
+			break;
+		case vk::DynamicState::eFrontFace:
+			cmd.setFrontFace(state.frontFace);
+			break;
+		case vk::DynamicState::eDepthTestEnable:
+			cmd.setDepthTestEnable(state.depthTestEnable);
+			break;
+		case vk::DynamicState::eDepthWriteEnable:
+			cmd.setDepthWriteEnable(state.depthWriteEnable);
+			break;
+		case vk::DynamicState::eDepthCompareOp:
+			cmd.setDepthCompareOp(state.depthCompareOp);
+			break;
+		default:
+			break; // viewport and scissor are set by the pass
+		}
+	}
+}
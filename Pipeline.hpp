@@ -9,7 +9,7 @@ namespace Gfx
 	private:
 		friend class RHI;
 
-		Pipeline(vk::raii::Pipeline&& pipeline, vk::raii::PipelineLayout&& pipelineLayout, vk::raii::DescriptorSetLayout&& descriptorSetLayout);
+		Pipeline(const std::shared_ptr<vk::raii::Pipeline>& pipeline, const std::shared_ptr<vk::raii::PipelineLayout>& pipelineLayout, vk::raii::DescriptorSetLayout&& descriptorSetLayout, const std::shared_ptr<PipelineStats>& stats);
 
 	public:
 		Pipeline(nullptr_t) :
@@ -21,15 +21,27 @@ namespace Gfx
 
 		Pipeline() = delete;
 
-		operator vk::Pipeline() const { return *m_pipeline; }
-		vk::Pipeline operator*() const { return *m_pipeline; }
+		// Binds the fallback while a requested pipeline is still building
+		operator vk::Pipeline() const { return isReady() || !m_fallback ? **m_pipeline : **m_fallback; }
+		vk::Pipeline operator*() const { return static_cast<vk::Pipeline>(*this); }
 
-		const vk::raii::PipelineLayout& getPipelineLayout() const { return m_pipelineLayout; }
+		bool isReady() const { return m_pipeline && **m_pipeline; }
+		bool isUsable() const { return isReady() || (m_fallback && **m_fallback); }
+		const PipelineStats& getStats() const { return *m_stats; }
+
+		// Sets the states this pipeline left dynamic, call after binding it
+		void setState(const vk::raii::CommandBuffer& cmd, const GraphicsState& state) const;
+
+		const vk::raii::PipelineLayout& getPipelineLayout() const { return *m_pipelineLayout; }
 		const vk::raii::DescriptorSetLayout& getDescriptorSetLayout() const { return m_descriptorSetLayout; }
 
 	private:
-		vk::raii::Pipeline m_pipeline;
-		vk::raii::PipelineLayout m_pipelineLayout;
+		// Shared with RHI, which swaps in rebuilt pipelines at frame boundaries when shaders are hot reloaded
+		std::shared_ptr<vk::raii::Pipeline> m_pipeline;
+		std::shared_ptr<vk::raii::PipelineLayout> m_pipelineLayout;
 		vk::raii::DescriptorSetLayout m_descriptorSetLayout;
+		std::shared_ptr<vk::raii::Pipeline> m_fallback;
+		std::vector<vk::DynamicState> m_dynamicStates;
+		std::shared_ptr<PipelineStats> m_stats;
 	};
 }
@@ -1,6 +1,9 @@
 #include "RHI.hpp"
 
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
 #include <memory>
 #include <unordered_map>
 #include <windows.h>
@@ -11,8 +14,13 @@
 
 #include "Buffer.hpp"
 #include "DescriptorSet.hpp"
+#include "GpuPrimitives.hpp"
 #include "Image.hpp"
 #include "Pipeline.hpp"
+#include "ReadbackRing.hpp"
+#include "ShaderCompiler.hpp"
+#include "ShaderWatcher.hpp"
+#include "ThreadPool.hpp"
 
 using Gfx::RHI;
 
@@ -28,6 +36,15 @@ const std::vector<char const*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
 
+// Enough for a few frames of 4K RGBA8 screenshots in flight, allocated by the first readback
+const vk::DeviceSize readbackRingSize = 128ull * 1024 * 1024;
+
+// Largest scan, compaction or sort through getPrimitives(); the scratch for the latter two is only allocated once used
+const uint32_t primitivesMaxElements = 16u * 1024 * 1024;
+
+// In the shader cache directory, the driver's compiled pipelines from the last run
+const char* pipelineCacheFile = "pipelines.bin";
+
 const std::vector<const char*> deviceExtensions = {
     vk::KHRSwapchainExtensionName,
     vk::KHRSpirv14ExtensionName,
@@ -35,6 +52,12 @@ const std::vector<const char*> deviceExtensions = {
     vk::KHRCreateRenderpass2ExtensionName,
 };
 
+// Enabled when available, pipelines are built monolithically without them
+const std::vector<const char*> graphicsPipelineLibraryExtensions = {
+    vk::KHRPipelineLibraryExtensionName,
+    vk::EXTGraphicsPipelineLibraryExtensionName,
+};
+
 static std::tuple<uint32_t, uint32_t> findQueueFamilies(const vk::raii::PhysicalDevice& physicalDevice, const vk::raii::SurfaceKHR& surface) {
     // find the index of the first queue family that supports graphics
     auto queueFamilyProperties = physicalDevice.getQueueFamilyProperties();
@@ -126,7 +149,11 @@ static uint32_t chooseSwapMinImageCount(const vk::SurfaceCapabilitiesKHR& surfac
     return minImageCount;
 }
 
-static vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes) {
+static vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes, bool vsync) {
+    if (!vsync && std::find(availablePresentModes.begin(), availablePresentModes.end(), vk::PresentModeKHR::eImmediate) != availablePresentModes.end()) {
+        return vk::PresentModeKHR::eImmediate;
+    }
+
     for (const auto& availablePresentMode : availablePresentModes) {
         if (availablePresentMode == vk::PresentModeKHR::eMailbox) {
             return availablePresentMode;
@@ -209,41 +236,157 @@ static void transitionImageLayout(const vk::raii::CommandBuffer& commandBuffer,
     commandBuffer.pipelineBarrier(sourceStage, destinationStage, {}, {}, nullptr, barrier);
 }
 
-static std::vector<char> readFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+static vk::raii::ShaderModule createShaderModule(const vk::raii::Device& device, const std::vector<uint32_t>& code) {
+    vk::ShaderModuleCreateInfo createInfo{};
+    createInfo.codeSize = code.size() * sizeof(uint32_t);
+    createInfo.pCode = code.data();
+
+    return vk::raii::ShaderModule{ device, createInfo };
+}
 
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file!");
+static vk::SpecializationInfo getSpecializationInfo(const Gfx::ShaderDesc& shader) {
+    vk::SpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(shader.specializationEntries.size());
+    specializationInfo.pMapEntries = shader.specializationEntries.data();
+    specializationInfo.dataSize = shader.specializationData.size();
+    specializationInfo.pData = shader.specializationData.data();
+    return specializationInfo;
+}
+
+// FNV-1a over the state a pipeline library depends on
+static uint64_t hashInit() {
+    return 14695981039346656037ull;
+}
+
+static void hashAppend(uint64_t& hash, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
     }
+}
 
-    std::vector<char> buffer(file.tellg());
+template<typename... T>
+static void hashValues(uint64_t& hash, const T&... values) {
+    static_assert((std::is_trivially_copyable_v<T> && ...), "only plain values can be hashed");
+    (hashAppend(hash, &values, sizeof(T)), ...);
+}
 
-    file.seekg(0, std::ios::beg);
-    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-    file.close();
+static uint64_t hashPipelineLayout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings) {
+    uint64_t hash = hashInit();
+    for (const auto& binding : bindings) {
+        hashValues(hash, binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags);
+    }
+    return hash;
+}
 
-    return buffer;
+static void hashShader(uint64_t& hash, const Gfx::ShaderDesc& shader, const std::vector<uint32_t>& code) {
+    hashValues(hash, shader.stage);
+    hashAppend(hash, code.data(), code.size() * sizeof(uint32_t));
+    for (const auto& entry : shader.specializationEntries) {
+        hashValues(hash, entry.constantID, entry.offset, entry.size);
+    }
+    hashAppend(hash, shader.specializationData.data(), shader.specializationData.size());
 }
 
-static vk::raii::ShaderModule createShaderModule(const vk::raii::Device& device, const std::vector<char>& code) {
-    vk::ShaderModuleCreateInfo createInfo{};
-    createInfo.codeSize = code.size() * sizeof(char);
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+static std::vector<std::string> getShaderDependencies(const Gfx::ShaderCompiler& compiler, const std::vector<Gfx::ShaderDesc>& shaders) {
+    std::vector<std::string> dependencies{};
+    for (const auto& shader : shaders) {
+        if (std::filesystem::path(shader.path).extension() == ".spv") {
+            continue; // precompiled, nothing to recompile
+        }
+        for (auto& dependency : compiler.getDependencies(shader.path)) {
+            if (std::find(dependencies.begin(), dependencies.end(), dependency) == dependencies.end()) {
+                dependencies.emplace_back(std::move(dependency));
+            }
+        }
+    }
+    return dependencies;
+}
 
-    return vk::raii::ShaderModule{ device, createInfo };
+static std::vector<Gfx::ShaderDesc> getShaders(const std::variant<Gfx::GraphicsPipelineCreateInfo, Gfx::ComputePipelineCreateInfo>& createInfo) {
+    if (auto graphicsCreateInfo = std::get_if<Gfx::GraphicsPipelineCreateInfo>(&createInfo)) {
+        return graphicsCreateInfo->shaders;
+    }
+    return { std::get<Gfx::ComputePipelineCreateInfo>(createInfo).shader };
+}
+
+static Gfx::PipelineStageFeedback getStageFeedback(vk::ShaderStageFlagBits stage, const vk::PipelineCreationFeedback& feedback) {
+    Gfx::PipelineStageFeedback result{};
+    result.stage = stage;
+    result.valid = static_cast<bool>(feedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid);
+    result.cacheHit = static_cast<bool>(feedback.flags & vk::PipelineCreationFeedbackFlagBits::eApplicationPipelineCacheHit);
+    result.milliseconds = static_cast<double>(feedback.duration) / 1e6;
+    return result;
 }
 
-void RHI::init(const std::string& appName, const std::vector<const char*>& extensions, void* window) {
+// Feedback of one vkCreate*Pipelines call, the stage entries match `stages`
+static Gfx::PipelineFeedback getPipelineFeedback(
+    const vk::PipelineCreationFeedback& pipelineFeedback,
+    const std::vector<vk::PipelineCreationFeedback>& stageFeedbacks,
+    const vk::PipelineShaderStageCreateInfo* stages)
+{
+    auto pipeline = getStageFeedback({}, pipelineFeedback);
+
+    Gfx::PipelineFeedback result{};
+    result.valid = pipeline.valid;
+    result.cacheHit = pipeline.cacheHit;
+    result.milliseconds = pipeline.milliseconds;
+    for (size_t i = 0; i < stageFeedbacks.size(); ++i) {
+        result.stages.push_back(getStageFeedback(stages[i].stage, stageFeedbacks[i]));
+    }
+    return result;
+}
+
+// Chains creation feedback for a pipeline with `stageCount` stages in front of `next`
+struct CreationFeedbackInfo
+{
+    vk::PipelineCreationFeedback pipeline{};
+    std::vector<vk::PipelineCreationFeedback> stages;
+    vk::PipelineCreationFeedbackCreateInfo createInfo{};
+
+    CreationFeedbackInfo(size_t stageCount, const void* next) :
+        stages(stageCount)
+    {
+        createInfo.pNext = next;
+        createInfo.pPipelineCreationFeedback = &pipeline;
+        createInfo.pipelineStageCreationFeedbackCount = static_cast<uint32_t>(stages.size());
+        createInfo.pPipelineStageCreationFeedbacks = stages.data();
+    }
+    CreationFeedbackInfo(const CreationFeedbackInfo&) = delete;
+};
+
+RHI::RHI() :
+    m_workers(std::make_unique<ThreadPool>())
+{
+    m_shaderCompiler = std::make_unique<ShaderCompiler>(*m_workers);
+}
+
+RHI::~RHI()
+{
+    try {
+        savePipelineCache();
+    }
+    catch (const std::exception& e) {
+        // only costs time on the next start
+        std::cerr << "failed to save the pipeline cache: " << e.what() << std::endl;
+    }
+}
+
+void RHI::init(const std::string& appName, const std::vector<const char*>& extensions, void* window, bool vsync) {
     initInstance(appName, extensions);
     initSurface(window);
     pickPhysicalDevice();
     initLogicalDevice();
-    initSwapChain(window);
+    initSwapChain(window, vsync);
     initDepthResources();
     initCommandPool();
+    initPipelineCache();
+    initReadback();
 }
 
-void RHI::initInstance(const std::string& appName, const std::vector<const char*>& extensions) {
+void RHI::initInstance(const std::string& appName, const std::vector<const char*>& requiredExtensions) {
+    auto extensions = requiredExtensions;
     vk::ApplicationInfo appInfo{};
     appInfo.pApplicationName = appName.c_str();
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
@@ -287,6 +430,15 @@ void RHI::initInstance(const std::string& appName, const std::vector<const char*
         }
     }
 
+#ifdef GFX_DEBUG_UTILS
+    // optional, names and labels are skipped without it
+    m_debugUtils = std::any_of(extensionProperties.begin(), extensionProperties.end(),
+        [](auto const& extensionProperty) { return strcmp(extensionProperty.extensionName, vk::EXTDebugUtilsExtensionName) == 0; });
+    if (m_debugUtils) {
+        extensions.push_back(vk::EXTDebugUtilsExtensionName);
+    }
+#endif
+
     vk::InstanceCreateInfo createInfo{};
     createInfo.pApplicationInfo = &appInfo;
     createInfo.enabledLayerCount = static_cast<uint32_t>(requiredLayers.size());
@@ -354,9 +506,26 @@ void RHI::initLogicalDevice() {
     features2.features.samplerAnisotropy = true;
     features2.features.multiDrawIndirect = true;
 
+    auto properties = m_physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+    m_subgroupProperties = properties.get<vk::PhysicalDeviceSubgroupProperties>();
+    m_subgroupProperties.pNext = nullptr;
+
+    // 16-bit math and storage are optional, they only enable the USE_FP16 shader permutations
+    auto supportedCoreFeatures = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features, vk::PhysicalDeviceVulkan12Features>();
+    m_shaderFloat16 = supportedCoreFeatures.get<vk::PhysicalDeviceVulkan12Features>().shaderFloat16;
+
+    // pipeline statistics only feed the depth prepass heuristic, which falls back to a fixed choice without them
+    m_pipelineStatisticsQuery = supportedCoreFeatures.get<vk::PhysicalDeviceFeatures2>().features.pipelineStatisticsQuery;
+    features2.features.pipelineStatisticsQuery = m_pipelineStatisticsQuery;
+
+    vk::PhysicalDeviceVulkan11Features vulkan11Features{};
+    vulkan11Features.multiview = true; // required by Vulkan 1.1, renders the shadow cascades in one pass
+    vulkan11Features.storageBuffer16BitAccess = supportedCoreFeatures.get<vk::PhysicalDeviceVulkan11Features>().storageBuffer16BitAccess;
+
     vk::PhysicalDeviceVulkan12Features vulkan12Features{};
     vulkan12Features.runtimeDescriptorArray = true;
     vulkan12Features.shaderSampledImageArrayNonUniformIndexing = true;
+    vulkan12Features.shaderFloat16 = m_shaderFloat16;
 
     vk::PhysicalDeviceVulkan13Features vulkan13Features{};
     vulkan13Features.dynamicRendering = true; // Enable dynamic rendering from Vulkan 1.3
@@ -365,27 +534,77 @@ void RHI::initLogicalDevice() {
     vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT extDynamicStateFeatures{};
     extDynamicStateFeatures.extendedDynamicState = true; // Enable extended dynamic state from the extension
 
+    vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures{};
+    graphicsPipelineLibraryFeatures.graphicsPipelineLibrary = true;
+
+    vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT extDynamicState3Features{};
+
     // Create a chain of feature structures
     auto featureChain = vk::StructureChain<
         vk::PhysicalDeviceFeatures2,
+        vk::PhysicalDeviceVulkan11Features,
         vk::PhysicalDeviceVulkan12Features,
         vk::PhysicalDeviceVulkan13Features,
-        vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>
-    { features2, vulkan12Features, vulkan13Features, extDynamicStateFeatures };
+        vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT,
+        vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT,
+        vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>
+    { features2, vulkan11Features, vulkan12Features, vulkan13Features, extDynamicStateFeatures, graphicsPipelineLibraryFeatures, extDynamicState3Features };
+
+    auto enabledExtensions = deviceExtensions;
+    auto availableExtensions = m_physicalDevice.enumerateDeviceExtensionProperties();
+    auto isExtensionAvailable = [&](const char* extension) {
+        return std::any_of(availableExtensions.begin(), availableExtensions.end(),
+            [extension](auto& ext) { return strcmp(ext.extensionName, extension) == 0; });
+    };
+
+    m_graphicsPipelineLibrary = std::all_of(graphicsPipelineLibraryExtensions.begin(), graphicsPipelineLibraryExtensions.end(), isExtensionAvailable);
+    if (m_graphicsPipelineLibrary) {
+        auto supportedFeatures = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+        m_graphicsPipelineLibrary = supportedFeatures.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>().graphicsPipelineLibrary;
+    }
+
+    if (m_graphicsPipelineLibrary) {
+        enabledExtensions.insert(enabledExtensions.end(), graphicsPipelineLibraryExtensions.begin(), graphicsPipelineLibraryExtensions.end());
+    }
+    else {
+        featureChain.unlink<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+    }
+
+    // extended dynamic state 3 is optional, every state it supports is enabled
+    if (isExtensionAvailable(vk::EXTExtendedDynamicState3ExtensionName)) {
+        auto supportedFeatures = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+        m_extendedDynamicState3Features = supportedFeatures.get<vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+        m_extendedDynamicState3Features.pNext = nullptr;
+
+        auto& enabledFeatures = featureChain.get<vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+        auto pNext = enabledFeatures.pNext;
+        enabledFeatures = m_extendedDynamicState3Features;
+        enabledFeatures.pNext = pNext;
+        enabledExtensions.push_back(vk::EXTExtendedDynamicState3ExtensionName);
+    }
+    else {
+        featureChain.unlink<vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT>();
+    }
+
+    // budget telemetry only, nothing depends on it
+    m_memoryBudget = isExtensionAvailable(vk::EXTMemoryBudgetExtensionName);
+    if (m_memoryBudget) {
+        enabledExtensions.push_back(vk::EXTMemoryBudgetExtensionName);
+    }
 
     vk::DeviceCreateInfo deviceCreateInfo{};
     deviceCreateInfo.pNext = &featureChain.get<vk::PhysicalDeviceFeatures2>();
     deviceCreateInfo.queueCreateInfoCount = 1;
     deviceCreateInfo.pQueueCreateInfos = &deviceQueueCreateInfo;
-    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     m_device = vk::raii::Device(m_physicalDevice, deviceCreateInfo);
     m_graphicsQueue = vk::raii::Queue(m_device, m_graphicsFamily, 0);
     m_presentQueue = vk::raii::Queue(m_device, m_presentFamily, 0);
 }
 
-void RHI::initSwapChain(void* window) {
+void RHI::initSwapChain(void* window, bool vsync) {
     auto surfaceCapabilities = m_physicalDevice.getSurfaceCapabilitiesKHR(m_surface);
     auto availableFormats = m_physicalDevice.getSurfaceFormatsKHR(m_surface);
     auto availablePresentModes = m_physicalDevice.getSurfacePresentModesKHR(m_surface);
@@ -402,8 +621,11 @@ void RHI::initSwapChain(void* window) {
     swapChainCreateInfo.imageExtent = m_swapChainExtent;
     swapChainCreateInfo.imageArrayLayers = 1; // keep 1 unless rendering for VR
     swapChainCreateInfo.imageUsage = vk::ImageUsageFlagBits::eColorAttachment; // we are rendering to image directly
+    if (surfaceCapabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc) {
+        swapChainCreateInfo.imageUsage |= vk::ImageUsageFlagBits::eTransferSrc; // so presented frames can be read back
+    }
     swapChainCreateInfo.preTransform = surfaceCapabilities.currentTransform;  // don't apply further transformation
-    swapChainCreateInfo.presentMode = chooseSwapPresentMode(availablePresentModes);
+    swapChainCreateInfo.presentMode = chooseSwapPresentMode(availablePresentModes, vsync);
     swapChainCreateInfo.clipped = true;  // don't update the pixels that are obscured
 
     uint32_t queueFamilyIndices[] = { m_graphicsFamily, m_presentFamily };
@@ -415,6 +637,7 @@ void RHI::initSwapChain(void* window) {
     }
 
     m_swapChain = vk::raii::SwapchainKHR(m_device, swapChainCreateInfo);
+    m_swapChainUsage = swapChainCreateInfo.imageUsage;
 
     auto swapChainImages = m_swapChain.getImages();
 
@@ -449,7 +672,7 @@ void RHI::initDepthResources()
     depthImageInfo.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
 
     for (size_t i = 0; i < m_maxFramesInFlight; i++) {
-        auto depthImage = createImage(depthImageInfo);
+        auto depthImage = createImage(depthImageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTarget);
         m_depthImageObjs.emplace_back(*depthImage);
         m_depthImages.emplace_back(std::move(depthImage));
     }
@@ -464,12 +687,81 @@ void RHI::initCommandPool()
     m_commandPool = vk::raii::CommandPool(m_device, poolInfo);
 }
 
+void RHI::initReadback()
+{
+    m_readback = std::make_unique<ReadbackRing>(*this, readbackRingSize);
+}
+
+Gfx::GpuPrimitives& RHI::getPrimitives()
+{
+    // compiles its pipelines, so only applications that use it pay for it
+    if (!m_primitives) {
+        m_primitives = std::make_unique<GpuPrimitives>(*this, primitivesMaxElements);
+    }
+    return *m_primitives;
+}
+
+void RHI::initPipelineCache()
+{
+    auto path = std::filesystem::path(m_shaderCompiler->getCacheDirectory()) / pipelineCacheFile;
+
+    std::vector<char> data{};
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    // drivers should reject data of another device or driver version themselves, not all of them do
+    auto properties = m_physicalDevice.getProperties();
+    vk::PipelineCacheHeaderVersionOne header{};
+    if (data.size() >= sizeof(header)) {
+        std::memcpy(&header, data.data(), sizeof(header));
+    }
+    auto compatible = header.headerSize >= sizeof(header) && header.headerSize <= data.size() &&
+        header.headerVersion == vk::PipelineCacheHeaderVersion::eOne &&
+        header.vendorID == properties.vendorID &&
+        header.deviceID == properties.deviceID &&
+        header.pipelineCacheUUID == properties.pipelineCacheUUID;
+
+    vk::PipelineCacheCreateInfo cacheInfo{};
+    if (compatible) {
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.data();
+    }
+
+    m_pipelineCache = vk::raii::PipelineCache(m_device, cacheInfo);
+}
+
+void RHI::savePipelineCache() const
+{
+    if (!*m_pipelineCache) {
+        return;
+    }
+
+    auto data = m_pipelineCache.getData();
+    auto path = std::filesystem::path(m_shaderCompiler->getCacheDirectory()) / pipelineCacheFile;
+    auto tempPath = path;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream file(tempPath, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open " + tempPath.string() + "!");
+        }
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+
+    std::filesystem::rename(tempPath, path);
+}
+
 const vk::raii::ImageView& RHI::getDepthImageView(int index) const
 {
     return m_depthImages[index].getImageView();
 }
 
-Gfx::Buffer RHI::createBuffer(const vk::BufferCreateInfo& bufferInfo, vk::MemoryPropertyFlags memProperties)
+Gfx::Buffer RHI::createBuffer(const vk::BufferCreateInfo& bufferInfo, vk::MemoryPropertyFlags memProperties, MemoryCategory category)
 {
     vk::raii::Buffer buffer(m_device, bufferInfo);
 
@@ -483,7 +775,14 @@ Gfx::Buffer RHI::createBuffer(const vk::BufferCreateInfo& bufferInfo, vk::Memory
 
     buffer.bindMemory(bufferMemory, 0);
 
-    return Gfx::Buffer(std::move(buffer), std::move(bufferMemory), bufferInfo.size);
+    auto heapIndex = m_physicalDevice.getMemoryProperties().memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+
+#ifdef GFX_DEBUG_UTILS
+    // only what RHI knows about the buffer, enough to tell allocations apart in a capture
+    setDebugName(*buffer, std::string(toString(category)) + " buffer (" + std::to_string(bufferInfo.size) + " bytes)");
+#endif
+
+    return Gfx::Buffer(std::move(buffer), std::move(bufferMemory), bufferInfo.size, m_memoryTracker.track(heapIndex, category, allocInfo.allocationSize));
 }
 
 void RHI::updateBuffer(const Buffer& buffer, const void* contentData, size_t contentSize)
@@ -494,7 +793,8 @@ void RHI::updateBuffer(const Buffer& buffer, const void* contentData, size_t con
 
     auto stagingBuffer = createBuffer(stagingInfo,
         vk::MemoryPropertyFlagBits::eHostVisible |
-        vk::MemoryPropertyFlagBits::eHostCoherent);
+        vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Staging);
 
     stagingBuffer.map();
     memcpy(stagingBuffer.getMappedData(), contentData, stagingInfo.size);
@@ -521,7 +821,7 @@ void RHI::updateBuffer(const Buffer& buffer, const void* contentData, size_t con
     m_graphicsQueue.waitIdle();
 }
 
-Gfx::Image RHI::createImage(const vk::ImageCreateInfo& imageInfo, vk::MemoryPropertyFlags properties)
+Gfx::Image RHI::createImage(const vk::ImageCreateInfo& imageInfo, vk::MemoryPropertyFlags properties, MemoryCategory category, vk::ImageViewType viewType)
 {
     vk::raii::Image image(m_device, imageInfo);
 
@@ -537,18 +837,27 @@ Gfx::Image RHI::createImage(const vk::ImageCreateInfo& imageInfo, vk::MemoryProp
 
     vk::ImageViewCreateInfo viewInfo{};
     viewInfo.image = image;
-    viewInfo.viewType = vk::ImageViewType::e2D;
+    viewInfo.viewType = viewType;
     viewInfo.format = imageInfo.format;
     viewInfo.subresourceRange.aspectMask =
         imageInfo.usage & vk::ImageUsageFlagBits::eDepthStencilAttachment
         ? vk::ImageAspectFlagBits::eDepth
         : vk::ImageAspectFlagBits::eColor;
     viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.layerCount = 1;
+    viewInfo.subresourceRange.layerCount = imageInfo.arrayLayers;
 
     vk::raii::ImageView imageView(m_device, viewInfo);
 
-    return Gfx::Image(std::move(image), std::move(imageMemory), std::move(imageView), imageInfo.extent, imageInfo.format);
+#ifdef GFX_DEBUG_UTILS
+    auto name = std::string(toString(category)) + " image (" + std::to_string(imageInfo.extent.width) + "x" +
+        std::to_string(imageInfo.extent.height) + " " + vk::to_string(imageInfo.format) + ")";
+    setDebugName(*image, name);
+    setDebugName(*imageView, name);
+#endif
+
+    auto heapIndex = m_physicalDevice.getMemoryProperties().memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+
+    return Gfx::Image(std::move(image), std::move(imageMemory), std::move(imageView), imageInfo.extent, imageInfo.format, m_memoryTracker.track(heapIndex, category, allocInfo.allocationSize));
 }
 
 void RHI::updateImage(const Gfx::Image& image, const void* contentData, size_t contentSize)
@@ -559,7 +868,8 @@ void RHI::updateImage(const Gfx::Image& image, const void* contentData, size_t c
 
     auto stagingBuffer = createBuffer(stagingInfo,
         vk::MemoryPropertyFlagBits::eHostVisible |
-        vk::MemoryPropertyFlagBits::eHostCoherent);
+        vk::MemoryPropertyFlagBits::eHostCoherent,
+        MemoryCategory::Staging);
 
     stagingBuffer.map();
     memcpy(stagingBuffer.getMappedData(), contentData, stagingInfo.size);
@@ -591,7 +901,100 @@ void RHI::updateImage(const Gfx::Image& image, const void* contentData, size_t c
     m_graphicsQueue.waitIdle();
 }
 
-Gfx::Pipeline RHI::createGraphicsPipeline(const Gfx::GraphicsPipelineCreateInfo& createInfo)
+Gfx::MemorySnapshot RHI::getMemorySnapshot() const
+{
+    MemorySnapshot snapshot{};
+    snapshot.total = m_memoryTracker.getTotalUsage();
+    snapshot.hasBudget = m_memoryBudget;
+
+    for (size_t i = 0; i < snapshot.categories.size(); ++i) {
+        snapshot.categories[i] = m_memoryTracker.getCategoryUsage(static_cast<MemoryCategory>(i));
+    }
+
+    // the budget struct may only be chained with VK_EXT_memory_budget enabled
+    vk::PhysicalDeviceMemoryProperties memoryProperties{};
+    vk::PhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    if (m_memoryBudget) {
+        auto properties = m_physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        memoryProperties = properties.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+        budgetProperties = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    }
+    else {
+        memoryProperties = m_physicalDevice.getMemoryProperties2().memoryProperties;
+    }
+
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        MemoryHeapSnapshot heap{};
+        heap.size = memoryProperties.memoryHeaps[i].size;
+        heap.deviceLocal = static_cast<bool>(memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        heap.tracked = m_memoryTracker.getHeapUsage(i);
+        if (m_memoryBudget) {
+            heap.budget = budgetProperties.heapBudget[i];
+            heap.usage = budgetProperties.heapUsage[i];
+        }
+        snapshot.heaps.push_back(heap);
+    }
+
+    return snapshot;
+}
+
+void RHI::setDebugName(vk::ObjectType type, uint64_t handle, const std::string& name) const
+{
+    if (!m_debugUtils) {
+        return;
+    }
+
+    vk::DebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.objectType = type;
+    nameInfo.objectHandle = handle;
+    nameInfo.pObjectName = name.c_str();
+    m_device.setDebugUtilsObjectNameEXT(nameInfo);
+}
+
+bool RHI::isWaveOpsSupported(vk::ShaderStageFlagBits stage, vk::SubgroupFeatureFlags operations) const
+{
+    return (m_subgroupProperties.supportedStages & stage) && (m_subgroupProperties.supportedOperations & operations) == operations;
+}
+
+bool RHI::isDynamicStateSupported(vk::DynamicState state) const
+{
+    switch (state) {
+    // core in Vulkan 1.3 (extended dynamic state and extended dynamic state 2)
+    case vk::DynamicState::eViewport:
+    case vk::DynamicState::eScissor:
+    case vk::DynamicState::ePrimitiveTopology:
+    case vk::DynamicState::eCullMode:
+    case vk::DynamicState::eFrontFace:
+    case vk::DynamicState::eDepthTestEnable:
+    case vk::DynamicState::eDepthWriteEnable:
+    case vk::DynamicState::eDepthCompareOp:
+        return true;
+    // extended dynamic state 3
+    case vk::DynamicState::ePolygonModeEXT:
+        return m_extendedDynamicState3Features.extendedDynamicState3PolygonMode;
+    // anything Pipeline::setState can't set would be left undefined at draw time
+    default:
+        return false;
+    }
+}
+
+std::vector<vk::DynamicState> RHI::getDynamicStates(const Gfx::GraphicsPipelineCreateInfo& createInfo) const
+{
+    std::vector<vk::DynamicState> dynamicStates = {
+        vk::DynamicState::eViewport,
+        vk::DynamicState::eScissor
+    };
+
+    for (auto state : createInfo.dynamicStates) {
+        if (isDynamicStateSupported(state) && std::find(dynamicStates.begin(), dynamicStates.end(), state) == dynamicStates.end()) {
+            dynamicStates.push_back(state);
+        }
+    }
+
+    return dynamicStates;
+}
+
+vk::raii::Pipeline RHI::buildGraphicsPipeline(const Gfx::GraphicsPipelineCreateInfo& createInfo, const vk::raii::PipelineLayout& pipelineLayout, const std::vector<std::vector<uint32_t>>& shaderCodes, bool optimized, PipelineFeedback& feedback, std::vector<std::shared_ptr<vk::raii::Pipeline>>& libraries)
 {
     std::vector<vk::Format> colorAttachmentFormats{};
 	std::vector<vk::PipelineColorBlendAttachmentState> colorBlendAttachments{};
@@ -604,53 +1007,49 @@ Gfx::Pipeline RHI::createGraphicsPipeline(const Gfx::GraphicsPipelineCreateInfo&
 
         vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
         colorBlendAttachment.colorWriteMask = colorAttachment.writeMask;
+        colorBlendAttachment.blendEnable = colorAttachment.blendEnable;
+        colorBlendAttachment.srcColorBlendFactor = colorAttachment.srcBlendFactor;
+        colorBlendAttachment.dstColorBlendFactor = colorAttachment.dstBlendFactor;
+        colorBlendAttachment.srcAlphaBlendFactor = colorAttachment.srcBlendFactor;
+        colorBlendAttachment.dstAlphaBlendFactor = colorAttachment.dstBlendFactor;
 
         colorBlendAttachments.emplace_back(std::move(colorBlendAttachment));
 	}
 
-    vk::DescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.bindingCount = static_cast<uint32_t>(createInfo.descriptorSetLayoutBindings.size());
-    layoutInfo.pBindings = createInfo.descriptorSetLayoutBindings.data();
-
-    vk::raii::DescriptorSetLayout descriptorSetLayout(m_device, layoutInfo);
-
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &*descriptorSetLayout;
-
-    vk::raii::PipelineLayout pipelineLayout(m_device, pipelineLayoutInfo);
-
     vk::PipelineRenderingCreateInfo pipelineRenderingCreateInfo{};
     pipelineRenderingCreateInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachmentFormats.size());
     pipelineRenderingCreateInfo.pColorAttachmentFormats = colorAttachmentFormats.data();
 	pipelineRenderingCreateInfo.depthAttachmentFormat = createInfo.depthAttachment.format;
+    pipelineRenderingCreateInfo.viewMask = createInfo.viewMask;
 
     std::vector<vk::PipelineShaderStageCreateInfo> shaderStages{};
     std::vector<vk::raii::ShaderModule> shaderModules{};
+    std::vector<vk::SpecializationInfo> specializationInfos{};
 
 	shaderStages.reserve(createInfo.shaders.size());
 	shaderModules.reserve(createInfo.shaders.size());
+	specializationInfos.reserve(createInfo.shaders.size()); // stage infos point into this, so it must not reallocate
+
+    for (size_t i = 0; i < createInfo.shaders.size(); ++i) {
+        auto& shader = createInfo.shaders[i];
+        auto module = createShaderModule(m_device, shaderCodes[i]);
 
-    for (auto& shader : createInfo.shaders) {
-        auto code = readFile(shader.path);
-        auto module = createShaderModule(m_device, code);
+        auto& specializationInfo = specializationInfos.emplace_back(getSpecializationInfo(shader));
 
         vk::PipelineShaderStageCreateInfo shaderStageInfo{};
         shaderStageInfo.stage = shader.stage;
         shaderStageInfo.module = module;
         shaderStageInfo.pName = "main";
+        shaderStageInfo.pSpecializationInfo = shader.specializationEntries.empty() ? nullptr : &specializationInfo;
 
         shaderModules.emplace_back(std::move(module));
         shaderStages.emplace_back(std::move(shaderStageInfo));
 	}
 
     vk::PipelineInputAssemblyStateCreateInfo inputAssembly{};
-    inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
+    inputAssembly.topology = createInfo.state.topology;
 
-    std::array<vk::DynamicState, 2> dynamicStates = {
-        vk::DynamicState::eViewport,
-        vk::DynamicState::eScissor
-    };
+    auto dynamicStates = getDynamicStates(createInfo);
     vk::PipelineDynamicStateCreateInfo dynamicState{
         {},
         static_cast<uint32_t>(dynamicStates.size()),
@@ -662,7 +1061,9 @@ Gfx::Pipeline RHI::createGraphicsPipeline(const Gfx::GraphicsPipelineCreateInfo&
     viewportState.scissorCount = 1;
 
     vk::PipelineRasterizationStateCreateInfo rasterizer{};
-    rasterizer.cullMode = vk::CullModeFlagBits::eBack;
+    rasterizer.polygonMode = createInfo.state.polygonMode;
+    rasterizer.cullMode = createInfo.state.cullMode;
+    rasterizer.frontFace = createInfo.state.frontFace;
     rasterizer.lineWidth = 1.0f;
 
     vk::PipelineMultisampleStateCreateInfo multisampling{};
@@ -672,10 +1073,12 @@ Gfx::Pipeline RHI::createGraphicsPipeline(const Gfx::GraphicsPipelineCreateInfo&
     colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
     colorBlending.pAttachments = colorBlendAttachments.data();
 
+    auto hasDepth = createInfo.depthAttachment.format != vk::Format::eUndefined;
+
     vk::PipelineDepthStencilStateCreateInfo depthStencil{};
-    depthStencil.depthTestEnable = createInfo.depthAttachment.format != vk::Format::eUndefined;
-    depthStencil.depthWriteEnable = depthStencil.depthTestEnable;
-    depthStencil.depthCompareOp = vk::CompareOp::eLess;
+    depthStencil.depthTestEnable = hasDepth && createInfo.state.depthTestEnable;
+    depthStencil.depthWriteEnable = hasDepth && createInfo.state.depthWriteEnable;
+    depthStencil.depthCompareOp = createInfo.state.depthCompareOp;
 
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(createInfo.vertexInputBindings.size());
@@ -683,54 +1086,563 @@ Gfx::Pipeline RHI::createGraphicsPipeline(const Gfx::GraphicsPipelineCreateInfo&
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(createInfo.vertexInputAttributes.size());
     vertexInputInfo.pVertexAttributeDescriptions = createInfo.vertexInputAttributes.data();
 
+    if (!m_graphicsPipelineLibrary) {
+        CreationFeedbackInfo feedbackInfo(shaderStages.size(), &pipelineRenderingCreateInfo);
+
+        vk::GraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.pNext = &feedbackInfo.createInfo;
+        pipelineInfo.stageCount = shaderStages.size();
+        pipelineInfo.pStages = shaderStages.data();
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.layout = pipelineLayout;
+
+        vk::raii::Pipeline pipeline(m_device, m_pipelineCache, pipelineInfo);
+        setDebugName(*pipeline, createInfo.name);
+        feedback = getPipelineFeedback(feedbackInfo.pipeline, feedbackInfo.stages, shaderStages.data());
+        return pipeline;
+    }
+
+    // With graphics pipeline libraries every part is cached on the state it depends on, so pipelines
+    // sharing vertex input, shaders or attachment formats only build the parts that differ
+    std::vector<vk::PipelineShaderStageCreateInfo> preRasterizationStages{};
+    std::vector<vk::PipelineShaderStageCreateInfo> fragmentStages{};
+
+    uint64_t preRasterizationKey = hashPipelineLayout(createInfo.descriptorSetLayoutBindings);
+    uint64_t fragmentKey = preRasterizationKey;
+
+    for (size_t i = 0; i < createInfo.shaders.size(); ++i) {
+        auto fragment = createInfo.shaders[i].stage == vk::ShaderStageFlagBits::eFragment;
+        (fragment ? fragmentStages : preRasterizationStages).push_back(shaderStages[i]);
+        hashShader(fragment ? fragmentKey : preRasterizationKey, createInfo.shaders[i], shaderCodes[i]);
+    }
+
+    uint64_t vertexInputKey = hashInit();
+    for (const auto& binding : createInfo.vertexInputBindings) {
+        hashValues(vertexInputKey, binding.binding, binding.stride, binding.inputRate);
+    }
+    for (const auto& attribute : createInfo.vertexInputAttributes) {
+        hashValues(vertexInputKey, attribute.location, attribute.binding, attribute.format, attribute.offset);
+    }
+    hashValues(vertexInputKey, inputAssembly.topology, inputAssembly.primitiveRestartEnable);
+
+    hashValues(preRasterizationKey, rasterizer.polygonMode, rasterizer.cullMode, rasterizer.frontFace, rasterizer.lineWidth);
+
+    hashValues(fragmentKey, depthStencil.depthTestEnable, depthStencil.depthWriteEnable, depthStencil.depthCompareOp, multisampling.rasterizationSamples,
+        createInfo.depthAttachment.format);
+
+    uint64_t fragmentOutputKey = hashInit();
+    for (const auto& colorAttachment : createInfo.colorAttachments) {
+        hashValues(fragmentOutputKey, colorAttachment.format, colorAttachment.writeMask,
+            colorAttachment.blendEnable, colorAttachment.srcBlendFactor, colorAttachment.dstBlendFactor);
+    }
+    hashValues(fragmentOutputKey, createInfo.depthAttachment.format, multisampling.rasterizationSamples);
+
+    // the libraries that take the rendering info must all agree on the view mask
+    for (auto key : { &preRasterizationKey, &fragmentKey, &fragmentOutputKey }) {
+        hashValues(*key, createInfo.viewMask);
+    }
+
+    // each library only uses the dynamic states of its own part, so all of them get the full list
+    for (auto key : { &vertexInputKey, &preRasterizationKey, &fragmentKey, &fragmentOutputKey }) {
+        for (auto state : dynamicStates) {
+            hashValues(*key, state);
+        }
+    }
+
+    vk::GraphicsPipelineCreateInfo vertexInputLibrary{};
+    vertexInputLibrary.pVertexInputState = &vertexInputInfo;
+    vertexInputLibrary.pInputAssemblyState = &inputAssembly;
+    vertexInputLibrary.pDynamicState = &dynamicState;
+
+    vk::GraphicsPipelineCreateInfo preRasterizationLibrary{};
+    preRasterizationLibrary.pNext = &pipelineRenderingCreateInfo;
+    preRasterizationLibrary.stageCount = static_cast<uint32_t>(preRasterizationStages.size());
+    preRasterizationLibrary.pStages = preRasterizationStages.data();
+    preRasterizationLibrary.pDynamicState = &dynamicState;
+    preRasterizationLibrary.pViewportState = &viewportState;
+    preRasterizationLibrary.pRasterizationState = &rasterizer;
+    preRasterizationLibrary.layout = pipelineLayout;
+
+    vk::GraphicsPipelineCreateInfo fragmentLibrary{};
+    fragmentLibrary.pNext = &pipelineRenderingCreateInfo;
+    fragmentLibrary.stageCount = static_cast<uint32_t>(fragmentStages.size());
+    fragmentLibrary.pStages = fragmentStages.data();
+    fragmentLibrary.pMultisampleState = &multisampling;
+    fragmentLibrary.pDepthStencilState = &depthStencil;
+    fragmentLibrary.pDynamicState = &dynamicState;
+    fragmentLibrary.layout = pipelineLayout;
+
+    vk::GraphicsPipelineCreateInfo fragmentOutputLibrary{};
+    fragmentOutputLibrary.pNext = &pipelineRenderingCreateInfo;
+    fragmentOutputLibrary.pMultisampleState = &multisampling;
+    fragmentOutputLibrary.pColorBlendState = &colorBlending;
+    fragmentOutputLibrary.pDynamicState = &dynamicState;
+
+    std::array<PipelineFeedback, 4> libraryFeedbacks{};
+    libraries = {
+        getPipelineLibrary(vertexInputKey, vertexInputLibrary, vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface, libraryFeedbacks[0]),
+        getPipelineLibrary(preRasterizationKey, preRasterizationLibrary, vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders, libraryFeedbacks[1]),
+        getPipelineLibrary(fragmentKey, fragmentLibrary, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader, libraryFeedbacks[2]),
+        getPipelineLibrary(fragmentOutputKey, fragmentOutputLibrary, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface, libraryFeedbacks[3]),
+    };
+
+    std::array<vk::Pipeline, 4> libraryHandles{};
+    for (size_t i = 0; i < libraries.size(); ++i) {
+        libraryHandles[i] = **libraries[i];
+    }
+
+    vk::PipelineLibraryCreateInfoKHR libraryInfo{};
+    libraryInfo.libraryCount = static_cast<uint32_t>(libraryHandles.size());
+    libraryInfo.pLibraries = libraryHandles.data();
+
+    // a link has no stages of its own, they were reported by the libraries
+    CreationFeedbackInfo feedbackInfo(0, &libraryInfo);
+
+    // a plain link is fast enough to do in-frame, the link-time optimized one is built afterwards in the background
     vk::GraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.pNext = &pipelineRenderingCreateInfo;
-    pipelineInfo.stageCount = shaderStages.size();
-    pipelineInfo.pStages = shaderStages.data();
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pDynamicState = &dynamicState;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pNext = &feedbackInfo.createInfo;
+    pipelineInfo.flags = optimized ? vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT : vk::PipelineCreateFlags{};
     pipelineInfo.layout = pipelineLayout;
 
-    vk::raii::Pipeline pipeline(m_device, nullptr, pipelineInfo);
+    vk::raii::Pipeline pipeline(m_device, m_pipelineCache, pipelineInfo);
+    setDebugName(*pipeline, createInfo.name);
 
-	return Gfx::Pipeline(std::move(pipeline), std::move(pipelineLayout), std::move(descriptorSetLayout));
+    feedback = getPipelineFeedback(feedbackInfo.pipeline, {}, nullptr);
+    for (const auto& libraryFeedback : libraryFeedbacks) {
+        feedback.valid = feedback.valid && libraryFeedback.valid;
+        feedback.cacheHit = feedback.cacheHit && libraryFeedback.cacheHit;
+        feedback.milliseconds += libraryFeedback.milliseconds;
+        feedback.stages.insert(feedback.stages.end(), libraryFeedback.stages.begin(), libraryFeedback.stages.end());
+    }
+    return pipeline;
 }
 
-Gfx::Pipeline RHI::createComputePipeline(const Gfx::ComputePipelineCreateInfo& createInfo)
+std::shared_ptr<vk::raii::Pipeline> RHI::getPipelineLibrary(uint64_t key, vk::GraphicsPipelineCreateInfo libraryInfo, vk::GraphicsPipelineLibraryFlagsEXT parts, PipelineFeedback& feedback)
 {
-    vk::DescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.bindingCount = static_cast<uint32_t>(createInfo.descriptorSetLayoutBindings.size());
-    layoutInfo.pBindings = createInfo.descriptorSetLayoutBindings.data();
+    hashValues(key, parts);
 
-    vk::raii::DescriptorSetLayout descriptorSetLayout(m_device, layoutInfo);
+    {
+        std::lock_guard<std::mutex> lock(m_pipelineLibraryMutex);
+        auto libraryIter = m_pipelineLibraries.find(key);
+        if (libraryIter != m_pipelineLibraries.end()) {
+            // built for an earlier pipeline, this one didn't pay for it
+            feedback.valid = true;
+            feedback.cacheHit = true;
+            for (uint32_t i = 0; i < libraryInfo.stageCount; ++i) {
+                feedback.stages.push_back({ libraryInfo.pStages[i].stage, true, true, 0.0 });
+            }
+            return libraryIter->second;
+        }
+    }
 
-    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &*descriptorSetLayout;
+    CreationFeedbackInfo feedbackInfo(libraryInfo.stageCount, libraryInfo.pNext);
+
+    vk::GraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo{};
+    libraryCreateInfo.pNext = &feedbackInfo.createInfo;
+    libraryCreateInfo.flags = parts;
+
+    libraryInfo.pNext = &libraryCreateInfo;
+    libraryInfo.flags |= vk::PipelineCreateFlagBits::eLibraryKHR | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT;
+
+    auto library = std::make_shared<vk::raii::Pipeline>(m_device, m_pipelineCache, libraryInfo);
+    feedback = getPipelineFeedback(feedbackInfo.pipeline, feedbackInfo.stages, libraryInfo.pStages);
+
+    // another worker may have built the same part meanwhile, keep the first one
+    std::lock_guard<std::mutex> lock(m_pipelineLibraryMutex);
+    return m_pipelineLibraries.emplace(key, library).first->second;
+}
 
-    vk::raii::PipelineLayout pipelineLayout(m_device, pipelineLayoutInfo);
+vk::raii::Pipeline RHI::buildComputePipeline(const Gfx::ComputePipelineCreateInfo& createInfo, const vk::raii::PipelineLayout& pipelineLayout, const std::vector<uint32_t>& shaderCode, PipelineFeedback& feedback) const
+{
+    auto shaderModule = createShaderModule(m_device, shaderCode);
 
-    auto code = readFile(createInfo.shader.path);
-    auto shaderModule = createShaderModule(m_device, code);
+    auto specializationInfo = getSpecializationInfo(createInfo.shader);
 
     vk::PipelineShaderStageCreateInfo shaderStageInfo{};
     shaderStageInfo.stage = createInfo.shader.stage;
     shaderStageInfo.module = shaderModule;
     shaderStageInfo.pName = "main";
+    shaderStageInfo.pSpecializationInfo = createInfo.shader.specializationEntries.empty() ? nullptr : &specializationInfo;
+
+    CreationFeedbackInfo feedbackInfo(1, nullptr);
 
     vk::ComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.pNext = &feedbackInfo.createInfo;
     pipelineInfo.stage = shaderStageInfo;
     pipelineInfo.layout = pipelineLayout;
 
-    vk::raii::Pipeline pipeline(m_device, nullptr, pipelineInfo);
+    vk::raii::Pipeline pipeline(m_device, m_pipelineCache, pipelineInfo);
+    setDebugName(*pipeline, createInfo.name);
+    feedback = getPipelineFeedback(feedbackInfo.pipeline, feedbackInfo.stages, &shaderStageInfo);
+    return pipeline;
+}
+
+std::tuple<vk::raii::DescriptorSetLayout, std::shared_ptr<vk::raii::PipelineLayout>> RHI::createPipelineLayout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings, uint32_t pushConstantSize) const
+{
+    vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
 
-    return Gfx::Pipeline(std::move(pipeline), std::move(pipelineLayout), std::move(descriptorSetLayout));
+    vk::raii::DescriptorSetLayout descriptorSetLayout(m_device, layoutInfo);
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &*descriptorSetLayout;
+
+    vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eCompute, 0, pushConstantSize };
+    if (pushConstantSize > 0) {
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    }
+
+    auto pipelineLayout = std::make_shared<vk::raii::PipelineLayout>(m_device, pipelineLayoutInfo);
+
+    return { std::move(descriptorSetLayout), pipelineLayout };
+}
+
+std::shared_ptr<RHI::PipelineRecord> RHI::createPipelineRecord(
+    const std::variant<GraphicsPipelineCreateInfo, ComputePipelineCreateInfo>& createInfo,
+    const std::string& name,
+    const std::shared_ptr<vk::raii::Pipeline>& pipeline,
+    const std::shared_ptr<vk::raii::PipelineLayout>& pipelineLayout) const
+{
+    auto record = std::make_shared<PipelineRecord>();
+    record->createInfo = createInfo;
+    record->pipeline = pipeline;
+    record->pipelineLayout = pipelineLayout;
+    record->requestTime = std::chrono::steady_clock::now();
+    record->stats = std::make_shared<PipelineStats>();
+    record->stats->name = name;
+    return record;
+}
+
+Gfx::Pipeline RHI::createGraphicsPipeline(const Gfx::GraphicsPipelineCreateInfo& createInfo, bool registered)
+{
+    auto [descriptorSetLayout, pipelineLayout] = createPipelineLayout(createInfo.descriptorSetLayoutBindings);
+    auto pipeline = std::make_shared<vk::raii::Pipeline>(nullptr);
+    auto record = createPipelineRecord(createInfo, createInfo.name, pipeline, pipelineLayout);
+
+    // compile all stages concurrently, most of them are cache hits anyway; a worker compiles them itself,
+    // waiting on jobs queued behind it could deadlock a saturated pool
+    std::vector<std::vector<uint32_t>> shaderCodes{};
+    shaderCodes.reserve(createInfo.shaders.size());
+    if (ThreadPool::isWorkerThread()) {
+        for (auto& shader : createInfo.shaders) {
+            shaderCodes.emplace_back(m_shaderCompiler->compile(shader));
+        }
+    }
+    else {
+        std::vector<std::future<std::vector<uint32_t>>> shaderJobs{};
+        shaderJobs.reserve(createInfo.shaders.size());
+        for (auto& shader : createInfo.shaders) {
+            shaderJobs.emplace_back(m_shaderCompiler->compileAsync(shader));
+        }
+
+        for (auto& shaderJob : shaderJobs) {
+            shaderCodes.emplace_back(shaderJob.get());
+        }
+    }
+
+    *pipeline = buildGraphicsPipeline(createInfo, *pipelineLayout, shaderCodes, false, record->stats->feedback, record->libraries);
+    record->stats->optimized = !m_graphicsPipelineLibrary;
+
+    if (registered) {
+        record->dependencies = getShaderDependencies(*m_shaderCompiler, createInfo.shaders);
+        registerPipeline(record, true);
+
+        if (m_graphicsPipelineLibrary) {
+            queueOptimizedLink(record, 0, std::move(shaderCodes));
+        }
+    }
+
+    Gfx::Pipeline result(pipeline, pipelineLayout, std::move(descriptorSetLayout), record->stats);
+    result.m_dynamicStates = getDynamicStates(createInfo);
+    return result;
+}
+
+Gfx::Pipeline RHI::createComputePipeline(const Gfx::ComputePipelineCreateInfo& createInfo, bool registered)
+{
+    auto [descriptorSetLayout, pipelineLayout] = createPipelineLayout(createInfo.descriptorSetLayoutBindings, createInfo.pushConstantSize);
+    auto pipeline = std::make_shared<vk::raii::Pipeline>(nullptr);
+    auto record = createPipelineRecord(createInfo, createInfo.name, pipeline, pipelineLayout);
+
+    auto code = m_shaderCompiler->compile(createInfo.shader);
+    *pipeline = buildComputePipeline(createInfo, *pipelineLayout, code, record->stats->feedback);
+    record->stats->optimized = true;
+
+    if (registered) {
+        record->dependencies = getShaderDependencies(*m_shaderCompiler, { createInfo.shader });
+        registerPipeline(record, true);
+    }
+
+    return Gfx::Pipeline(pipeline, pipelineLayout, std::move(descriptorSetLayout), record->stats);
+}
+
+Gfx::Pipeline RHI::requestGraphicsPipeline(const Gfx::GraphicsPipelineCreateInfo& createInfo, const Gfx::Pipeline* fallback)
+{
+    auto [descriptorSetLayout, pipelineLayout] = createPipelineLayout(createInfo.descriptorSetLayoutBindings);
+    auto pipeline = std::make_shared<vk::raii::Pipeline>(nullptr);
+    auto record = createPipelineRecord(createInfo, createInfo.name, pipeline, pipelineLayout);
+
+    registerPipeline(record, false);
+
+    Gfx::Pipeline result(pipeline, pipelineLayout, std::move(descriptorSetLayout), record->stats);
+    result.m_dynamicStates = getDynamicStates(createInfo);
+    if (fallback) {
+        result.m_fallback = fallback->m_pipeline;
+    }
+    return result;
+}
+
+Gfx::Pipeline RHI::requestComputePipeline(const Gfx::ComputePipelineCreateInfo& createInfo, const Gfx::Pipeline* fallback)
+{
+    auto [descriptorSetLayout, pipelineLayout] = createPipelineLayout(createInfo.descriptorSetLayoutBindings, createInfo.pushConstantSize);
+    auto pipeline = std::make_shared<vk::raii::Pipeline>(nullptr);
+    auto record = createPipelineRecord(createInfo, createInfo.name, pipeline, pipelineLayout);
+
+    registerPipeline(record, false);
+
+    Gfx::Pipeline result(pipeline, pipelineLayout, std::move(descriptorSetLayout), record->stats);
+    if (fallback) {
+        result.m_fallback = fallback->m_pipeline;
+    }
+    return result;
+}
+
+void RHI::reportPipelineUse(const Gfx::Pipeline& pipeline)
+{
+    if (pipeline.isReady() || !pipeline.m_stats) {
+        return;
+    }
+
+    if (pipeline.m_fallback && **pipeline.m_fallback) {
+        ++pipeline.m_stats->fallbackFrames;
+    }
+    else {
+        ++pipeline.m_stats->skippedFrames;
+    }
+}
+
+std::vector<Gfx::PipelineStats> RHI::getPipelineStats()
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+
+    std::vector<PipelineStats> stats{};
+    stats.reserve(m_pipelineRecords.size());
+    for (const auto& record : m_pipelineRecords) {
+        if (!record->pipeline.expired()) {
+            stats.push_back(*record->stats);
+        }
+    }
+    return stats;
+}
+
+bool RHI::hasPendingPipelineSwaps()
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    return !m_pendingPipelineSwaps.empty();
+}
+
+void RHI::enableShaderHotReload()
+{
+    if (m_shaderWatcher) {
+        return;
+    }
+
+    m_shaderWatcher = std::make_unique<ShaderWatcher>([this](const std::vector<std::string>& changedFiles) {
+        onShadersChanged(changedFiles);
+    });
+
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    for (const auto& record : m_pipelineRecords) {
+        m_shaderWatcher->watch(record->dependencies);
+    }
+}
+
+void RHI::beginFrame(uint64_t frame)
+{
+    // the fence of this frame slot has been waited on, so nothing older than a full ring of frames is in flight
+    m_retiredPipelines.erase(
+        std::remove_if(m_retiredPipelines.begin(), m_retiredPipelines.end(),
+            [&](const auto& retired) { return frame >= retired.first + m_maxFramesInFlight; }),
+        m_retiredPipelines.end());
+
+    std::vector<PendingPipelineSwap> swaps{};
+    {
+        std::lock_guard<std::mutex> lock(m_pipelineMutex);
+        swaps.swap(m_pendingPipelineSwaps);
+
+        // watched from here rather than the workers, which may still be running while the watcher is destroyed
+        if (m_shaderWatcher) {
+            for (const auto& swap : swaps) {
+                m_shaderWatcher->watch(swap.record->dependencies);
+            }
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    for (auto& swap : swaps) {
+        auto pipeline = swap.record->pipeline.lock();
+        if (!pipeline || swap.version <= swap.record->appliedVersion) {
+            continue; // the pipeline is gone, or a newer build finished first
+        }
+
+        // frames still in flight may reference the old pipeline, keep it alive until they complete
+        m_retiredPipelines.emplace_back(frame, std::move(*pipeline));
+        *pipeline = std::move(swap.pipeline);
+        swap.record->appliedVersion = swap.version;
+        swap.record->libraries = std::move(swap.libraries);
+
+        auto& stats = *swap.record->stats;
+        stats.optimized = (swap.version & 1) != 0;
+        stats.feedback = std::move(swap.feedback);
+        if (!stats.ready) {
+            stats.ready = true;
+            stats.waitMilliseconds = std::chrono::duration<double, std::milli>(now - swap.record->requestTime).count();
+        }
+    }
+
+    m_readback->beginFrame(frame);
+}
+
+void RHI::registerPipeline(const std::shared_ptr<PipelineRecord>& record, bool ready)
+{
+    if (ready) {
+        record->stats->ready = true;
+        record->stats->waitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - record->requestTime).count();
+    }
+
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    prunePipelineRecords();
+    m_pipelineRecords.push_back(record);
+
+    if (ready) {
+        if (m_shaderWatcher) {
+            m_shaderWatcher->watch(record->dependencies);
+        }
+    }
+    else {
+        // built like a hot reload, the first swap in beginFrame() makes it ready
+        auto generation = ++record->generation;
+        m_workers->submit([this, record, generation]() { rebuildPipeline(record, generation); });
+    }
+}
+
+void RHI::prunePipelineRecords()
+{
+    // forget pipelines the application has destroyed
+    m_pipelineRecords.erase(
+        std::remove_if(m_pipelineRecords.begin(), m_pipelineRecords.end(),
+            [](const auto& record) { return record->pipeline.expired(); }),
+        m_pipelineRecords.end());
+
+    // and the libraries no pipeline record, pending swap or build holds any more, e.g. those of shader versions
+    // replaced by hot reloads; an unregistered pipeline's stay until here
+    std::lock_guard<std::mutex> lock(m_pipelineLibraryMutex);
+    for (auto it = m_pipelineLibraries.begin(); it != m_pipelineLibraries.end();) {
+        it = it->second.use_count() == 1 ? m_pipelineLibraries.erase(it) : std::next(it);
+    }
+}
+
+void RHI::onShadersChanged(const std::vector<std::string>& changedFiles)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    prunePipelineRecords();
+
+    for (const auto& record : m_pipelineRecords) {
+        auto affected = std::any_of(changedFiles.begin(), changedFiles.end(), [&](const std::string& file) {
+            return std::find(record->dependencies.begin(), record->dependencies.end(), file) != record->dependencies.end();
+        });
+
+        if (affected) {
+            auto generation = ++record->generation;
+            m_workers->submit([this, record, generation]() { rebuildPipeline(record, generation); });
+        }
+    }
+}
+
+void RHI::queueOptimizedLink(const std::shared_ptr<PipelineRecord>& record, uint64_t generation, std::vector<std::vector<uint32_t>> shaderCodes)
+{
+    m_workers->submit([this, record, generation, shaderCodes = std::move(shaderCodes)]() {
+        {
+            std::lock_guard<std::mutex> lock(m_pipelineMutex);
+            if (generation != record->generation) {
+                return; // superseded by a newer rebuild
+            }
+        }
+
+        auto pipelineLayout = record->pipelineLayout.lock();
+        if (!pipelineLayout) {
+            return;
+        }
+
+        try {
+            PipelineFeedback feedback{};
+            std::vector<std::shared_ptr<vk::raii::Pipeline>> libraries{};
+            auto pipeline = buildGraphicsPipeline(std::get<GraphicsPipelineCreateInfo>(record->createInfo), *pipelineLayout, shaderCodes, true, feedback, libraries);
+
+            std::lock_guard<std::mutex> lock(m_pipelineMutex);
+            m_pendingPipelineSwaps.push_back({ record, generation * 2 + 1, std::move(pipeline), std::move(feedback), std::move(libraries) });
+        }
+        catch (const std::exception& e) {
+            // the fast-linked pipeline keeps working
+            std::cerr << "failed to optimize pipeline " << record->stats->name << ": " << e.what() << std::endl;
+        }
+    });
+}
+
+void RHI::rebuildPipeline(const std::shared_ptr<PipelineRecord>& record, uint64_t generation)
+{
+    // keep the layout alive while building, the application may destroy the pipeline meanwhile
+    auto pipelineLayout = record->pipelineLayout.lock();
+    if (!pipelineLayout) {
+        return;
+    }
+
+    auto shaders = getShaders(record->createInfo);
+
+    try {
+        // compiled synchronously, waiting on other jobs from a worker could starve the pool
+        std::vector<std::vector<uint32_t>> shaderCodes{};
+        shaderCodes.reserve(shaders.size());
+        for (const auto& shader : shaders) {
+            shaderCodes.emplace_back(m_shaderCompiler->compile(shader));
+        }
+
+        PipelineFeedback feedback{};
+        std::vector<std::shared_ptr<vk::raii::Pipeline>> libraries{};
+        auto graphics = std::holds_alternative<GraphicsPipelineCreateInfo>(record->createInfo);
+        auto pipeline = graphics
+            ? buildGraphicsPipeline(std::get<GraphicsPipelineCreateInfo>(record->createInfo), *pipelineLayout, shaderCodes, false, feedback, libraries)
+            : buildComputePipeline(std::get<ComputePipelineCreateInfo>(record->createInfo), *pipelineLayout, shaderCodes[0], feedback);
+        auto linked = graphics && m_graphicsPipelineLibrary;
+
+        // includes may have been added or removed by the edit
+        auto dependencies = getShaderDependencies(*m_shaderCompiler, shaders);
+
+        {
+            std::lock_guard<std::mutex> lock(m_pipelineMutex);
+            record->dependencies = std::move(dependencies);
+            m_pendingPipelineSwaps.push_back({ record, generation * 2 + (linked ? 0 : 1), std::move(pipeline), std::move(feedback), std::move(libraries) });
+        }
+
+        if (linked) {
+            queueOptimizedLink(record, generation, std::move(shaderCodes));
+        }
+    }
+    catch (const std::exception& e) {
+        // keep rendering with the previous pipeline (or the fallback) until the shader is fixed
+        auto& name = record->stats->name.empty() ? shaders.front().path : record->stats->name;
+        std::cerr << "failed to build pipeline " << name << ": " << e.what() << std::endl;
+    }
 }
 
 std::vector<std::vector<Gfx::DescriptorSet>> RHI::createDescriptorSets(const std::vector<Gfx::DescriptorSetConfig>& configs)
@@ -787,6 +1699,13 @@ std::vector<std::vector<Gfx::DescriptorSet>> RHI::createDescriptorSets(const std
         auto sets = m_device.allocateDescriptorSets(allocInfo);
         for (auto& set : sets)
         {
+#ifdef GFX_DEBUG_UTILS
+            if (!config.name.empty())
+            {
+                setDebugName(*set, config.name + "[" + std::to_string(descriptorSets.size()) + "]");
+            }
+#endif
+
             auto descriptorSet = DescriptorSet(pool, std::move(set));
 
             descriptorSets.emplace_back(std::move(descriptorSet));
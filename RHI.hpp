@@ -1,19 +1,56 @@
 #pragma once
 
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <variant>
 #include <vulkan/vulkan_raii.hpp>
 
+#include "MemoryTracker.hpp"
+
 namespace Gfx
 {
 	class Buffer;
 	class DescriptorSet;
 	class Image;
 	class Pipeline;
+	class GpuPrimitives;
+	class ReadbackRing;
+	class ShaderCompiler;
+	class ShaderWatcher;
+	class ThreadPool;
 
 	struct ShaderDesc
 	{
+		// .hlsl sources are compiled at runtime through ShaderCompiler, .spv files are loaded as-is
 		std::string path;
 		vk::ShaderStageFlagBits stage;
+
+		// Permutation defines passed to the compiler, e.g. "USE_FP16=1", which also compiles with native 16-bit types
+		// and needs isShaderFloat16Supported()
+		std::vector<std::string> defines;
+
+		// Specialization constants: map entries index into specializationData.
+		// HLSL declares them as [[vk::constant_id(N)]] const T name = default;
+		std::vector<vk::SpecializationMapEntry> specializationEntries;
+		std::vector<uint8_t> specializationData;
+
+		// Appends a specialization constant. Use VkBool32 for bool constants.
+		template<typename T>
+		ShaderDesc& setConstant(uint32_t constantID, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "specialization constants must be trivially copyable");
+
+			auto offset = static_cast<uint32_t>(specializationData.size());
+			specializationEntries.emplace_back(constantID, offset, sizeof(T));
+			specializationData.resize(offset + sizeof(T));
+			memcpy(specializationData.data() + offset, &value, sizeof(T));
+			return *this;
+		}
 	};
 
 	struct ColorAttachmentDesc
@@ -24,6 +61,11 @@ namespace Gfx
 			vk::ColorComponentFlagBits::eG |
 			vk::ColorComponentFlagBits::eB |
 			vk::ColorComponentFlagBits::eA;
+
+		// result = src * srcBlendFactor + dst * dstBlendFactor, for color and alpha alike
+		bool blendEnable = false;
+		vk::BlendFactor srcBlendFactor = vk::BlendFactor::eOne;
+		vk::BlendFactor dstBlendFactor = vk::BlendFactor::eZero;
 	};
 
 	struct DepthAttachmentDesc
@@ -31,20 +73,73 @@ namespace Gfx
 		vk::Format format;
 	};
 
+	// Fixed-function state that GraphicsPipelineCreateInfo::dynamicStates can leave dynamic.
+	// Baked into the pipeline otherwise; Pipeline::setState() sets the dynamic part while recording.
+	struct GraphicsState
+	{
+		vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+		vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+		vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+		vk::FrontFace frontFace = vk::FrontFace::eCounterClockwise;
+		bool depthTestEnable = true; // only with a depth attachment
+		bool depthWriteEnable = true;
+		vk::CompareOp depthCompareOp = vk::CompareOp::eLess;
+	};
+
 	struct GraphicsPipelineCreateInfo
 	{
+		std::string name; // for stats and error messages
 		std::vector<ShaderDesc> shaders;
 		std::vector<vk::VertexInputBindingDescription> vertexInputBindings;
 		std::vector<vk::VertexInputAttributeDescription> vertexInputAttributes;
 		std::vector<vk::DescriptorSetLayoutBinding> descriptorSetLayoutBindings;
 		std::vector<ColorAttachmentDesc> colorAttachments;
 		DepthAttachmentDesc depthAttachment;
+		GraphicsState state;
+
+		// Multiview: every draw renders once per set bit into that layer of the attachments, shaders get the
+		// bit index as SV_ViewID; 0 renders a single view. Must match RenderingInfo::viewMask.
+		uint32_t viewMask = 0;
+
+		// States set while recording instead of baked in, so one pipeline serves every combination of them.
+		// Viewport and scissor are always dynamic; states the device does not support are baked from `state`.
+		std::vector<vk::DynamicState> dynamicStates;
 	};
 
 	struct ComputePipelineCreateInfo
 	{
+		std::string name; // for stats and error messages
 		ShaderDesc shader;
 		std::vector<vk::DescriptorSetLayoutBinding> descriptorSetLayoutBindings;
+		uint32_t pushConstantSize = 0; // bytes at offset 0, [[vk::push_constant]] in HLSL
+	};
+
+	struct PipelineStageFeedback
+	{
+		vk::ShaderStageFlagBits stage{};
+		bool valid = false; // drivers may leave out stages
+		bool cacheHit = false;
+		double milliseconds = 0.0;
+	};
+
+	// Pipeline creation feedback the driver reported for a build
+	struct PipelineFeedback
+	{
+		bool valid = false;
+		bool cacheHit = false; // nothing was compiled, the pipeline came from the pipeline cache (or reused libraries)
+		double milliseconds = 0.0; // with pipeline libraries, the link plus the libraries built for it
+		std::vector<PipelineStageFeedback> stages;
+	};
+
+	struct PipelineStats
+	{
+		std::string name;
+		bool ready = false;
+		bool optimized = false; // false while a fast-linked pipeline library build waits for its link-time optimized version
+		double waitMilliseconds = 0.0; // from the create/request call until the pipeline could be used
+		uint64_t fallbackFrames = 0; // frames drawn with the fallback pipeline while this one was building
+		uint64_t skippedFrames = 0; // frames whose pass was skipped because nothing was ready
+		PipelineFeedback feedback; // of the build in use
 	};
 
 	struct DescriptorBinding
@@ -60,15 +155,27 @@ namespace Gfx
 	{
 		vk::DescriptorSetLayout layout;
 		std::vector<DescriptorBinding> bindings;
+		std::string name; // debug name, the sets are called name[frame]
 	};
 
 	class RHI
 	{
 	public:
-		RHI() = default;
+		RHI();
 		RHI(const RHI&) = delete;
+		~RHI();
+
+		// Without vsync the swapchain presents immediately (tearing) where the surface allows it, for rendering as fast as possible
+		void init(const std::string& appName, const std::vector<const char*>& extensions, void* window, bool vsync = true);
+
+		// Watches the sources of every pipeline created through this RHI. Edited shaders are recompiled and
+		// the affected pipelines rebuilt on the worker threads; the results are swapped in by beginFrame().
+		void enableShaderHotReload();
 
-		void init(const std::string& appName, const std::vector<const char*>& extensions, void* window);
+		// Called once per frame after its fence has been waited on, before recording.
+		// Swaps in pipelines rebuilt since the last frame and destroys the ones no frame in flight still uses,
+		// and completes the readbacks of the frames that have finished.
+		void beginFrame(uint64_t frame);
 
 		const vk::raii::PhysicalDevice& getPhysicalDevice() const { return m_physicalDevice; }
 		const vk::raii::Device& getDevice() const { return m_device; }
@@ -83,15 +190,69 @@ namespace Gfx
 		const vk::raii::ImageView& getSwapChainImageView(int index) const { return m_swapChainImageViews[index]; }
 		const vk::raii::ImageView& getDepthImageView(int index) const;
 		vk::Extent2D getSwapChainExtent() const { return m_swapChainExtent; }
+		vk::ImageUsageFlags getSwapChainUsage() const { return m_swapChainUsage; } // includes eTransferSrc when the surface allows it
+		ShaderCompiler& getShaderCompiler() const { return *m_shaderCompiler; }
+		ThreadPool& getWorkers() const { return *m_workers; }
+		const MemoryTracker& getMemoryTracker() const { return m_memoryTracker; }
 
-		Buffer createBuffer(const vk::BufferCreateInfo& bufferInfo, vk::MemoryPropertyFlags memProperties = vk::MemoryPropertyFlagBits::eDeviceLocal);
+		// Tracked usage per heap and category, plus the driver's budget and usage with VK_EXT_memory_budget
+		MemorySnapshot getMemorySnapshot() const;
+		ReadbackRing& getReadback() const { return *m_readback; }
+
+		// Scan, compaction and radix sort on storage buffers, created by the first call
+		GpuPrimitives& getPrimitives();
+
+		// The states GraphicsState carries and Pipeline::setState sets: the core Vulkan 1.3 ones, plus polygon mode
+		// where extended dynamic state 3 supports it
+		bool isDynamicStateSupported(vk::DynamicState state) const;
+
+		// shaderFloat16 is enabled, so USE_FP16 shader permutations can be used; storageBuffer16BitAccess is
+		// enabled alongside it where supported
+		bool isShaderFloat16Supported() const { return m_shaderFloat16; }
+
+		// pipelineStatisticsQuery is enabled, so passes can count their fragment shader invocations
+		bool isPipelineStatisticsQuerySupported() const { return m_pipelineStatisticsQuery; }
+
+		// Wave intrinsics are available in the given stage, with every subgroup operation class in `operations`;
+		// each USE_WAVE_OPS shader permutation asks for the ones its intrinsics compile to
+		bool isWaveOpsSupported(vk::ShaderStageFlagBits stage, vk::SubgroupFeatureFlags operations) const;
+
+		// VK_EXT_debug_utils object names and command labels, for captures in external profilers.
+		// Only compiled in with GFX_DEBUG_UTILS (debug builds), and only active when the instance supports the extension.
+		bool isDebugUtilsEnabled() const { return m_debugUtils; }
+
+		template<typename T>
+		void setDebugName(T handle, const std::string& name) const
+		{
+#ifdef GFX_DEBUG_UTILS
+			setDebugName(T::objectType, reinterpret_cast<uint64_t>(static_cast<typename T::CType>(handle)), name);
+#endif
+		}
+
+		Buffer createBuffer(const vk::BufferCreateInfo& bufferInfo, vk::MemoryPropertyFlags memProperties = vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory category = MemoryCategory::Other);
 		void updateBuffer(const Buffer& buffer, const void* contentData, size_t contentSize);
 
-		Image createImage(const vk::ImageCreateInfo& imageInfo, vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal);
+		// The image view covers every array layer, so layered images need an array viewType
+		Image createImage(const vk::ImageCreateInfo& imageInfo, vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory category = MemoryCategory::Other, vk::ImageViewType viewType = vk::ImageViewType::e2D);
 		void updateImage(const Gfx::Image& image, const void* contentData, size_t contentSize);
 
-		Pipeline createGraphicsPipeline(const GraphicsPipelineCreateInfo& createInfo);
-		Pipeline createComputePipeline(const ComputePipelineCreateInfo& createInfo);
+		// Unregistered pipelines are not hot reloaded, optimized in the background or listed by getPipelineStats(),
+		// so creating them costs exactly the creation; for measuring it
+		Pipeline createGraphicsPipeline(const GraphicsPipelineCreateInfo& createInfo, bool registered = true);
+		Pipeline createComputePipeline(const ComputePipelineCreateInfo& createInfo, bool registered = true);
+
+		// Return immediately and build the pipeline on the worker threads; it becomes ready at a later beginFrame().
+		// Until then the pipeline binds the fallback if given (its layout must be compatible), otherwise it is not usable
+		// and RenderGraph skips the passes that list it.
+		Pipeline requestGraphicsPipeline(const GraphicsPipelineCreateInfo& createInfo, const Pipeline* fallback = nullptr);
+		Pipeline requestComputePipeline(const ComputePipelineCreateInfo& createInfo, const Pipeline* fallback = nullptr);
+
+		// Counts a frame that used the fallback or skipped the pipeline, called by RenderGraph once per pass
+		void reportPipelineUse(const Pipeline& pipeline);
+		std::vector<PipelineStats> getPipelineStats();
+
+		// Pipelines built on the workers (requests, hot reloads) waiting for the next beginFrame() to be swapped in
+		bool hasPendingPipelineSwaps();
 
 		std::vector<std::vector<DescriptorSet>> createDescriptorSets(const std::vector<DescriptorSetConfig>& configs);
 
@@ -119,16 +280,61 @@ namespace Gfx
 		}
 
 	private:
-		void initInstance(const std::string& appName, const std::vector<const char*>& extensions);
+		void initInstance(const std::string& appName, const std::vector<const char*>& requiredExtensions);
 		void initSurface(void* window);
 		void pickPhysicalDevice();
 		void initLogicalDevice();
-		void initSwapChain(void* window);
+		void initSwapChain(void* window, bool vsync);
 		void initDepthResources();
 		void initCommandPool();
+		void initReadback();
+		void initPipelineCache();
+		void savePipelineCache() const;
+
+		void setDebugName(vk::ObjectType type, uint64_t handle, const std::string& name) const;
+
+		struct PipelineRecord
+		{
+			std::variant<GraphicsPipelineCreateInfo, ComputePipelineCreateInfo> createInfo;
+			std::weak_ptr<vk::raii::Pipeline> pipeline;
+			std::weak_ptr<vk::raii::PipelineLayout> pipelineLayout;
+			std::vector<std::string> dependencies;
+			std::chrono::steady_clock::time_point requestTime;
+			std::shared_ptr<PipelineStats> stats; // only touched on the render thread, except the immutable name
+			uint64_t generation = 0; // bumped for every requested rebuild, guarded by m_pipelineMutex
+			uint64_t appliedVersion = 0; // version of the pipeline in use, only touched by beginFrame()
+			std::vector<std::shared_ptr<vk::raii::Pipeline>> libraries; // the parts the pipeline in use was linked from, set with it
+		};
+
+		struct PendingPipelineSwap
+		{
+			std::shared_ptr<PipelineRecord> record;
+			uint64_t version; // generation * 2, plus one for the fully optimized build of that generation
+			vk::raii::Pipeline pipeline;
+			PipelineFeedback feedback;
+			std::vector<std::shared_ptr<vk::raii::Pipeline>> libraries;
+		};
+
+		std::tuple<vk::raii::DescriptorSetLayout, std::shared_ptr<vk::raii::PipelineLayout>> createPipelineLayout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings, uint32_t pushConstantSize = 0) const;
+		std::shared_ptr<PipelineRecord> createPipelineRecord(
+			const std::variant<GraphicsPipelineCreateInfo, ComputePipelineCreateInfo>& createInfo,
+			const std::string& name,
+			const std::shared_ptr<vk::raii::Pipeline>& pipeline,
+			const std::shared_ptr<vk::raii::PipelineLayout>& pipelineLayout) const;
+		std::vector<vk::DynamicState> getDynamicStates(const GraphicsPipelineCreateInfo& createInfo) const;
+		// With graphics pipeline libraries, `libraries` receives the parts the pipeline was linked from
+		vk::raii::Pipeline buildGraphicsPipeline(const GraphicsPipelineCreateInfo& createInfo, const vk::raii::PipelineLayout& pipelineLayout, const std::vector<std::vector<uint32_t>>& shaderCodes, bool optimized, PipelineFeedback& feedback, std::vector<std::shared_ptr<vk::raii::Pipeline>>& libraries);
+		std::shared_ptr<vk::raii::Pipeline> getPipelineLibrary(uint64_t key, vk::GraphicsPipelineCreateInfo libraryInfo, vk::GraphicsPipelineLibraryFlagsEXT parts, PipelineFeedback& feedback);
+		void prunePipelineRecords();
+		void queueOptimizedLink(const std::shared_ptr<PipelineRecord>& record, uint64_t generation, std::vector<std::vector<uint32_t>> shaderCodes);
+		vk::raii::Pipeline buildComputePipeline(const ComputePipelineCreateInfo& createInfo, const vk::raii::PipelineLayout& pipelineLayout, const std::vector<uint32_t>& shaderCode, PipelineFeedback& feedback) const;
+		void registerPipeline(const std::shared_ptr<PipelineRecord>& record, bool ready);
+		void onShadersChanged(const std::vector<std::string>& changedFiles);
+		void rebuildPipeline(const std::shared_ptr<PipelineRecord>& record, uint64_t generation);
 
 	private:
 		vk::raii::Context m_context{};
+		MemoryTracker m_memoryTracker{}; // outlives every Buffer/Image the RHI hands out
 		vk::raii::Instance m_instance = nullptr;
 		vk::raii::SurfaceKHR m_surface = nullptr;
 		vk::raii::PhysicalDevice m_physicalDevice = nullptr;
@@ -139,6 +345,7 @@ namespace Gfx
 		vk::raii::Queue m_presentQueue = nullptr;
 		vk::SurfaceFormatKHR m_surfaceFormat{};
 		vk::Extent2D m_swapChainExtent{};
+		vk::ImageUsageFlags m_swapChainUsage{};
 		vk::raii::SwapchainKHR m_swapChain = nullptr;
 		uint8_t m_maxFramesInFlight = 0;
 		std::vector<vk::raii::ImageView> m_swapChainImageViews{};
@@ -146,5 +353,32 @@ namespace Gfx
 		std::vector<Gfx::Image> m_depthImages{};
 		std::vector<vk::Image> m_depthImageObjs{};
 		vk::raii::CommandPool m_commandPool = nullptr;
+		vk::raii::PipelineCache m_pipelineCache = nullptr; // persisted next to the shader cache
+		std::unique_ptr<ShaderCompiler> m_shaderCompiler;
+		std::unique_ptr<ReadbackRing> m_readback;
+		std::unique_ptr<GpuPrimitives> m_primitives;
+
+		vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT m_extendedDynamicState3Features{};
+		bool m_graphicsPipelineLibrary = false;
+		bool m_memoryBudget = false;
+		bool m_shaderFloat16 = false;
+		bool m_pipelineStatisticsQuery = false;
+		vk::PhysicalDeviceSubgroupProperties m_subgroupProperties{};
+		bool m_debugUtils = false;
+		std::mutex m_pipelineLibraryMutex;
+		// keyed by a hash of the state each part depends on; the records of the pipelines linked from them hold them
+		// as well, and prunePipelineRecords() drops the ones nothing else holds
+		std::unordered_map<uint64_t, std::shared_ptr<vk::raii::Pipeline>> m_pipelineLibraries{};
+
+		std::mutex m_pipelineMutex;
+		std::vector<std::shared_ptr<PipelineRecord>> m_pipelineRecords{};
+		std::vector<PendingPipelineSwap> m_pendingPipelineSwaps{};
+		std::vector<std::pair<uint64_t, vk::raii::Pipeline>> m_retiredPipelines{}; // tagged with the frame they were replaced in
+
+		// The workers are joined before anything their jobs touch is destroyed
+		std::unique_ptr<ThreadPool> m_workers;
+
+		// Declared last so it stops before the workers it queues rebuilds on
+		std::unique_ptr<ShaderWatcher> m_shaderWatcher;
 	};
 }
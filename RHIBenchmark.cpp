@@ -0,0 +1,501 @@
+#include "RHIBenchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <random>
+
+#include "Buffer.hpp"
+#include "DescriptorSet.hpp"
+#include "GpuPrimitives.hpp"
+#include "Image.hpp"
+#include "Pipeline.hpp"
+
+using Gfx::RHIBenchmark;
+
+// Every case runs for at least this long, so fast operations are averaged over many calls
+static const double minCaseSeconds = 0.25;
+
+// Seconds per call of `op`, repeated until minCaseSeconds have passed and at least minIterations calls were made
+template<typename F>
+static double measure(F&& op, uint32_t minIterations = 3, uint32_t maxIterations = 100000) {
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    uint32_t iterations = 0;
+
+    while (iterations < minIterations || (elapsed < minCaseSeconds && iterations < maxIterations)) {
+        op();
+        ++iterations;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return elapsed / iterations;
+}
+
+// Timed calls of a GPU case, each between its own pair of timestamps
+static const uint32_t gpuIterations = 5;
+
+static std::string formatBytes(vk::DeviceSize bytes) {
+    const char* units[] = { "B", "KB", "MB", "GB" };
+    size_t unit = 0;
+    while (bytes >= 1024 && bytes % 1024 == 0 && unit + 1 < std::size(units)) {
+        bytes /= 1024;
+        ++unit;
+    }
+    return std::to_string(bytes) + " " + units[unit];
+}
+
+static std::string formatCount(uint32_t count) {
+    const char* units[] = { "", "K", "M", "G" };
+    size_t unit = 0;
+    while (count >= 1024 && count % 1024 == 0 && unit + 1 < std::size(units)) {
+        count /= 1024;
+        ++unit;
+    }
+    return std::to_string(count) + units[unit];
+}
+
+static double toMegabytesPerSecond(vk::DeviceSize bytes, double seconds) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds;
+}
+
+static void printCase(const std::string& name, const std::string& parameter, const nlohmann::json& result) {
+    std::cout << std::left << std::setw(24) << name << std::setw(16) << parameter;
+    if (result.contains("error")) {
+        std::cout << "failed: " << result["error"].get<std::string>();
+    }
+    else {
+        std::cout << std::fixed << std::setprecision(1) << result["opsPerSecond"].get<double>() << " ops/s";
+        if (result.contains("megabytesPerSecond")) {
+            std::cout << ", " << result["megabytesPerSecond"].get<double>() << " MB/s";
+        }
+        if (result.contains("elementsPerSecond")) {
+            std::cout << ", " << result["elementsPerSecond"].get<double>() / 1e6 << " M elements/s";
+        }
+        if (result.contains("correct") && !result["correct"].get<bool>()) {
+            std::cout << ", WRONG RESULT";
+        }
+    }
+    std::cout << std::endl;
+}
+
+// Runs one case and records its error instead of aborting the sweep
+template<typename F>
+static nlohmann::json runCase(const std::string& name, const std::string& parameter, F&& body) {
+    nlohmann::json result{};
+    try {
+        result = body();
+    }
+    catch (const std::exception& e) {
+        result = { { "error", e.what() } };
+    }
+    printCase(name, parameter, result);
+    return result;
+}
+
+// Records a one-time command buffer, submits it and waits for the queue to drain
+template<typename F>
+static void submitAndWait(Gfx::RHI& rhi, F&& record) {
+    vk::CommandBufferAllocateInfo allocInfo{};
+    allocInfo.commandPool = rhi.getCommandPool();
+    allocInfo.level = vk::CommandBufferLevel::ePrimary;
+    allocInfo.commandBufferCount = 1;
+
+    auto cmd = std::move(rhi.getDevice().allocateCommandBuffers(allocInfo).front());
+    cmd.begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+    record(cmd);
+    cmd.end();
+
+    vk::SubmitInfo submitInfo{};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &*cmd;
+
+    rhi.getGraphicsQueue().submit(submitInfo, nullptr);
+    rhi.getGraphicsQueue().waitIdle();
+}
+
+// Seconds of GPU time per call of `op`; `prepare` runs before every call, outside of the timestamps
+template<typename P, typename F>
+static double measureGpu(Gfx::RHI& rhi, P&& prepare, F&& op) {
+    auto limits = rhi.getPhysicalDevice().getProperties().limits;
+    if (!limits.timestampComputeAndGraphics) {
+        throw std::runtime_error("the queue can't write timestamps!");
+    }
+
+    vk::QueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.queryType = vk::QueryType::eTimestamp;
+    queryPoolInfo.queryCount = 2 * gpuIterations;
+    vk::raii::QueryPool queryPool(rhi.getDevice(), queryPoolInfo);
+
+    submitAndWait(rhi, [&](const vk::raii::CommandBuffer& cmd) {
+        cmd.resetQueryPool(*queryPool, 0, queryPoolInfo.queryCount);
+        for (uint32_t i = 0; i < gpuIterations; ++i) {
+            prepare(cmd);
+            cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *queryPool, 2 * i);
+            op(cmd);
+            cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *queryPool, 2 * i + 1);
+        }
+    });
+
+    auto [result, timestamps] = queryPool.getResults<uint64_t>(
+        0, queryPoolInfo.queryCount, queryPoolInfo.queryCount * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("failed to read the timestamps!");
+    }
+
+    uint64_t ticks = 0;
+    for (uint32_t i = 0; i < gpuIterations; ++i) {
+        ticks += timestamps[2 * i + 1] - timestamps[2 * i];
+    }
+    return static_cast<double>(ticks) * limits.timestampPeriod * 1e-9 / gpuIterations;
+}
+
+static Gfx::Buffer createStorageBuffer(Gfx::RHI& rhi, const std::vector<uint32_t>& data) {
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.size = data.size() * sizeof(uint32_t);
+    bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+
+    auto buffer = rhi.createBuffer(bufferInfo);
+    rhi.updateBuffer(buffer, data);
+    return buffer;
+}
+
+static std::vector<uint32_t> readBuffer(Gfx::RHI& rhi, const Gfx::Buffer& buffer, uint32_t count) {
+    if (count == 0) {
+        return {};
+    }
+
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.size = count * sizeof(uint32_t);
+    bufferInfo.usage = vk::BufferUsageFlagBits::eTransferDst;
+
+    auto readback = rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, Gfx::MemoryCategory::Staging);
+
+    submitAndWait(rhi, [&](const vk::raii::CommandBuffer& cmd) {
+        cmd.copyBuffer(buffer, readback, vk::BufferCopy{ 0, 0, bufferInfo.size });
+
+        vk::MemoryBarrier2 hostBarrier{};
+        hostBarrier.srcStageMask = vk::PipelineStageFlagBits2::eCopy;
+        hostBarrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+        hostBarrier.dstStageMask = vk::PipelineStageFlagBits2::eHost;
+        hostBarrier.dstAccessMask = vk::AccessFlagBits2::eHostRead;
+
+        vk::DependencyInfo dependencyInfo{};
+        dependencyInfo.memoryBarrierCount = 1;
+        dependencyInfo.pMemoryBarriers = &hostBarrier;
+        cmd.pipelineBarrier2(dependencyInfo);
+    });
+
+    readback.map();
+    auto data = static_cast<const uint32_t*>(readback.getMappedData());
+    std::vector<uint32_t> result(data, data + count);
+    readback.unmap();
+    return result;
+}
+
+static nlohmann::json makePrimitiveResult(uint32_t count, double seconds, bool correct) {
+    return {
+        { "opsPerSecond", 1.0 / seconds },
+        { "elementsPerSecond", count / seconds },
+        { "milliseconds", seconds * 1e3 },
+        { "correct", correct },
+    };
+}
+
+RHIBenchmark::RHIBenchmark(RHI& rhi) :
+    m_rhi(rhi)
+{
+}
+
+nlohmann::json RHIBenchmark::run(const GraphicsPipelineCreateInfo& graphicsPipeline, const ComputePipelineCreateInfo& computePipeline)
+{
+    nlohmann::json report{};
+    report["buffers"] = runBufferSweep();
+    report["textures"] = runTextureSweep();
+    report["descriptorSets"] = runDescriptorSetSweep();
+    report["primitives"] = runPrimitivesSweep();
+    report["pipelines"] = runPipelineBenchmarks(graphicsPipeline, computePipeline);
+
+    m_rhi.getDevice().waitIdle();
+    return report;
+}
+
+nlohmann::json RHIBenchmark::runBufferSweep()
+{
+    auto results = nlohmann::json::array();
+
+    for (vk::DeviceSize size = 64; size <= 256ull * 1024 * 1024; size *= 4) {
+        vk::BufferCreateInfo bufferInfo{};
+        bufferInfo.size = size;
+        bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+
+        // created and destroyed again, a real frame pays for both
+        auto create = runCase("createBuffer", formatBytes(size), [&]() -> nlohmann::json {
+            auto seconds = measure([&]() { m_rhi.createBuffer(bufferInfo); });
+            return { { "opsPerSecond", 1.0 / seconds } };
+        });
+
+        auto update = runCase("updateBuffer", formatBytes(size), [&]() -> nlohmann::json {
+            auto buffer = m_rhi.createBuffer(bufferInfo);
+            std::vector<uint8_t> data(size, 0xAB);
+
+            auto seconds = measure([&]() { m_rhi.updateBuffer(buffer, data.data(), data.size()); });
+            return { { "opsPerSecond", 1.0 / seconds }, { "megabytesPerSecond", toMegabytesPerSecond(size, seconds) } };
+        });
+
+        results.push_back({ { "size", size }, { "create", std::move(create) }, { "update", std::move(update) } });
+    }
+
+    return results;
+}
+
+nlohmann::json RHIBenchmark::runTextureSweep()
+{
+    const uint32_t textureSize = 64;
+    const vk::DeviceSize textureBytes = textureSize * textureSize * 4;
+
+    vk::ImageCreateInfo imageInfo{};
+    imageInfo.imageType = vk::ImageType::e2D;
+    imageInfo.format = vk::Format::eR8G8B8A8Srgb;
+    imageInfo.extent = vk::Extent3D{ textureSize, textureSize, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+
+    std::vector<uint8_t> data(textureBytes, 0xAB);
+
+    auto maxAllocations = m_rhi.getPhysicalDevice().getProperties().limits.maxMemoryAllocationCount;
+    auto results = nlohmann::json::array();
+
+    for (uint32_t count : { 1u, 10u, 100u, 1000u, 10000u }) {
+        auto parameter = std::to_string(count) + " x " + std::to_string(textureSize) + "^2";
+
+        // every image is its own allocation, plus one for the staging buffer of an update
+        if (m_rhi.getMemoryTracker().getTotalUsage().allocationCount + count + 1 > maxAllocations) {
+            auto skipped = nlohmann::json{ { "error", "exceeds maxMemoryAllocationCount (" + std::to_string(maxAllocations) + ")" } };
+            printCase("createImage", parameter, skipped);
+            results.push_back({ { "count", count }, { "create", skipped }, { "update", skipped } });
+            continue;
+        }
+
+        auto create = runCase("createImage", parameter, [&]() -> nlohmann::json {
+            auto seconds = measure([&]() {
+                std::vector<Image> images{};
+                images.reserve(count);
+                for (uint32_t i = 0; i < count; ++i) {
+                    images.emplace_back(m_rhi.createImage(imageInfo));
+                }
+            }, 1);
+            return { { "opsPerSecond", count / seconds } };
+        });
+
+        auto update = runCase("updateImage", parameter, [&]() -> nlohmann::json {
+            std::vector<Image> images{};
+            images.reserve(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                images.emplace_back(m_rhi.createImage(imageInfo));
+            }
+
+            auto seconds = measure([&]() {
+                for (const auto& image : images) {
+                    m_rhi.updateImage(image, data);
+                }
+            }, 1);
+            return { { "opsPerSecond", count / seconds }, { "megabytesPerSecond", toMegabytesPerSecond(count * textureBytes, seconds) } };
+        });
+
+        results.push_back({ { "count", count }, { "textureSize", textureSize }, { "create", std::move(create) }, { "update", std::move(update) } });
+    }
+
+    return results;
+}
+
+nlohmann::json RHIBenchmark::runDescriptorSetSweep()
+{
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.size = 256;
+    bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+
+    auto buffer = m_rhi.createBuffer(bufferInfo);
+
+    vk::DescriptorBufferInfo descriptorInfo{};
+    descriptorInfo.buffer = buffer;
+    descriptorInfo.range = bufferInfo.size;
+
+    auto results = nlohmann::json::array();
+
+    for (uint32_t bindingCount : { 1u, 10u, 100u, 1000u }) {
+        auto result = runCase("createDescriptorSets", std::to_string(bindingCount) + " bindings", [&]() -> nlohmann::json {
+            std::vector<vk::DescriptorSetLayoutBinding> layoutBindings(bindingCount);
+            for (uint32_t i = 0; i < bindingCount; ++i) {
+                layoutBindings[i] = { i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr };
+            }
+
+            vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+            layoutInfo.bindingCount = bindingCount;
+            layoutInfo.pBindings = layoutBindings.data();
+
+            vk::raii::DescriptorSetLayout layout(m_rhi.getDevice(), layoutInfo);
+
+            DescriptorSetConfig config{};
+            config.layout = *layout;
+            config.bindings.assign(bindingCount, { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ descriptorInfo } });
+
+            std::vector<DescriptorSetConfig> configs{ config };
+
+            // one call allocates a pool and a set for every frame in flight, and writes all of them
+            auto seconds = measure([&]() { m_rhi.createDescriptorSets(configs); });
+            return {
+                { "opsPerSecond", 1.0 / seconds },
+                { "setsPerSecond", m_rhi.getMaxFramesInFlight() / seconds },
+                { "descriptorsPerSecond", static_cast<double>(bindingCount) * m_rhi.getMaxFramesInFlight() / seconds },
+            };
+        });
+
+        result["bindings"] = bindingCount;
+        results.push_back(std::move(result));
+    }
+
+    return results;
+}
+
+nlohmann::json RHIBenchmark::runPrimitivesSweep()
+{
+    auto& primitives = m_rhi.getPrimitives();
+    auto noPrepare = [](const vk::raii::CommandBuffer&) {};
+
+    // every case destroys its buffers, so their descriptor sets would only pile up in the cache
+    auto releaseBindings = [&]() {
+        m_rhi.getDevice().waitIdle();
+        primitives.releaseBindings();
+    };
+
+    std::mt19937 random(42);
+    auto results = nlohmann::json::array();
+
+    for (uint32_t count = 1024; count <= primitives.getMaxElements(); count *= 4) {
+        auto parameter = formatCount(count) + " elements";
+
+        std::vector<uint32_t> values(count);
+        std::vector<uint32_t> flags(count);
+        std::vector<uint32_t> keys(count);
+        std::vector<uint32_t> indices(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            values[i] = random() & 0xFF;
+            flags[i] = random() & 1;
+            keys[i] = random();
+            indices[i] = i;
+        }
+
+        auto scan = runCase("exclusiveScan", parameter, [&]() -> nlohmann::json {
+            auto input = createStorageBuffer(m_rhi, values);
+            auto output = createStorageBuffer(m_rhi, std::vector<uint32_t>(count));
+
+            auto seconds = measureGpu(m_rhi, noPrepare, [&](const vk::raii::CommandBuffer& cmd) {
+                primitives.exclusiveScan(cmd, input, output, count);
+            });
+
+            std::vector<uint32_t> expected(count);
+            std::exclusive_scan(values.begin(), values.end(), expected.begin(), 0u);
+            return makePrimitiveResult(count, seconds, readBuffer(m_rhi, output, count) == expected);
+        });
+        releaseBindings();
+
+        auto compact = runCase("compact", parameter, [&]() -> nlohmann::json {
+            auto input = createStorageBuffer(m_rhi, values);
+            auto flagBuffer = createStorageBuffer(m_rhi, flags);
+            auto output = createStorageBuffer(m_rhi, std::vector<uint32_t>(count));
+            auto outputCount = createStorageBuffer(m_rhi, std::vector<uint32_t>(1));
+
+            auto seconds = measureGpu(m_rhi, noPrepare, [&](const vk::raii::CommandBuffer& cmd) {
+                primitives.compact(cmd, input, flagBuffer, output, outputCount, count);
+            });
+
+            std::vector<uint32_t> expected{};
+            for (uint32_t i = 0; i < count; ++i) {
+                if (flags[i] != 0) {
+                    expected.push_back(values[i]);
+                }
+            }
+
+            auto keptCount = readBuffer(m_rhi, outputCount, 1).front();
+            bool correct = keptCount == expected.size() && readBuffer(m_rhi, output, keptCount) == expected;
+            return makePrimitiveResult(count, seconds, correct);
+        });
+        releaseBindings();
+
+        auto sort = runCase("sortKeyValue", parameter, [&]() -> nlohmann::json {
+            auto unsortedKeys = createStorageBuffer(m_rhi, keys);
+            auto unsortedValues = createStorageBuffer(m_rhi, indices);
+            auto keyBuffer = createStorageBuffer(m_rhi, keys);
+            auto valueBuffer = createStorageBuffer(m_rhi, indices);
+
+            // every call sorts the shuffled keys, already sorted ones would scatter far more coherently
+            auto restore = [&](const vk::raii::CommandBuffer& cmd) {
+                vk::BufferCopy region{ 0, 0, count * sizeof(uint32_t) };
+                cmd.copyBuffer(unsortedKeys, keyBuffer, region);
+                cmd.copyBuffer(unsortedValues, valueBuffer, region);
+
+                vk::MemoryBarrier2 copyBarrier{};
+                copyBarrier.srcStageMask = vk::PipelineStageFlagBits2::eCopy;
+                copyBarrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+                copyBarrier.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+                copyBarrier.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+
+                vk::DependencyInfo dependencyInfo{};
+                dependencyInfo.memoryBarrierCount = 1;
+                dependencyInfo.pMemoryBarriers = &copyBarrier;
+                cmd.pipelineBarrier2(dependencyInfo);
+            };
+
+            auto seconds = measureGpu(m_rhi, restore, [&](const vk::raii::CommandBuffer& cmd) {
+                primitives.sortKeyValue(cmd, keyBuffer, valueBuffer, count);
+            });
+
+            // the values are the original indices, so a stable sort has exactly one answer
+            std::vector<uint32_t> expectedValues(indices);
+            std::stable_sort(expectedValues.begin(), expectedValues.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+            std::vector<uint32_t> expectedKeys(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                expectedKeys[i] = keys[expectedValues[i]];
+            }
+
+            bool correct = readBuffer(m_rhi, keyBuffer, count) == expectedKeys && readBuffer(m_rhi, valueBuffer, count) == expectedValues;
+            return makePrimitiveResult(count, seconds, correct);
+        });
+        releaseBindings();
+
+        results.push_back({
+            { "count", count },
+            { "exclusiveScan", std::move(scan) },
+            { "compact", std::move(compact) },
+            { "sortKeyValue", std::move(sort) },
+        });
+    }
+
+    return { { "waveOps", primitives.isUsingWaveOps() }, { "sizes", std::move(results) } };
+}
+
+nlohmann::json RHIBenchmark::runPipelineBenchmarks(const GraphicsPipelineCreateInfo& graphicsPipeline, const ComputePipelineCreateInfo& computePipeline)
+{
+    // SPIR-V comes from the shader cache and pipeline libraries are reused after the first call,
+    // so this measures the steady-state cost of creating a pipeline that was seen before. The pipelines
+    // aren't registered, which would leave a record per call and queue background links competing with the timing.
+    auto graphics = runCase("createGraphicsPipeline", graphicsPipeline.name, [&]() -> nlohmann::json {
+        auto seconds = measure([&]() { m_rhi.createGraphicsPipeline(graphicsPipeline, false); }, 3, 200);
+        return { { "opsPerSecond", 1.0 / seconds } };
+    });
+    graphics["name"] = graphicsPipeline.name;
+
+    auto compute = runCase("createComputePipeline", computePipeline.name, [&]() -> nlohmann::json {
+        auto seconds = measure([&]() { m_rhi.createComputePipeline(computePipeline, false); }, 3, 200);
+        return { { "opsPerSecond", 1.0 / seconds } };
+    });
+    compute["name"] = computePipeline.name;
+
+    return { { "graphics", std::move(graphics) }, { "compute", std::move(compute) } };
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+
+#include "RHI.hpp"
+
+namespace Gfx
+{
+	// Microbenchmarks for the RHI resource creation and upload paths, run against the real device.
+	//
+	// - Sweeps buffer sizes (64 B to 256 MB), texture counts (1 to 10k) and descriptor set sizes (1 to 1000 bindings)
+	// - Times the GPU primitives (scan, compaction, radix sort) from 1K to 16M elements with GPU timestamps,
+	//   reporting elements/s, and checks every result against a CPU reference
+	// - Every case repeats until it has run for a minimum time, then reports ops/s and, for uploads, MB/s
+	// - A case that fails (out of memory, allocation count limit, ...) is reported with its error and the sweep goes on
+	class RHIBenchmark
+	{
+	public:
+		RHIBenchmark(RHI& rhi);
+		RHIBenchmark(const RHIBenchmark&) = delete;
+
+		// Runs every sweep, printing one line per case, and returns the results.
+		// The pipelines are created over and over, so they should be cheap and already in the shader cache.
+		nlohmann::json run(const GraphicsPipelineCreateInfo& graphicsPipeline, const ComputePipelineCreateInfo& computePipeline);
+
+	private:
+		nlohmann::json runBufferSweep();
+		nlohmann::json runTextureSweep();
+		nlohmann::json runDescriptorSetSweep();
+		nlohmann::json runPrimitivesSweep();
+		nlohmann::json runPipelineBenchmarks(const GraphicsPipelineCreateInfo& graphicsPipeline, const ComputePipelineCreateInfo& computePipeline);
+
+	private:
+		RHI& m_rhi;
+	};
+}
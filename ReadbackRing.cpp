@@ -0,0 +1,180 @@
+#include "ReadbackRing.hpp"
+
+#include <algorithm>
+#include <memory>
+
+using Gfx::ReadbackRing;
+
+static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Host-cached memory makes reading the data back much faster, it is non-coherent on most devices though
+static vk::MemoryPropertyFlags getReadbackMemoryProperties(const vk::raii::PhysicalDevice& physicalDevice) {
+    auto memProperties = physicalDevice.getMemoryProperties();
+    vk::MemoryPropertyFlags cached = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((memProperties.memoryTypes[i].propertyFlags & cached) == cached) {
+            return cached;
+        }
+    }
+
+    return vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+}
+
+ReadbackRing::ReadbackRing(RHI& rhi, vk::DeviceSize size) :
+    m_rhi(rhi),
+    m_buffer(nullptr)
+{
+    auto limits = m_rhi.getPhysicalDevice().getProperties().limits;
+    m_alignment = std::max<vk::DeviceSize>({ 16, limits.nonCoherentAtomSize, limits.optimalBufferCopyOffsetAlignment });
+    m_size = alignUp(size, m_alignment);
+}
+
+void ReadbackRing::createBuffer()
+{
+    vk::BufferCreateInfo bufferInfo{};
+    bufferInfo.size = m_size;
+    bufferInfo.usage = vk::BufferUsageFlagBits::eTransferDst;
+
+    m_buffer = m_rhi.createBuffer(bufferInfo, getReadbackMemoryProperties(m_rhi.getPhysicalDevice()), MemoryCategory::Staging);
+    m_buffer.map();
+}
+
+void ReadbackRing::readBuffer(const vk::raii::CommandBuffer& cmd, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size, Callback callback)
+{
+    auto ringOffset = allocate(size);
+
+    vk::BufferCopy region{};
+    region.srcOffset = offset;
+    region.dstOffset = ringOffset;
+    region.size = size;
+    cmd.copyBuffer(buffer, *m_buffer, region);
+    recordHostBarrier(cmd);
+
+    m_requests.push_back({ m_frame, ringOffset, size, alignUp(size, m_alignment), std::move(callback) });
+}
+
+void ReadbackRing::readImage(const vk::raii::CommandBuffer& cmd, const ReadbackImageRegion& region, Callback callback)
+{
+    auto size = static_cast<vk::DeviceSize>(region.extent.width) * region.extent.height * region.extent.depth * region.bytesPerTexel;
+    auto ringOffset = allocate(size);
+
+    vk::BufferImageCopy copy{};
+    copy.bufferOffset = ringOffset;
+    copy.imageSubresource = { region.aspect, region.mipLevel, region.arrayLayer, 1 };
+    copy.imageOffset = region.offset;
+    copy.imageExtent = region.extent;
+    cmd.copyImageToBuffer(region.image, region.layout, *m_buffer, copy);
+    recordHostBarrier(cmd);
+
+    m_requests.push_back({ m_frame, ringOffset, size, alignUp(size, m_alignment), std::move(callback) });
+}
+
+// std::function needs a copyable callable, so the promise is shared
+static std::pair<ReadbackRing::Callback, std::future<std::vector<uint8_t>>> makeFutureCallback() {
+    auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+    auto future = promise->get_future();
+
+    ReadbackRing::Callback callback = [promise](const void* data, vk::DeviceSize size) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        promise->set_value(std::vector<uint8_t>(bytes, bytes + size));
+    };
+
+    return { std::move(callback), std::move(future) };
+}
+
+std::future<std::vector<uint8_t>> ReadbackRing::readBuffer(const vk::raii::CommandBuffer& cmd, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size)
+{
+    auto [callback, future] = makeFutureCallback();
+    readBuffer(cmd, buffer, offset, size, std::move(callback));
+    return std::move(future);
+}
+
+std::future<std::vector<uint8_t>> ReadbackRing::readImage(const vk::raii::CommandBuffer& cmd, const ReadbackImageRegion& region)
+{
+    auto [callback, future] = makeFutureCallback();
+    readImage(cmd, region, std::move(callback));
+    return std::move(future);
+}
+
+void ReadbackRing::beginFrame(uint64_t frame)
+{
+    m_frame = frame;
+
+    // the fence of this frame slot has been waited on, so every frame a full ring of frames ago has finished
+    while (!m_requests.empty() && frame >= m_requests.front().frame + m_rhi.getMaxFramesInFlight()) {
+        complete(m_requests.front());
+        m_requests.pop_front();
+    }
+}
+
+void ReadbackRing::flush()
+{
+    m_rhi.getDevice().waitIdle();
+
+    while (!m_requests.empty()) {
+        complete(m_requests.front());
+        m_requests.pop_front();
+    }
+}
+
+vk::DeviceSize ReadbackRing::allocate(vk::DeviceSize size)
+{
+    auto allocatedSize = alignUp(size, m_alignment);
+    if (size == 0 || allocatedSize > m_size) {
+        throw std::runtime_error("readback of " + std::to_string(size) + " bytes doesn't fit into the readback ring!");
+    }
+    if (!*m_buffer) {
+        createBuffer();
+    }
+
+    if (m_requests.empty()) {
+        m_head = 0;
+    }
+
+    // the free space runs from the head to the oldest request, wrapping around the end of the ring.
+    // The head never catches up with the tail, so head == tail always means the ring is empty.
+    vk::DeviceSize tail = m_requests.empty() ? m_size : m_requests.front().offset;
+    vk::DeviceSize offset = m_head;
+
+    if (m_head >= tail || m_requests.empty()) {
+        if (m_head + allocatedSize > m_size) {
+            offset = 0; // the rest of the ring is skipped until the requests before it complete
+            if (!m_requests.empty() && allocatedSize >= tail) {
+                throw std::runtime_error("readback ring is full!");
+            }
+        }
+    }
+    else if (m_head + allocatedSize >= tail) {
+        throw std::runtime_error("readback ring is full!");
+    }
+
+    m_head = offset + allocatedSize;
+    return offset;
+}
+
+void ReadbackRing::complete(Request& request)
+{
+    m_rhi.getDevice().invalidateMappedMemoryRanges(vk::MappedMemoryRange{ m_buffer.getMemory(), request.offset, request.allocatedSize });
+
+    if (request.callback) {
+        request.callback(static_cast<const uint8_t*>(m_buffer.getMappedData()) + request.offset, request.size);
+    }
+}
+
+void ReadbackRing::recordHostBarrier(const vk::raii::CommandBuffer& cmd) const
+{
+    // makes the copy visible to the host once the frame's fence signals
+    vk::MemoryBarrier2 hostBarrier{};
+    hostBarrier.srcStageMask  = vk::PipelineStageFlagBits2::eCopy;
+    hostBarrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+    hostBarrier.dstStageMask  = vk::PipelineStageFlagBits2::eHost;
+    hostBarrier.dstAccessMask = vk::AccessFlagBits2::eHostRead;
+
+    vk::DependencyInfo dependencyInfo{};
+    dependencyInfo.memoryBarrierCount = 1;
+    dependencyInfo.pMemoryBarriers    = &hostBarrier;
+    cmd.pipelineBarrier2(dependencyInfo);
+}
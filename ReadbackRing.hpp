@@ -0,0 +1,85 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <vector>
+
+#include "Buffer.hpp"
+#include "RHI.hpp"
+
+namespace Gfx
+{
+	struct ReadbackImageRegion
+	{
+		vk::Image image;
+		vk::ImageLayout layout = vk::ImageLayout::eTransferSrcOptimal; // the image must already be in it, eTransferSrcOptimal or eGeneral
+		vk::ImageAspectFlagBits aspect = vk::ImageAspectFlagBits::eColor;
+		uint32_t mipLevel = 0;
+		uint32_t arrayLayer = 0;
+		vk::Offset3D offset{};
+		vk::Extent3D extent{};
+		uint32_t bytesPerTexel = 4; // of the format (or aspect) being copied, the data arrives tightly packed
+	};
+
+	// Reads buffers and images back to the host without stalling the render loop.
+	//
+	// - One persistently mapped, host-cached buffer is used as a ring; every request takes a slice of it.
+	//   It is only allocated by the first request, so runs that never read anything back don't pay for it.
+	// - A request records its copy into the command buffer of the frame being recorded, and completes in
+	//   RHI::beginFrame() once that frame's fence has signaled, getMaxFramesInFlight() frames later
+	// - Completed requests hand their data to a callback (pointing into the ring, only valid during the call)
+	//   or to a future that receives a copy
+	// - Render thread only; the command buffer must be the one RenderGraph submits for the current frame
+	class ReadbackRing
+	{
+	public:
+		using Callback = std::function<void(const void* data, vk::DeviceSize size)>;
+
+		ReadbackRing(RHI& rhi, vk::DeviceSize size);
+		ReadbackRing(const ReadbackRing&) = delete;
+
+		// Copy `size` bytes at `offset` of `buffer`. The caller makes earlier writes to it visible to transfer reads.
+		void readBuffer(const vk::raii::CommandBuffer& cmd, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size, Callback callback);
+		std::future<std::vector<uint8_t>> readBuffer(const vk::raii::CommandBuffer& cmd, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size);
+
+		// Copy a region of one mip level and array layer, rows tightly packed, top row first
+		void readImage(const vk::raii::CommandBuffer& cmd, const ReadbackImageRegion& region, Callback callback);
+		std::future<std::vector<uint8_t>> readImage(const vk::raii::CommandBuffer& cmd, const ReadbackImageRegion& region);
+
+		// Completes the requests of every frame the GPU has finished, called by RHI::beginFrame()
+		void beginFrame(uint64_t frame);
+
+		// Waits for the device to go idle and completes every outstanding request
+		void flush();
+
+		vk::DeviceSize getSize() const { return m_size; } // capacity, whether allocated yet or not
+		bool hasPendingRequests() const { return !m_requests.empty(); } // completing them takes more frames
+
+	private:
+		struct Request
+		{
+			uint64_t frame;
+			vk::DeviceSize offset;
+			vk::DeviceSize size; // bytes of data
+			vk::DeviceSize allocatedSize; // aligned slice of the ring
+			Callback callback;
+		};
+
+		void createBuffer();
+		vk::DeviceSize allocate(vk::DeviceSize size);
+		void complete(Request& request);
+		void recordHostBarrier(const vk::raii::CommandBuffer& cmd) const;
+
+	private:
+		RHI& m_rhi;
+		Buffer m_buffer; // null until the first request
+		vk::DeviceSize m_size;
+		vk::DeviceSize m_alignment; // of every slice, for image copies and non-coherent invalidation
+
+		// requests in ring order, the oldest one marks the end of the free space
+		std::deque<Request> m_requests{};
+		vk::DeviceSize m_head = 0;
+		uint64_t m_frame = 0;
+	};
+}
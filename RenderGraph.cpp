@@ -1,8 +1,10 @@
 #include "RenderGraph.hpp"
 
+#include <algorithm>
+
 using Gfx::RenderGraph;
 
-RenderGraph::RenderGraph(const RHI& rhi): 
+RenderGraph::RenderGraph(RHI& rhi): 
     m_rhi(rhi)
 {
 }
@@ -36,6 +38,32 @@ void RenderGraph::init()
         // start signaled so the first wait doesn't block forever if user forgets
         m_inFlightFences.emplace_back(m_rhi.getDevice(), vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
     }
+
+    // timestamps bracket every pass, so the passes must all be added before init()
+    auto limits = m_rhi.getPhysicalDevice().getProperties().limits;
+    if (limits.timestampComputeAndGraphics && !m_passes.empty())
+    {
+        vk::QueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.queryType = vk::QueryType::eTimestamp;
+        queryPoolInfo.queryCount = static_cast<uint32_t>(2 * m_passes.size()) * allocInfo.commandBufferCount;
+
+        m_timestampPool = vk::raii::QueryPool(m_rhi.getDevice(), queryPoolInfo);
+        m_timestampPeriod = limits.timestampPeriod;
+    }
+
+    bool countsFragments = std::any_of(m_passes.begin(), m_passes.end(), [](const RenderPassNode& pass) { return pass.countFragments; });
+    if (m_rhi.isPipelineStatisticsQuerySupported() && countsFragments)
+    {
+        vk::QueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.queryType = vk::QueryType::ePipelineStatistics;
+        queryPoolInfo.queryCount = static_cast<uint32_t>(m_passes.size()) * allocInfo.commandBufferCount;
+        queryPoolInfo.pipelineStatistics = vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+
+        m_statisticsPool = vk::raii::QueryPool(m_rhi.getDevice(), queryPoolInfo);
+    }
+
+    m_frameTimings.assign(allocInfo.commandBufferCount, FrameTiming{});
+    m_frameTimingPending.assign(allocInfo.commandBufferCount, false);
 }
 
 void RenderGraph::executeFrame()
@@ -50,6 +78,22 @@ void RenderGraph::executeFrame()
     // Wait for fence for this frame to be signaled (previous GPU work finished)
     m_rhi.getDevice().waitForFences(*inFlightFence, true, UINT64_MAX);
 
+    // The frame that last used this slot has finished, so its timestamps are available
+    collectFrameTiming(frameIndex);
+
+    auto frameStart = std::chrono::steady_clock::now();
+
+    auto& frameTiming = m_frameTimings[frameIndex];
+    frameTiming.frame = m_currentFrame;
+    frameTiming.gpuMilliseconds = 0.0;
+    frameTiming.passes.resize(m_passes.size());
+
+    const uint32_t firstQuery = static_cast<uint32_t>(2 * m_passes.size()) * frameIndex;
+    const uint32_t firstStatisticsQuery = static_cast<uint32_t>(m_passes.size()) * frameIndex;
+
+    // Safe point to swap hot-reloaded pipelines and release retired ones
+    m_rhi.beginFrame(m_currentFrame);
+
     // Acquire next image
     auto acquireResult = m_rhi.getSwapChain().acquireNextImage(UINT64_MAX, *presentComplete, nullptr);
     auto imageIndex = acquireResult.second;
@@ -57,10 +101,39 @@ void RenderGraph::executeFrame()
     // reset command buffer for this image
     cmd.begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
 
+    if (*m_timestampPool)
+    {
+        cmd.resetQueryPool(*m_timestampPool, firstQuery, static_cast<uint32_t>(2 * m_passes.size()));
+    }
+
+    if (*m_statisticsPool)
+    {
+        cmd.resetQueryPool(*m_statisticsPool, firstStatisticsQuery, static_cast<uint32_t>(m_passes.size()));
+    }
+
     // For each pass, optionally insert an image layout transition, then call the user record callback.
     // We assume all passes render to the swapchain color image directly in this simple sample.
-    for (auto& pass : m_passes)
+    for (size_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
     {
+        auto& pass = m_passes[passIndex];
+        auto passStart = std::chrono::steady_clock::now();
+
+        // eAllCommands waits for the previous pass, so pass times add up to the frame time instead of overlapping
+        if (*m_timestampPool)
+        {
+            cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *m_timestampPool, firstQuery + static_cast<uint32_t>(2 * passIndex));
+        }
+
+#ifdef GFX_DEBUG_UTILS
+        // the label covers the pass barriers too, so profilers attribute them to the pass that needs them
+        if (m_rhi.isDebugUtilsEnabled())
+        {
+            vk::DebugUtilsLabelEXT label{};
+            label.pLabelName = pass.name.c_str();
+            cmd.beginDebugUtilsLabelEXT(label);
+        }
+#endif
+
         std::vector<vk::ImageMemoryBarrier2> imageBarriers{};
         std::vector<vk::BufferMemoryBarrier2> bufferBarriers{};
 
@@ -78,7 +151,7 @@ void RenderGraph::executeFrame()
                 barrier.image = transitionInfo.images[frameIndex];
                 barrier.subresourceRange.aspectMask = transitionInfo.aspectMask;
                 barrier.subresourceRange.levelCount = 1;
-                barrier.subresourceRange.layerCount = 1;
+                barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS; // every layer of layered attachments
                 imageBarriers.emplace_back(std::move(barrier));
             }
         }
@@ -105,11 +178,49 @@ void RenderGraph::executeFrame()
             cmd.pipelineBarrier2(dependencyInfo);
         }
 
+        // Skip the pass while one of its pipelines is still building and has no fallback
+        bool pipelinesUsable = true;
+        for (auto pipeline : pass.pipelines)
+        {
+            m_rhi.reportPipelineUse(*pipeline);
+            pipelinesUsable = pipelinesUsable && pipeline->isUsable();
+        }
+
+        // The fragment count query also brackets a skipped pass, so the readback finds it available (with a count of 0)
+        const bool countFragments = pass.countFragments && *m_statisticsPool;
+        if (countFragments)
+        {
+            cmd.beginQuery(*m_statisticsPool, firstStatisticsQuery + static_cast<uint32_t>(passIndex), {});
+        }
+
         // Call the pass record function to record draw/compute commands.
-        if (pass.recordFunc)
+        if (pass.recordFunc && pipelinesUsable)
         {
             pass.recordFunc(cmd, imageIndex);
         }
+
+        if (countFragments)
+        {
+            cmd.endQuery(*m_statisticsPool, firstStatisticsQuery + static_cast<uint32_t>(passIndex));
+        }
+
+#ifdef GFX_DEBUG_UTILS
+        if (m_rhi.isDebugUtilsEnabled())
+        {
+            cmd.endDebugUtilsLabelEXT();
+        }
+#endif
+
+        if (*m_timestampPool)
+        {
+            cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *m_timestampPool, firstQuery + static_cast<uint32_t>(2 * passIndex + 1));
+        }
+
+        auto& passTiming = frameTiming.passes[passIndex];
+        passTiming.name = pass.name;
+        passTiming.cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - passStart).count();
+        passTiming.gpuMilliseconds = 0.0;
+        passTiming.fragmentShaderInvocations = 0;
     }
 
     cmd.end();
@@ -141,6 +252,94 @@ void RenderGraph::executeFrame()
 
     m_rhi.getPresentQueue().presentKHR(presentInfo);
 
+    frameTiming.cpuMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    m_frameTimingPending[frameIndex] = true;
+
     // Advance frame index
     ++m_currentFrame;
 }
+
+bool RenderGraph::hasActiveAnimatedPasses() const
+{
+    for (const auto& pass : m_passes)
+    {
+        if (!pass.animated || !pass.recordFunc)
+        {
+            continue;
+        }
+
+        bool pipelinesUsable = true;
+        for (auto pipeline : pass.pipelines)
+        {
+            pipelinesUsable = pipelinesUsable && pipeline->isUsable();
+        }
+
+        if (pipelinesUsable)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void RenderGraph::stopCountingFragments(const std::string& passName)
+{
+    for (auto& pass : m_passes)
+    {
+        if (pass.name == passName)
+        {
+            pass.countFragments = false;
+        }
+    }
+}
+
+void RenderGraph::collectFrameTiming(uint32_t frameIndex)
+{
+    if (!m_frameTimingPending[frameIndex])
+    {
+        return;
+    }
+    m_frameTimingPending[frameIndex] = false;
+
+    auto& frameTiming = m_frameTimings[frameIndex];
+
+    if (*m_timestampPool)
+    {
+        const uint32_t queryCount = static_cast<uint32_t>(2 * m_passes.size());
+        auto [result, timestamps] = m_timestampPool.getResults<uint64_t>(
+            queryCount * frameIndex, queryCount, queryCount * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+        if (result == vk::Result::eSuccess)
+        {
+            auto toMilliseconds = [this](uint64_t begin, uint64_t end) { return static_cast<double>(end - begin) * m_timestampPeriod * 1e-6; };
+
+            for (size_t i = 0; i < frameTiming.passes.size(); ++i)
+            {
+                frameTiming.passes[i].gpuMilliseconds = toMilliseconds(timestamps[2 * i], timestamps[2 * i + 1]);
+            }
+            frameTiming.gpuMilliseconds = toMilliseconds(timestamps.front(), timestamps.back());
+        }
+    }
+
+    if (*m_statisticsPool)
+    {
+        const uint32_t firstStatisticsQuery = static_cast<uint32_t>(m_passes.size()) * frameIndex;
+        for (size_t i = 0; i < frameTiming.passes.size(); ++i)
+        {
+            if (!m_passes[i].countFragments)
+            {
+                continue;
+            }
+
+            auto [result, invocations] = m_statisticsPool.getResult<uint64_t>(
+                firstStatisticsQuery + static_cast<uint32_t>(i), 1, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+            if (result == vk::Result::eSuccess)
+            {
+                frameTiming.passes[i].fragmentShaderInvocations = invocations;
+            }
+        }
+    }
+
+    m_lastFrameTiming = frameTiming;
+}
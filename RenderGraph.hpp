@@ -21,8 +21,11 @@
 
 #pragma once
 
+#include <chrono>
 #include <functional>
+#include <optional>
 
+#include "Pipeline.hpp"
 #include "RHI.hpp"
 
 namespace Gfx
@@ -37,6 +40,18 @@ namespace Gfx
         using RecordFunc = std::function<void(vk::raii::CommandBuffer&, uint32_t)>;
         RecordFunc recordFunc;
 
+        // Pipelines bound by recordFunc. While any of them is still building without a usable fallback,
+        // recordFunc is skipped for the frame (the pass barriers are still recorded).
+        std::vector<const Pipeline*> pipelines;
+
+        // The pass output changes with time alone (animation, simulation), so on-demand rendering keeps drawing
+        // frames while it runs
+        bool animated = false;
+
+        // Count the fragment shader invocations of the pass with a pipeline statistics query, see
+        // PassTiming::fragmentShaderInvocations. recordFunc must begin and end its own rendering.
+        bool countFragments = false;
+
         struct AttachmentTransitionInfo
         {
             std::vector<vk::Image> images; // images to transition (e.g. swapchain image for color, depth image for depth)
@@ -68,11 +83,27 @@ namespace Gfx
         std::vector<BufferTransitionInfo> bufferInfos;
     };
 
+    struct PassTiming
+    {
+        std::string name;
+        double cpuMilliseconds = 0.0; // recording the pass, barriers included
+        double gpuMilliseconds = 0.0; // between the timestamps around the pass, 0 without timestamp support
+        uint64_t fragmentShaderInvocations = 0; // passes with countFragments, 0 without pipeline statistics support
+    };
+
+    struct FrameTiming
+    {
+        uint64_t frame = 0;
+        double cpuMilliseconds = 0.0; // acquire, record, submit and present, not the wait for the frame's fence
+        double gpuMilliseconds = 0.0; // from the start of the first pass to the end of the last one
+        std::vector<PassTiming> passes;
+    };
+
     class RenderGraph
     {
     public:
         // Construct with references to objects managed elsewhere (HelloTriangleApplication keeps lifetime)
-        RenderGraph(const RHI& rhi);
+        RenderGraph(RHI& rhi);
         RenderGraph(const RenderGraph&) = delete;
 
         // Add a render pass node. Nodes are executed in the order they are added.
@@ -88,8 +119,25 @@ namespace Gfx
         // use pipelineBarrier2 (ImageMemoryBarrier2 + DependencyInfo).
         void executeFrame();
 
+        // Timing of the most recent frame the GPU has finished, i.e. from getMaxFramesInFlight() frames ago.
+        // Empty until the first frame completes.
+        const std::optional<FrameTiming>& getLastFrameTiming() const { return m_lastFrameTiming; }
+
+        // Number of the frame the next executeFrame() records, as FrameTiming::frame will report it
+        uint64_t getCurrentFrame() const { return m_currentFrame; }
+
+        // Whether any animated pass would record this frame, i.e. is not skipped for a pipeline still building
+        bool hasActiveAnimatedPasses() const;
+
+        // Ends the pipeline statistics query of a countFragments pass from the next frame on; frames already
+        // recorded with it report no count either
+        void stopCountingFragments(const std::string& passName);
+
     private:
-		const RHI& m_rhi;
+        void collectFrameTiming(uint32_t frameIndex);
+
+    private:
+		RHI& m_rhi;
 
         // recorded passes
         std::vector<RenderPassNode> m_passes;
@@ -102,6 +150,19 @@ namespace Gfx
         std::vector<vk::raii::Semaphore> m_renderFinishedSemaphores;
         std::vector<vk::raii::Fence> m_inFlightFences;
 
+        // two timestamps per pass for every frame in flight, null when the queue can't write timestamps
+        vk::raii::QueryPool m_timestampPool = nullptr;
+        double m_timestampPeriod = 0.0; // nanoseconds per timestamp tick
+
+        // one fragment shader invocation count per pass for every frame in flight, only the passes with
+        // countFragments use theirs; null without pipeline statistics support
+        vk::raii::QueryPool m_statisticsPool = nullptr;
+
+        // per-frame timings, CPU times are filled in while recording and GPU times once the fence signals
+        std::vector<FrameTiming> m_frameTimings;
+        std::vector<bool> m_frameTimingPending;
+        std::optional<FrameTiming> m_lastFrameTiming;
+
         uint64_t m_currentFrame = 0;
     };
 }
\ No newline at end of file
@@ -0,0 +1,342 @@
+#include "ShaderCompiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <windows.h>
+#include <wrl/client.h>
+#include <dxc/dxcapi.h>
+
+#include "ThreadPool.hpp"
+
+using Gfx::ShaderCompiler;
+using Microsoft::WRL::ComPtr;
+
+// Bump when the compiler arguments change so stale cache entries are not reused
+static const char* cacheVersion = "dxc-spirv-1";
+
+static const char* getProfile(vk::ShaderStageFlagBits stage) {
+    switch (stage) {
+    case vk::ShaderStageFlagBits::eVertex:
+        return "vs_6_6";
+    case vk::ShaderStageFlagBits::eFragment:
+        return "ps_6_6";
+    case vk::ShaderStageFlagBits::eCompute:
+        return "cs_6_6";
+    default:
+        throw std::invalid_argument("unsupported shader stage!");
+    }
+}
+
+static std::wstring widen(const std::string& str) {
+    return std::wstring(str.begin(), str.end());
+}
+
+static std::string readTextFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + filename);
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+static std::vector<uint32_t> readSpirvFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file: " + filename);
+    }
+
+    std::vector<uint32_t> buffer(static_cast<size_t>(file.tellg()) / sizeof(uint32_t));
+
+    file.seekg(0, std::ios::beg);
+    file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(uint32_t)));
+
+    return buffer;
+}
+
+// FNV-1a, good enough to tell shader sources apart
+static void hashAppend(uint64_t& hash, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+static void hashAppend(uint64_t& hash, const std::string& str) {
+    hashAppend(hash, str.data(), str.size());
+    hashAppend(hash, "\0", 1); // separator, so ("ab", "c") and ("a", "bc") differ
+}
+
+template<typename File>
+static void collectSources(const std::filesystem::path& path, std::vector<File>& files) {
+    auto text = readTextFile(path.string());
+    files.push_back({ path.lexically_normal().generic_string(), text });
+
+    std::istringstream stream(text);
+    std::string line;
+
+    while (std::getline(stream, line)) {
+        auto pos = line.find_first_not_of(" \t");
+        if (pos == std::string::npos || line.compare(pos, 8, "#include") != 0) {
+            continue;
+        }
+
+        auto open = line.find('"', pos + 8);
+        auto close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            continue; // system includes are not used by our shaders
+        }
+
+        auto include = (path.parent_path() / line.substr(open + 1, close - open - 1)).lexically_normal();
+        auto included = std::any_of(files.begin(), files.end(), [&](const File& file) { return file.path == include.generic_string(); });
+        if (!included) {
+            collectSources(include, files);
+        }
+    }
+}
+
+// Serves DXC the includes read for the cache key instead of reading them from disk again
+template<typename File>
+class SourceIncludeHandler : public IDxcIncludeHandler
+{
+public:
+    SourceIncludeHandler(IDxcUtils* utils, const std::vector<File>& sources) :
+        m_utils(utils),
+        m_sources(sources)
+    {
+    }
+
+    HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR filename, IDxcBlob** includeSource) override
+    {
+        *includeSource = nullptr;
+
+        // DXC hands over the include joined to the directory it searches, e.g. ./Shaders/common.fxh
+        auto path = std::filesystem::absolute(std::filesystem::path(filename)).lexically_normal();
+        auto source = std::find_if(m_sources.begin(), m_sources.end(), [&](const File& file) {
+            return std::filesystem::absolute(file.path).lexically_normal() == path;
+        });
+        if (source == m_sources.end()) {
+            return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND); // not one we hashed, DXC tries the next include directory
+        }
+
+        ComPtr<IDxcBlobEncoding> blob;
+        auto result = m_utils->CreateBlob(source->text.data(), static_cast<UINT32>(source->text.size()), DXC_CP_UTF8, &blob);
+        if (SUCCEEDED(result)) {
+            *includeSource = blob.Detach();
+        }
+        return result;
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+    {
+        if (riid == __uuidof(IDxcIncludeHandler) || riid == __uuidof(IUnknown)) {
+            *object = static_cast<IDxcIncludeHandler*>(this);
+            return S_OK;
+        }
+        *object = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    // lives on the stack for the duration of one Compile()
+    ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+    ULONG STDMETHODCALLTYPE Release() override { return 1; }
+
+private:
+    IDxcUtils* m_utils;
+    const std::vector<File>& m_sources;
+};
+
+ShaderCompiler::ShaderCompiler(ThreadPool& workers, const std::string& cacheDirectory) :
+    m_workers(workers),
+    m_cacheDirectory(cacheDirectory)
+{
+    std::filesystem::create_directories(m_cacheDirectory);
+}
+
+std::vector<uint32_t> ShaderCompiler::compile(const ShaderDesc& shader) const
+{
+    if (std::filesystem::path(shader.path).extension() == ".spv") {
+        return readSpirvFile(shader.path);
+    }
+
+    auto sources = readSources(shader.path);
+    auto cachePath = getCachePath(shader, sources);
+    if (std::filesystem::exists(cachePath)) {
+        return readSpirvFile(cachePath);
+    }
+
+    auto spirv = compileHLSL(shader, sources);
+
+    // Write to a unique temporary first so concurrent compiles of the same permutation never see a partial file
+    std::stringstream tempPath;
+    tempPath << cachePath << "." << std::this_thread::get_id() << ".tmp";
+    bool written = false;
+    {
+        std::ofstream file(tempPath.str(), std::ios::binary);
+        file.write(reinterpret_cast<const char*>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+        file.close();
+        written = !file.fail();
+    }
+
+    // a failed or short write would be trusted by every later run, so it only stays uncached
+    std::error_code error;
+    if (!written) {
+        std::filesystem::remove(tempPath.str(), error);
+        return spirv;
+    }
+
+    std::filesystem::rename(tempPath.str(), cachePath, error);
+    if (error) {
+        std::filesystem::remove(tempPath.str(), error);
+    }
+
+    return spirv;
+}
+
+std::future<std::vector<uint32_t>> ShaderCompiler::compileAsync(const ShaderDesc& shader) const
+{
+    return m_workers.submit([this, shader]() { return compile(shader); });
+}
+
+void ShaderCompiler::precompile(const std::vector<ShaderDesc>& shaders) const
+{
+    std::vector<std::future<std::vector<uint32_t>>> jobs{};
+
+    for (const auto& shader : shaders) {
+        if (std::filesystem::path(shader.path).extension() == ".spv" || std::filesystem::exists(getCachePath(shader, readSources(shader.path)))) {
+            continue;
+        }
+        jobs.emplace_back(compileAsync(shader));
+    }
+
+    // wait for everything before rethrowing, the jobs reference this compiler
+    std::exception_ptr firstError = nullptr;
+    for (auto& job : jobs) {
+        try {
+            job.get();
+        }
+        catch (...) {
+            if (!firstError) {
+                firstError = std::current_exception();
+            }
+        }
+    }
+
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
+std::vector<std::string> ShaderCompiler::getDependencies(const std::string& path) const
+{
+    std::vector<std::string> dependencies{};
+    for (const auto& source : readSources(path)) {
+        dependencies.push_back(source.path);
+    }
+    return dependencies;
+}
+
+std::vector<ShaderCompiler::SourceFile> ShaderCompiler::readSources(const std::string& path) const
+{
+    std::vector<SourceFile> sources{};
+    collectSources(std::filesystem::path(path), sources);
+    return sources;
+}
+
+std::string ShaderCompiler::getCachePath(const ShaderDesc& shader, const std::vector<SourceFile>& sources) const
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    hashAppend(hash, cacheVersion);
+    hashAppend(hash, getProfile(shader.stage));
+    for (const auto& define : shader.defines) {
+        hashAppend(hash, define);
+    }
+    for (const auto& source : sources) {
+        hashAppend(hash, source.path);
+        hashAppend(hash, source.text);
+    }
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+
+    // e.g. ShaderCache/cloud.frag.0123456789abcdef.spv
+    auto name = std::filesystem::path(shader.path).stem().string();
+    return m_cacheDirectory + "/" + name + "." + key + ".spv";
+}
+
+std::vector<uint32_t> ShaderCompiler::compileHLSL(const ShaderDesc& shader, const std::vector<SourceFile>& sources) const
+{
+    // DXC objects are not thread-safe, so every compile gets its own
+    ComPtr<IDxcUtils> utils;
+    ComPtr<IDxcCompiler3> compiler;
+    if (FAILED(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils))) ||
+        FAILED(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler)))) {
+        throw std::runtime_error("failed to create DXC compiler instance!");
+    }
+
+    SourceIncludeHandler<SourceFile> includeHandler(utils.Get(), sources);
+    const auto& source = sources.front().text;
+
+    // same arguments as Shaders/compile_shaders.bat
+    std::vector<std::wstring> arguments = {
+        widen(shader.path),
+        L"-spirv",
+        L"-fspv-target-env=vulkan1.3",
+        L"-T", widen(getProfile(shader.stage)),
+        L"-E", L"main",
+        L"-I", std::filesystem::path(shader.path).parent_path().wstring(),
+    };
+    for (const auto& define : shader.defines) {
+        arguments.emplace_back(L"-D");
+        arguments.emplace_back(widen(define));
+    }
+
+    // float16_t needs native 16-bit types; the define already keeps the permutation apart in the cache
+    if (std::find(shader.defines.begin(), shader.defines.end(), "USE_FP16=1") != shader.defines.end()) {
+        arguments.emplace_back(L"-enable-16bit-types");
+    }
+
+    std::vector<LPCWSTR> argumentPtrs{};
+    argumentPtrs.reserve(arguments.size());
+    for (const auto& argument : arguments) {
+        argumentPtrs.push_back(argument.c_str());
+    }
+
+    DxcBuffer sourceBuffer{};
+    sourceBuffer.Ptr = source.data();
+    sourceBuffer.Size = source.size();
+    sourceBuffer.Encoding = DXC_CP_UTF8;
+
+    ComPtr<IDxcResult> result;
+    compiler->Compile(&sourceBuffer, argumentPtrs.data(), static_cast<UINT32>(argumentPtrs.size()), &includeHandler, IID_PPV_ARGS(&result));
+
+    HRESULT status = E_FAIL;
+    if (result) {
+        result->GetStatus(&status);
+    }
+
+    if (FAILED(status)) {
+        ComPtr<IDxcBlobUtf8> errors;
+        if (result) {
+            result->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&errors), nullptr);
+        }
+        throw std::runtime_error("failed to compile " + shader.path + ": " + (errors ? errors->GetStringPointer() : "unknown error"));
+    }
+
+    ComPtr<IDxcBlob> object;
+    result->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&object), nullptr);
+
+    std::vector<uint32_t> spirv(object->GetBufferSize() / sizeof(uint32_t));
+    memcpy(spirv.data(), object->GetBufferPointer(), spirv.size() * sizeof(uint32_t));
+
+    return spirv;
+}
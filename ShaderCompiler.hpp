@@ -0,0 +1,58 @@
+#pragma once
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include "RHI.hpp"
+
+namespace Gfx
+{
+	class ThreadPool;
+
+	// In-process HLSL -> SPIR-V compiler built on the DXC library.
+	//
+	// - Compiled SPIR-V is cached on disk, keyed by a hash of the source, every file it includes,
+	//   the permutation defines and the target profile; unchanged permutations never reach DXC again
+	// - Every file is read once per compile and DXC gets the same bytes that were hashed, includes too,
+	//   so a file saved mid-compile can't end up cached under the hash of its previous contents
+	// - Paths ending in .spv are loaded as-is, so precompiled shaders keep working
+	// - Safe to call from several threads at once; every compile uses its own DXC instance
+	class ShaderCompiler
+	{
+	public:
+		ShaderCompiler(ThreadPool& workers, const std::string& cacheDirectory = "ShaderCache");
+		ShaderCompiler(const ShaderCompiler&) = delete;
+
+		// Returns SPIR-V for the shader, compiling and caching it on a miss
+		std::vector<uint32_t> compile(const ShaderDesc& shader) const;
+
+		// Same as compile(), but runs on a worker thread
+		std::future<std::vector<uint32_t>> compileAsync(const ShaderDesc& shader) const;
+
+		// Compiles every permutation missing from the cache on the worker threads and waits for all of them.
+		// Rethrows the first compile error.
+		void precompile(const std::vector<ShaderDesc>& shaders) const;
+
+		// The source file followed by everything it includes, recursively
+		std::vector<std::string> getDependencies(const std::string& path) const;
+
+		const std::string& getCacheDirectory() const { return m_cacheDirectory; }
+
+	private:
+		struct SourceFile
+		{
+			std::string path; // relative to the working directory, normalized
+			std::string text;
+		};
+
+		// The source followed by everything it includes, recursively
+		std::vector<SourceFile> readSources(const std::string& path) const;
+		std::string getCachePath(const ShaderDesc& shader, const std::vector<SourceFile>& sources) const;
+		std::vector<uint32_t> compileHLSL(const ShaderDesc& shader, const std::vector<SourceFile>& sources) const;
+
+	private:
+		ThreadPool& m_workers;
+		std::string m_cacheDirectory;
+	};
+}
@@ -0,0 +1,72 @@
+#include "ShaderWatcher.hpp"
+
+using Gfx::ShaderWatcher;
+
+ShaderWatcher::ShaderWatcher(ChangedFunc onChanged, std::chrono::milliseconds interval) :
+    m_onChanged(std::move(onChanged)),
+    m_interval(interval),
+    m_thread(&ShaderWatcher::pollLoop, this)
+{
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    m_thread.join();
+}
+
+void ShaderWatcher::watch(const std::vector<std::string>& files)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const auto& file : files) {
+        if (m_files.count(file)) {
+            continue;
+        }
+
+        std::error_code error;
+        auto lastWriteTime = std::filesystem::last_write_time(file, error);
+        m_files.emplace(file, WatchedFile{ error ? std::filesystem::file_time_type::min() : lastWriteTime });
+    }
+}
+
+void ShaderWatcher::pollLoop()
+{
+    for (;;)
+    {
+        std::vector<std::string> changedFiles{};
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_condition.wait_for(lock, m_interval, [this] { return m_stopping; })) {
+                return;
+            }
+
+            for (auto& [path, file] : m_files) {
+                std::error_code error;
+                auto lastWriteTime = std::filesystem::last_write_time(path, error);
+                if (error) {
+                    continue; // some editors save by deleting and renaming, try again next poll
+                }
+
+                if (lastWriteTime != file.lastWriteTime) {
+                    file.lastWriteTime = lastWriteTime;
+                    file.pending = true;
+                }
+                else if (file.pending) {
+                    file.pending = false;
+                    changedFiles.push_back(path);
+                }
+            }
+        }
+
+        // called without the lock so the callback can watch() newly included files
+        if (!changedFiles.empty()) {
+            m_onChanged(changedFiles);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Gfx
+{
+	// Polls a set of shader files on a background thread and reports the ones that changed.
+	//
+	// - A change is only reported once the file has stayed unchanged for a full poll interval,
+	//   so editors that save in several steps trigger a single reload
+	// - The callback runs on the watcher thread
+	class ShaderWatcher
+	{
+	public:
+		using ChangedFunc = std::function<void(const std::vector<std::string>&)>;
+
+		ShaderWatcher(ChangedFunc onChanged, std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+		ShaderWatcher(const ShaderWatcher&) = delete;
+		~ShaderWatcher();
+
+		// Starts watching the files; already watched files are ignored
+		void watch(const std::vector<std::string>& files);
+
+	private:
+		void pollLoop();
+
+	private:
+		struct WatchedFile
+		{
+			std::filesystem::file_time_type lastWriteTime;
+			bool pending = false; // changed during the previous poll, waiting for writes to settle
+		};
+
+		ChangedFunc m_onChanged;
+		std::chrono::milliseconds m_interval;
+		std::unordered_map<std::string, WatchedFile> m_files;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stopping = false;
+
+		// Declared last so every member is initialized before polling starts
+		std::thread m_thread;
+	};
+}
@@ -1,11 +1,13 @@
 #include "common.fxh"
 
-#define MAX_STEPS 100
-#define LIGHT_STEPS 6
-#define STEP_SIZE 2.5
+// Quality tier, specialized at pipeline creation (defaults are the high tier)
+[[vk::constant_id(0)]] const int MAX_STEPS = 100;
+[[vk::constant_id(1)]] const int LIGHT_STEPS = 6;
+[[vk::constant_id(2)]] const float STEP_SIZE = 2.5;
 
-static const float3 Cloud_SunLum = float3(1.0, 0.95, 0.85) * 10.0;
-static const float3 Cloud_AmbLum = float3(0.3, 0.5, 0.8) * 1.5;
+// Marching and the noise stay float, the lighting and compositing are done in real
+static const real3 Cloud_SunLum = real3(1.0, 0.95, 0.85) * 10.0;
+static const real3 Cloud_AmbLum = real3(0.3, 0.5, 0.8) * 1.5;
 
 static const float3 BoxMin = float3(-250.0, 0.0, -250.0);
 static const float3 BoxMax = float3(250.0, 150.0, 250.0);
@@ -98,25 +100,25 @@ float SampleCloudDensity(float3 p)
     if (dsdf > 0.0)
         return 0.0;
 
-    float profile = clamp(-dsdf / 35.0, 0.0, 1.0);
+    real profile = real(clamp(-dsdf / 35.0, 0.0, 1.0));
 
     // Higher frequency detail noise (was 0.015, now 0.035)
     float3 np = p * 0.035 + wind * 0.3;
-    float n = fbm(np);
-    float wispy = n;
-    float billowy = 1.0 - abs(n * 2.0 - 1.0);
-    float nc = lerp(wispy, billowy, smoothstep(0.0, 1.0, profile));
+    real n = real(fbm(np));
+    real wispy = n;
+    real billowy = 1.0 - abs(n * 2.0 - 1.0);
+    real nc = lerp(wispy, billowy, smoothstep(0.0, 1.0, profile));
 
     // smoothstep erosion — no hard shell contour artifacts
-    float density = smoothstep(0.0, 0.25, profile - nc * 0.55);
+    real density = smoothstep(0.0, 0.25, profile - nc * 0.55);
 
     return density * 2.0;
 }
 
 // --- LIGHTING ---
-float PhaseHG(float cosTheta, float g)
+real PhaseHG(real cosTheta, real g)
 {
-    float g2 = g * g;
+    real g2 = g * g;
     return (1.0 - g2) / pow(abs(1.0 + g2 - 2.0 * g * cosTheta), 1.5) * 0.079577;
 }
 
@@ -160,12 +162,12 @@ float4 main(float4 fragCoord : SV_Position) : SV_Target
     float3 up = cross(right, fwd);
     float3 rd = normalize(fwd + right * uv.x + up * uv.y);
 
-    float3 skyColor = lerp(float3(0.8, 0.5, 0.4), float3(0.1, 0.3, 0.7), clamp(uv.y + 0.5, 0.0, 1.0));
+    real3 skyColor = lerp(real3(0.8, 0.5, 0.4), real3(0.1, 0.3, 0.7), real(clamp(uv.y + 0.5, 0.0, 1.0)));
     float sun = clamp(dot(rd, ubo.nLightDir.xyz), 0.0, 1.0);
-    skyColor += float3(1.0, 0.8, 0.4) * pow(sun, 100.0) * 2.0;
+    skyColor += real3(1.0, 0.8, 0.4) * real(pow(sun, 100.0) * 2.0); // fp16 can't resolve sun close to 1
 
-    float3 color = float3(0.0, 0.0, 0.0);
-    float transmittance = 1.0;
+    real3 color = real3(0.0, 0.0, 0.0);
+    real transmittance = 1.0;
 
     float2 bounds = RayAABB(ro, rd, BoxMin, BoxMax);
 
@@ -173,8 +175,9 @@ float4 main(float4 fragCoord : SV_Position) : SV_Target
     {
         float jitter = hash(float3(fragCoord.xy, ubo.time)) * STEP_SIZE;
         float t = bounds.x + jitter;
-        float cosTheta = dot(rd, ubo.nLightDir.xyz);
-        float phase = PhaseHG(cosTheta, 0.3) * 0.7 + PhaseHG(cosTheta, -0.1) * 0.3;
+        real cosTheta = real(dot(rd, ubo.nLightDir.xyz));
+        real phase = PhaseHG(cosTheta, 0.3) * 0.7 + PhaseHG(cosTheta, -0.1) * 0.3;
+        real stepSize = real(STEP_SIZE);
 
         for (int i = 0; i < MAX_STEPS; i++)
         {
@@ -188,26 +191,26 @@ float4 main(float4 fragCoord : SV_Position) : SV_Target
             // units beyond the clean SDF surface
             if (sdf <= DISPLACE_AMP)
             {
-                float density = SampleCloudDensity(p);
+                real density = real(SampleCloudDensity(p));
                 if (density > 0.001)
                 {
-                    float ext = density * 0.12;
-                    float stepT = exp(-ext * STEP_SIZE);
+                    real ext = density * 0.12;
+                    real stepT = exp(-ext * stepSize);
 
-                    float lightDen = LightMarch(p);
+                    real lightDen = real(LightMarch(p));
 
                     // Near-neutral extinction — much less brown tint
-                    float3 shadow = exp(-lightDen * 0.12 * float3(0.95, 0.97, 1.0));
+                    real3 shadow = exp(-lightDen * 0.12 * real3(0.95, 0.97, 1.0));
 
-                    float depth = clamp(-sdf / 30.0, 0.0, 1.0);
-                    float3 ms = exp(-lightDen * 0.02 * float3(0.95, 0.97, 1.0)) * 0.35 * depth;
-                    float3 transToSun = shadow + ms;
+                    real depth = real(clamp(-sdf / 30.0, 0.0, 1.0));
+                    real3 ms = exp(-lightDen * 0.02 * real3(0.95, 0.97, 1.0)) * 0.35 * depth;
+                    real3 transToSun = shadow + ms;
 
-                    float3 direct = Cloud_SunLum * transToSun * phase;
-                    float3 ambient = Cloud_AmbLum * (0.5 + 0.5 * (1.0 - depth));
+                    real3 direct = Cloud_SunLum * transToSun * phase;
+                    real3 ambient = Cloud_AmbLum * (0.5 + 0.5 * (1.0 - depth));
 
-                    float3 S = (direct + ambient) * density;
-                    color += S * transmittance * STEP_SIZE * 0.12;
+                    real3 S = (direct + ambient) * density;
+                    color += S * transmittance * stepSize * 0.12;
                     transmittance *= stepT;
                 }
                 t += STEP_SIZE;
@@ -220,11 +223,11 @@ float4 main(float4 fragCoord : SV_Position) : SV_Target
         }
     }
 
-    float3 finalColor = color + skyColor * transmittance;
+    real3 finalColor = color + skyColor * transmittance;
     finalColor = finalColor / (1.0 + finalColor);
     
     // Using abs() in pow prevents compilation errors/warnings in strict HLSL environments
-    finalColor = pow(abs(finalColor), float3(1.0 / 2.2, 1.0 / 2.2, 1.0 / 2.2));
+    finalColor = pow(abs(finalColor), real3(1.0 / 2.2, 1.0 / 2.2, 1.0 / 2.2));
 
     return float4(finalColor, 1.0);
 }
\ No newline at end of file
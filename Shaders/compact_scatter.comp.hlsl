@@ -0,0 +1,37 @@
+#include "primitives.fxh"
+
+// Writes the indices of the kept elements instead of their values, input is not read
+[[vk::constant_id(0)]] const bool COMPACT_INDICES = false;
+
+RWStructuredBuffer<uint> input : register(u0, space0);
+RWStructuredBuffer<uint> flags : register(u1, space0);
+RWStructuredBuffer<uint> offsets : register(u2, space0); // exclusive scan of flags != 0
+RWStructuredBuffer<uint> output : register(u3, space0);
+RWStructuredBuffer<uint> outputCount : register(u4, space0);
+
+[numthreads(PRIMITIVE_GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    uint first = groupId.x * PRIMITIVE_BLOCK_SIZE + threadId.x;
+
+    [unroll]
+    for (uint i = 0; i < PRIMITIVE_ITEMS_PER_THREAD; ++i)
+    {
+        uint index = first + i * PRIMITIVE_GROUP_SIZE;
+        if (index < constants.count && flags[index] != 0)
+        {
+            output[offsets[index]] = COMPACT_INDICES ? index : input[index];
+        }
+    }
+
+    if (groupId.x == 0 && threadId.x == 0)
+    {
+        uint count = 0;
+        if (constants.count > 0)
+        {
+            uint last = constants.count - 1;
+            count = offsets[last] + (flags[last] != 0 ? 1 : 0);
+        }
+        outputCount[0] = count;
+    }
+}
@@ -0,0 +1,29 @@
+#include "common.fxh"
+
+// Only the position stream is bound, the prepass fetches 12 bytes per vertex instead of a whole Vertex
+struct PositionInput
+{
+    float3 position : ATTRIB0;
+    uint sv_instanceID : SV_InstanceID;
+};
+
+struct VertexOutput
+{
+    float4 sv_position : SV_Position;
+};
+
+ConstantBuffer<UniformBuffer> ubo : register(b0, space0);
+
+StructuredBuffer<StorageBuffer> ssbo : register(t1, space0);
+
+VertexOutput main(PositionInput input)
+{
+    StorageBuffer instanceData = ssbo[input.sv_instanceID];
+    VertexOutput output;
+
+    float4 worldPosition = getWorldPosition(input.position, ubo.rotation, instanceData);
+    precise float4 clipPosition = mul(ubo.proj, mul(ubo.view, worldPosition)); // bit-exact with gbuffer.vert.hlsl
+
+    output.sv_position = clipPosition;
+    return output;
+}
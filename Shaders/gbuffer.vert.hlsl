@@ -18,10 +18,8 @@ VertexOutput main(VertexInput input)
 {
     StorageBuffer instanceData = ssbo[input.sv_instanceID];
     VertexOutput output;
-    float3 animatedPosition = rotateFloat3(input.position, ubo.rotation);
-    float4 worldPosition = mul(instanceData.model, float4(animatedPosition, 1.0)) + float4(instanceData.particleOffset, 0);
-    float4 viewPosition = mul(ubo.view, worldPosition);
-    float4 clipPosition = mul(ubo.proj, viewPosition);
+    float4 worldPosition = getWorldPosition(input.position, ubo.rotation, instanceData);
+    precise float4 clipPosition = mul(ubo.proj, mul(ubo.view, worldPosition)); // bit-exact with depth_prepass.vert.hlsl
     output.sv_position = clipPosition;
     output.colour = instanceData.colour;
     output.normalWS = normalize(rotateFloat3(input.normal, ubo.rotation));
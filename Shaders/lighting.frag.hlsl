@@ -16,58 +16,98 @@ Texture2D<float4> normals : register(t3, space0);
 SamplerState normalSampler : register(s3, space0);
 Texture2D<float4> positions : register(t4, space0);
 SamplerState positionSampler : register(s4, space0);
-Texture2D<float4> shadowMap : register(t5, space0);
+Texture2DArray<float4> shadowMap : register(t5, space0); // one layer per cascade
 SamplerState shadowSampler : register(s5, space0);
 Texture2D<uint> instanceIDs : register(t6, space0);
 
+// Number of particle lights baked into the pipeline; 0 falls back to ubo.particleCount.
+// A fixed count lets the compiler fully unroll the light loop.
+[[vk::constant_id(0)]] const uint PARTICLE_LIGHT_COUNT = 0;
+
+real3 shadeParticleLight(uint i, real3 albedo, real3 N, float3 positionWS)
+{
+    float3 lightPos = mul(ssbo[i].model, float4(0, 0, 0, 1)).xyz + ssbo[i].particleOffset;
+    float3 toLight = lightPos - positionWS;
+    float dist2 = dot(toLight, toLight);
+    float dist = sqrt(dist2);
+    real3 L = real3(toLight / dist);
+    real NdotL = saturate(dot(N, L));
+    real attenuation = real(1.0 / (1.0 + 15.0 * dist2));
+    return albedo * real3(ssbo[i].colour) * NdotL * attenuation;
+}
+
 float4 main(VSOutput input) : SV_Target
 {
+    // the G-buffer may only be rendered in its top left (render scale), so address it by pixel, not by input.uv
     uint width, height;
     instanceIDs.GetDimensions(width, height);
-    int2 pixelCoords = int2(input.uv.x * width, input.uv.y * height);
+    int2 pixelCoords = int2(input.position.xy);
+    float2 uv = input.position.xy / float2(width, height);
 
-    float4 colour = albedo.Sample(albedoSampler, input.uv);
-    float4 normalWS = normals.Sample(normalSampler, input.uv);
-    float4 positionWS = positions.Sample(positionSampler, input.uv);
+    real4 colour = real4(albedo.Sample(albedoSampler, uv));
+    float4 normalWS = normals.Sample(normalSampler, uv);
+    float4 positionWS = positions.Sample(positionSampler, uv);
     uint instanceID = instanceIDs.Load(int3(pixelCoords, 0));
+    uint particleCount = PARTICLE_LIGHT_COUNT != 0 ? PARTICLE_LIGHT_COUNT : ubo.particleCount;
 
     if (length(normalWS.xyz) < 0.0001)
     {
         discard;
     }
     
-    float diffuse = 1.0;
-    float shadowFactor = 1.0f;
+    real diffuse = 1.0;
+    real shadowFactor = 1.0;
 
-    if (instanceID > ubo.particleCount)
+    if (instanceID > particleCount)
     {
-        diffuse = saturate(dot(normalize(normalWS.xyz), ubo.nLightDir.xyz));
-        float4 lightViewPos = mul(ubo.lightView, positionWS);
-        float4 lightClipPos = mul(ubo.lightProj, lightViewPos);
+        diffuse = real(saturate(dot(normalize(normalWS.xyz), ubo.nLightDir.xyz)));
+
+        // the nearest cascade that reaches the pixel, the last one beyond them all
+        float viewDistance = -mul(ubo.view, positionWS).z;
+        uint cascade = 0;
+        while (cascade + 1 < ubo.cascadeCount && viewDistance > ubo.cascadeSplits[cascade])
+        {
+            cascade++;
+        }
+
+        float4 lightClipPos = mul(ubo.cascadeViewProj[cascade], positionWS);
         float3 lightNDC = lightClipPos.xyz / lightClipPos.w;
         float2 lightUV = lightNDC.xy * 0.5f + 0.5f;
         float lightDepth = lightNDC.z;
         if (lightUV.x >= 0.0f && lightUV.x <= 1.0f && lightUV.y >= 0.0f && lightUV.y <= 1.0f)
         {
-            float shadowDepth = shadowMap.Sample(shadowSampler, lightUV).r;
-            shadowFactor = (lightDepth > shadowDepth + 0.005f) ? 0.5f : 1.0f;
+            float shadowDepth = shadowMap.Sample(shadowSampler, float3(lightUV, cascade)).r;
+            shadowFactor = (lightDepth > shadowDepth + ubo.cascadeDepthBias[cascade]) ? 0.5f : 1.0f;
         }
     }
 
+    // the sum stays float, hundreds of small light contributions would round away in fp16
     float3 lit = colour.rgb * diffuse * shadowFactor;
 
-    float3 N = normalize(normalWS.xyz);
-    for (uint i = 0; i < ubo.particleCount; i++)
+    real3 N = real3(normalize(normalWS.xyz));
+
+    // The lights of this pixel, every one of them as long as lights aren't binned per tile or cluster
+    uint lightCursor = 0;
+    uint lightEnd = particleCount;
+
+#if USE_WAVE_OPS
+    // Scalarized: the wave walks the union of its lanes' lights in ascending order. Each light index is
+    // wave-uniform, so its data is fetched once per wave (scalar loads), and the lanes that have it shade it together.
+    while (WaveActiveAnyTrue(lightCursor < lightEnd))
+    {
+        uint light = WaveReadLaneFirst(WaveActiveMin(lightCursor < lightEnd ? lightCursor : 0xFFFFFFFF));
+        if (lightCursor < lightEnd && lightCursor == light)
+        {
+            lit += shadeParticleLight(light, colour.rgb, N, positionWS.xyz);
+            lightCursor++;
+        }
+    }
+#else
+    for (uint i = lightCursor; i < lightEnd; i++)
     {
-        float3 lightPos = mul(ssbo[i].model, float4(0, 0, 0, 1)).xyz + ssbo[i].particleOffset;
-        float3 toLight = lightPos - positionWS.xyz;
-        float dist2 = dot(toLight, toLight);
-        float dist = sqrt(dist2);
-        float3 L = toLight / dist;
-        float NdotL = saturate(dot(N, L));
-        float attenuation = 1.0 / (1.0 + 15.0 * dist2);
-        lit += colour.rgb * ssbo[i].colour * NdotL * attenuation;
+        lit += shadeParticleLight(i, colour.rgb, N, positionWS.xyz);
     }
+#endif
 
     return float4(lit, 1.0);
 }
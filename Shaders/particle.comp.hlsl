@@ -4,10 +4,14 @@ ConstantBuffer<UniformBuffer> ubo : register(b0, space0);
 
 RWStructuredBuffer<StorageBuffer> ssbo : register(u1, space0);
 
+// Number of particles baked into the pipeline; 0 falls back to ubo.particleCount
+[[vk::constant_id(0)]] const uint PARTICLE_COUNT = 0;
+
 [numthreads(64, 1, 1)]
 void main(uint3 tid : SV_DispatchThreadID)
 {
-    if (tid.x >= ubo.particleCount)
+    uint particleCount = PARTICLE_COUNT != 0 ? PARTICLE_COUNT : ubo.particleCount;
+    if (tid.x >= particleCount)
     {
         return;
     }
@@ -0,0 +1,36 @@
+#include "particles.fxh"
+
+// 0: before emit, sizes the emit and simulate dispatches
+// 1: after simulate, sets the instance count of the draw
+[[vk::constant_id(0)]] const uint ARGS_STAGE = 0;
+
+[numthreads(1, 1, 1)]
+void main()
+{
+    uint current = params.current;
+    uint next = 1 - current;
+
+    if (ARGS_STAGE == 0)
+    {
+        uint emitCount = min(params.emitCount, counters[COUNTER_DEAD]);
+        counters[COUNTER_EMIT] = emitCount;
+        counters[ARGS_EMIT + 0] = getGroupCount(emitCount);
+        counters[ARGS_EMIT + 1] = 1;
+        counters[ARGS_EMIT + 2] = 1;
+
+        // emit adds exactly emitCount particles to the current list
+        counters[ARGS_SIMULATE + 0] = getGroupCount(counters[COUNTER_ALIVE + current] + emitCount);
+        counters[ARGS_SIMULATE + 1] = 1;
+        counters[ARGS_SIMULATE + 2] = 1;
+
+        counters[COUNTER_ALIVE + next] = 0;
+    }
+    else
+    {
+        counters[ARGS_DRAW + 0] = 6; // two triangles per billboard
+        counters[ARGS_DRAW + 1] = counters[COUNTER_ALIVE + next];
+        counters[ARGS_DRAW + 2] = 0;
+        counters[ARGS_DRAW + 3] = 0;
+        counters[ARGS_DRAW + 4] = 0;
+    }
+}
@@ -0,0 +1,13 @@
+struct VertexOutput
+{
+    float4 sv_position : SV_Position;
+    float4 colour : COLOR0;
+    float2 corner : TEXCOORD0;
+};
+
+// Soft round sprite, blended additively
+float4 main(VertexOutput input) : SV_Target0
+{
+    float falloff = saturate(1.0 - dot(input.corner, input.corner));
+    return float4(input.colour.rgb * input.colour.a * falloff * falloff, 0.0);
+}
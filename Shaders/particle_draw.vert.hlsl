@@ -0,0 +1,25 @@
+#define PARTICLE_DRAW
+#include "particles.fxh"
+
+struct VertexOutput
+{
+    float4 sv_position : SV_Position;
+    float4 colour : COLOR0;
+    float2 corner : TEXCOORD0;
+};
+
+// One billboard per instance, the corner comes from the vertex index: 0..3 through the quad index buffer
+VertexOutput main(uint vertexID : SV_VertexID, uint instanceID : SV_InstanceID)
+{
+    uint next = 1 - params.current;
+    Particle particle = particles[aliveList[next * params.maxParticles + instanceID]];
+
+    float2 corner = float2(vertexID & 1, vertexID >> 1) * 2.0 - 1.0;
+    float3 position = particle.position + (corner.x * params.cameraRight.xyz + corner.y * params.cameraUp.xyz) * params.cameraRight.w;
+
+    VertexOutput output;
+    output.sv_position = mul(params.viewProj, float4(position, 1.0));
+    output.colour = lerp(params.startColour, params.endColour, saturate(particle.age / particle.lifetime));
+    output.corner = corner;
+    return output;
+}
@@ -0,0 +1,29 @@
+#include "particles.fxh"
+
+// Takes particles off the free list and appends them to the current alive list
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint3 tid : SV_DispatchThreadID)
+{
+    uint emitCount = counters[COUNTER_EMIT];
+    uint current = params.current;
+
+    for (uint i = tid.x; i < emitCount; i += PARTICLE_STRIDE)
+    {
+        uint deadCount;
+        InterlockedAdd(counters[COUNTER_DEAD], 0xFFFFFFFFu, deadCount); // pop, emitCount never exceeds the free particles
+        uint index = deadList[deadCount - 1];
+
+        uint seed = hash(params.seed ^ hash(i));
+
+        Particle particle;
+        particle.position = params.emitterPosition.xyz + randomInSphere(seed) * params.emitterPosition.w;
+        particle.velocity = params.emitterVelocity.xyz + randomInSphere(seed) * params.emitterVelocity.w;
+        particle.age = 0.0;
+        particle.lifetime = lerp(params.lifetimeMin, params.lifetimeMax, random(seed));
+        particles[index] = particle;
+
+        uint slot;
+        InterlockedAdd(counters[COUNTER_ALIVE + current], 1, slot);
+        aliveList[current * params.maxParticles + slot] = index;
+    }
+}
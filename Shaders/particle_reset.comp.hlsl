@@ -0,0 +1,20 @@
+#include "particles.fxh"
+
+// Puts every particle on the free list, run once before the first update
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint3 tid : SV_DispatchThreadID)
+{
+    for (uint i = tid.x; i < params.maxParticles; i += PARTICLE_STRIDE)
+    {
+        deadList[i] = i;
+        particles[i].age = 0.0;
+        particles[i].lifetime = 0.0;
+    }
+
+    if (tid.x == 0)
+    {
+        counters[COUNTER_DEAD] = params.maxParticles;
+        counters[COUNTER_ALIVE + 0] = 0;
+        counters[COUNTER_ALIVE + 1] = 0;
+    }
+}
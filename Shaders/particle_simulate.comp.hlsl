@@ -0,0 +1,43 @@
+#include "particles.fxh"
+
+// Ages and moves the current alive list; survivors go to the other list, the rest back to the free list
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint3 tid : SV_DispatchThreadID)
+{
+    uint current = params.current;
+    uint next = 1 - current;
+    uint aliveCount = counters[COUNTER_ALIVE + current];
+    float deltaTime = params.deltaTime;
+
+    for (uint i = tid.x; i < aliveCount; i += PARTICLE_STRIDE)
+    {
+        uint index = aliveList[current * params.maxParticles + i];
+        Particle particle = particles[index];
+
+        particle.age += deltaTime;
+        if (particle.age >= particle.lifetime)
+        {
+            uint deadSlot;
+            InterlockedAdd(counters[COUNTER_DEAD], 1, deadSlot);
+            deadList[deadSlot] = index;
+            continue;
+        }
+
+        particle.velocity += params.gravity.xyz * deltaTime;
+        particle.velocity *= saturate(1.0 - params.gravity.w * deltaTime);
+        particle.position += particle.velocity * deltaTime;
+
+        // bounce off the floor instead of falling through it
+        if (particle.position.z < 0.0)
+        {
+            particle.position.z = -particle.position.z;
+            particle.velocity.z = abs(particle.velocity.z) * 0.5;
+        }
+
+        particles[index] = particle;
+
+        uint slot;
+        InterlockedAdd(counters[COUNTER_ALIVE + next], 1, slot);
+        aliveList[next * params.maxParticles + slot] = index;
+    }
+}
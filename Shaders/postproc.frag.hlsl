@@ -8,20 +8,24 @@ struct VSOutput
 
 ConstantBuffer<UniformBuffer> ubo : register(b0, space0);
 
+// FUSED_POSTPROC draws the rain with additive blending onto the scene in the lighting pass, so it never reads it
+#if !FUSED_POSTPROC
 Texture2D<float4> sceneColor : register(t1, space0);
 SamplerState colorSampler : register(s1, space0);
+#endif
 
 // Shadertoy: https://www.shadertoy.com/view/M3GfDV
 // --- Rain parameters (ported from Shadertoy) ---
 // rain_f corrected: original value of 1.9 causes drop() to always be negative
 // (1.5 * rnd_max - 0 - 1.9 = -0.4), so no drop is ever visible. 1.0 is the fix.
-static const float rain_d = 0.99; // density knob fed into k2 (higher -> heavier)
-static const float rain_p = 1.0; // speed multiplier
-static const float rain_f = 1.0; // drop threshold / softness   (was 1.9 — broken)
-static const float rain_s = 0.2; // base brightness scale
-static const float rain_c = 0.21; // brightness exponent input for k4
-static const float k1 = 50.0; // two-scale scroll pattern size
-static const float k3 = 5.0; // drop width (larger -> narrower)
+// All of them are specialization constants so variants can be baked without new .spv files.
+[[vk::constant_id(0)]] const float rain_d = 0.99; // density knob fed into k2 (higher -> heavier)
+[[vk::constant_id(1)]] const float rain_p = 1.0; // speed multiplier
+[[vk::constant_id(2)]] const float rain_f = 1.0; // drop threshold / softness   (was 1.9 — broken)
+[[vk::constant_id(3)]] const float rain_s = 0.2; // base brightness scale
+[[vk::constant_id(4)]] const float rain_c = 0.21; // brightness exponent input for k4
+[[vk::constant_id(5)]] const float k1 = 50.0; // two-scale scroll pattern size
+[[vk::constant_id(6)]] const float k3 = 5.0; // drop width (larger -> narrower)
 
 // Hash: [0, 1)
 float rnd1(float x)
@@ -54,6 +58,7 @@ float2 rainUV(float2 uv)
 
 float4 main(VSOutput input) : SV_Target
 {
+    // the drop pattern hashes large arguments, only the compositing is done in real
     float2 uv = rainUV(input.uv);
     float t = ubo.time;
 
@@ -71,9 +76,14 @@ float4 main(VSOutput input) : SV_Target
         uv.x - 0.5 - fracFn(t * rain_p, k1) + rnd1(uv.y) * k2,
         k3, rain_f);
 
-    float4 scene = sceneColor.Sample(colorSampler, input.uv);
+    real drop = real(saturate(r));
 
     // Add the drop brightness on top of the scene (simulates light refracted
     // through lens raindrops brightening localised spots).
-    return scene + float4(saturate(r), saturate(r), saturate(r), 0.0);
+#if FUSED_POSTPROC
+    return float4(drop, drop, drop, 0.0);
+#else
+    real4 scene = real4(sceneColor.Sample(colorSampler, input.uv));
+    return float4(scene + real4(drop, drop, drop, 0.0));
+#endif
 }
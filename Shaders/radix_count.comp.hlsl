@@ -0,0 +1,37 @@
+#include "primitives.fxh"
+
+RWStructuredBuffer<uint> keys : register(u0, space0);
+RWStructuredBuffer<uint> histograms : register(u1, space0); // digit-major: histograms[digit * blockCount + block]
+
+groupshared uint digitCounts[RADIX_BINS];
+
+// Counts the digits of one block. Stored digit-major, one exclusive scan over all histograms gives every block
+// the first output index of each of its digits.
+[numthreads(PRIMITIVE_GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    if (threadId.x < RADIX_BINS)
+    {
+        digitCounts[threadId.x] = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    uint first = groupId.x * PRIMITIVE_BLOCK_SIZE + threadId.x;
+
+    [unroll]
+    for (uint i = 0; i < PRIMITIVE_ITEMS_PER_THREAD; ++i)
+    {
+        uint index = first + i * PRIMITIVE_GROUP_SIZE;
+        if (index < constants.count)
+        {
+            uint digit = (keys[index] >> constants.shift) & (RADIX_BINS - 1);
+            InterlockedAdd(digitCounts[digit], 1);
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (threadId.x < RADIX_BINS)
+    {
+        histograms[threadId.x * constants.blockCount + groupId.x] = digitCounts[threadId.x];
+    }
+}
@@ -0,0 +1,72 @@
+#include "primitives.fxh"
+
+RWStructuredBuffer<uint> keysIn : register(u0, space0);
+RWStructuredBuffer<uint> valuesIn : register(u1, space0);
+RWStructuredBuffer<uint> histograms : register(u2, space0); // scanned, see radix_count.comp.hlsl
+RWStructuredBuffer<uint> keysOut : register(u3, space0);
+RWStructuredBuffer<uint> valuesOut : register(u4, space0);
+
+// Moves every element to the first index of its digit in its block, plus the number of elements before it in the
+// block with the same digit. Elements keep their order within a digit, which is what makes the sort stable.
+[numthreads(PRIMITIVE_GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    uint first = groupId.x * PRIMITIVE_BLOCK_SIZE + threadId.x * PRIMITIVE_ITEMS_PER_THREAD;
+
+    uint keys[PRIMITIVE_ITEMS_PER_THREAD];
+    uint digits[PRIMITIVE_ITEMS_PER_THREAD];
+    uint ranks[PRIMITIVE_ITEMS_PER_THREAD];
+
+    [unroll]
+    for (uint i = 0; i < PRIMITIVE_ITEMS_PER_THREAD; ++i)
+    {
+        keys[i] = 0;
+        digits[i] = RADIX_BINS; // past the end, matches no digit
+        ranks[i] = 0;
+        if (first + i < constants.count)
+        {
+            keys[i] = keysIn[first + i];
+            digits[i] = (keys[i] >> constants.shift) & (RADIX_BINS - 1);
+        }
+    }
+
+    // A block has at most PRIMITIVE_BLOCK_SIZE elements of a digit, so two digits share one scan in 16-bit halves
+    for (uint pair = 0; pair < RADIX_BINS / 2; ++pair)
+    {
+        uint packed = 0;
+
+        [unroll]
+        for (uint j = 0; j < PRIMITIVE_ITEMS_PER_THREAD; ++j)
+        {
+            if ((digits[j] >> 1) == pair)
+            {
+                packed += 1u << ((digits[j] & 1) * 16);
+            }
+        }
+
+        uint total;
+        uint prefix = blockExclusiveScan(packed, threadId.x, total);
+
+        [unroll]
+        for (uint k = 0; k < PRIMITIVE_ITEMS_PER_THREAD; ++k)
+        {
+            if ((digits[k] >> 1) == pair)
+            {
+                uint halfShift = (digits[k] & 1) * 16;
+                ranks[k] = (prefix >> halfShift) & 0xFFFF;
+                prefix += 1u << halfShift;
+            }
+        }
+    }
+
+    [unroll]
+    for (uint n = 0; n < PRIMITIVE_ITEMS_PER_THREAD; ++n)
+    {
+        if (digits[n] < RADIX_BINS)
+        {
+            uint index = histograms[digits[n] * constants.blockCount + groupId.x] + ranks[n];
+            keysOut[index] = keys[n];
+            valuesOut[index] = valuesIn[first + n];
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#include "primitives.fxh"
+
+RWStructuredBuffer<uint> output : register(u0, space0);
+RWStructuredBuffer<uint> blockOffsets : register(u1, space0); // the scanned block totals
+
+// Turns the per-block scans into one scan over all blocks
+[numthreads(PRIMITIVE_GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    uint offset = blockOffsets[groupId.x];
+    uint first = groupId.x * PRIMITIVE_BLOCK_SIZE + threadId.x;
+
+    [unroll]
+    for (uint i = 0; i < PRIMITIVE_ITEMS_PER_THREAD; ++i)
+    {
+        uint index = first + i * PRIMITIVE_GROUP_SIZE;
+        if (index < constants.count)
+        {
+            output[index] += offset;
+        }
+    }
+}
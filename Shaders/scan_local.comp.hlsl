@@ -0,0 +1,52 @@
+#include "primitives.fxh"
+
+// Scans (value != 0 ? 1 : 0) instead of the values, the output offsets of a stream compaction
+[[vk::constant_id(0)]] const bool SCAN_PREDICATE = false;
+
+RWStructuredBuffer<uint> input : register(u0, space0);
+RWStructuredBuffer<uint> output : register(u1, space0); // may be the input, every thread only rewrites what it read
+RWStructuredBuffer<uint> blockTotals : register(u2, space0);
+
+// Exclusive scan of every block on its own, plus the total of each block for the next level
+[numthreads(PRIMITIVE_GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    uint first = groupId.x * PRIMITIVE_BLOCK_SIZE + threadId.x * PRIMITIVE_ITEMS_PER_THREAD;
+
+    uint values[PRIMITIVE_ITEMS_PER_THREAD];
+    uint threadSum = 0;
+
+    [unroll]
+    for (uint i = 0; i < PRIMITIVE_ITEMS_PER_THREAD; ++i)
+    {
+        uint value = 0;
+        if (first + i < constants.count)
+        {
+            value = input[first + i];
+        }
+        if (SCAN_PREDICATE)
+        {
+            value = value != 0 ? 1 : 0;
+        }
+        values[i] = value;
+        threadSum += value;
+    }
+
+    uint blockTotal;
+    uint prefix = blockExclusiveScan(threadSum, threadId.x, blockTotal);
+
+    [unroll]
+    for (uint j = 0; j < PRIMITIVE_ITEMS_PER_THREAD; ++j)
+    {
+        if (first + j < constants.count)
+        {
+            output[first + j] = prefix;
+        }
+        prefix += values[j];
+    }
+
+    if (threadId.x == 0)
+    {
+        blockTotals[groupId.x] = blockTotal;
+    }
+}
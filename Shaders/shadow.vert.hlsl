@@ -9,15 +9,14 @@ ConstantBuffer<UniformBuffer> ubo : register(b0, space0);
 
 StructuredBuffer<StorageBuffer> ssbo : register(t1, space0);
 
-VertexOutput main(VertexInput input)
+// Multiview renders every cascade with the same draw, the view is the cascade
+VertexOutput main(VertexInput input, uint viewID : SV_ViewID)
 {
     StorageBuffer instanceData = ssbo[input.sv_instanceID];
     VertexOutput output;
 
-    float3 animatedPosition = rotateFloat3(input.position, ubo.rotation);
-    float4 worldPosition = mul(instanceData.model, float4(animatedPosition, 1.0)) + float4(instanceData.particleOffset, 0);
-    float4 viewPosition = mul(ubo.lightView, worldPosition);
-    float4 clipPosition = mul(ubo.lightProj, viewPosition);
+    float4 worldPosition = getWorldPosition(input.position, ubo.rotation, instanceData);
+    float4 clipPosition = mul(ubo.cascadeViewProj[viewID], worldPosition);
 
     output.sv_position = clipPosition;
     return output;
@@ -0,0 +1,125 @@
+#include "upscale.fxh"
+
+// Edge-adaptive spatial upsampling after AMD FidelityFX Super Resolution 1 (EASU): every output pixel filters
+// the 12 closest source texels with a Lanczos-2 approximation that is rotated along the local edge and
+// stretched along it by how strong the edge is, then clamped to the 4 closest texels against ringing.
+
+// Adds the gradient direction and edge strength around one of the 4 closest texels with bilinear weight w.
+// a, b, c, d and e are the luma above, left of, at, right of and below it.
+void easuSetDirection(inout float2 dir, inout float len, float w, float a, float b, float c, float d, float e)
+{
+    float dirX = d - b;
+    float lenX = saturate(abs(dirX) / max(max(abs(d - c), abs(c - b)), 1.0 / 65536.0));
+    dir.x += dirX * w;
+    len += lenX * lenX * w;
+
+    float dirY = e - a;
+    float lenY = saturate(abs(dirY) / max(max(abs(e - c), abs(c - a)), 1.0 / 65536.0));
+    dir.y += dirY * w;
+    len += lenY * lenY * w;
+}
+
+// One tap of the kernel, offset from the output pixel in source texels
+void easuTap(inout float3 colour, inout float weight, float2 offset, float2 dir, float2 len, float lobe, float clip, float3 c)
+{
+    // rotate into the edge frame and scale
+    float2 v = float2(dot(offset, dir), dot(offset, float2(-dir.y, dir.x))) * len;
+    float d2 = min(dot(v, v), clip);
+
+    // (25/16 * (2/5 * x^2 - 1)^2 - (25/16 - 1)) * (lobe * x^2 - 1)^2, a windowed Lanczos-2 without sin()
+    float wB = 2.0 / 5.0 * d2 - 1.0;
+    float wA = lobe * d2 - 1.0;
+    wB *= wB;
+    wA *= wA;
+    wB = 25.0 / 16.0 * wB - (25.0 / 16.0 - 1.0);
+    float w = wB * wA;
+
+    colour += c * w;
+    weight += w;
+}
+
+[numthreads(UPSCALE_GROUP_SIZE, UPSCALE_GROUP_SIZE, 1)]
+void main(uint3 tid : SV_DispatchThreadID)
+{
+    if (any(tid.xy >= constants.outputSize))
+    {
+        return;
+    }
+
+    uint2 size = constants.inputSize;
+    float2 pp = (float2(tid.xy) + 0.5) * float2(size) / float2(constants.outputSize) - 0.5;
+    float2 fp = floor(pp);
+    pp -= fp;
+    int2 p = int2(fp);
+
+    // Taps around the output pixel, which lies between f, g, j and k:
+    //     b c
+    //   e f g h
+    //   i j k l
+    //     n o
+    float3 b = loadSource(p + int2(0, -1), size);
+    float3 c = loadSource(p + int2(1, -1), size);
+    float3 e = loadSource(p + int2(-1, 0), size);
+    float3 f = loadSource(p + int2(0, 0), size);
+    float3 g = loadSource(p + int2(1, 0), size);
+    float3 h = loadSource(p + int2(2, 0), size);
+    float3 i = loadSource(p + int2(-1, 1), size);
+    float3 j = loadSource(p + int2(0, 1), size);
+    float3 k = loadSource(p + int2(1, 1), size);
+    float3 l = loadSource(p + int2(2, 1), size);
+    float3 n = loadSource(p + int2(0, 2), size);
+    float3 o = loadSource(p + int2(1, 2), size);
+
+    float bL = upscaleLuma(b);
+    float cL = upscaleLuma(c);
+    float eL = upscaleLuma(e);
+    float fL = upscaleLuma(f);
+    float gL = upscaleLuma(g);
+    float hL = upscaleLuma(h);
+    float iL = upscaleLuma(i);
+    float jL = upscaleLuma(j);
+    float kL = upscaleLuma(k);
+    float lL = upscaleLuma(l);
+    float nL = upscaleLuma(n);
+    float oL = upscaleLuma(o);
+
+    float2 dir = float2(0.0, 0.0);
+    float len = 0.0;
+    easuSetDirection(dir, len, (1.0 - pp.x) * (1.0 - pp.y), bL, eL, fL, gL, jL);
+    easuSetDirection(dir, len, pp.x * (1.0 - pp.y), cL, fL, gL, hL, kL);
+    easuSetDirection(dir, len, (1.0 - pp.x) * pp.y, fL, iL, jL, kL, nL);
+    easuSetDirection(dir, len, pp.x * pp.y, gL, jL, kL, lL, oL);
+
+    // flat areas have no direction, any one will do
+    float dirLength2 = dot(dir, dir);
+    dir = dirLength2 < 1.0 / 32768.0 ? float2(1.0, 0.0) : dir * rsqrt(dirLength2);
+
+    // len goes from 0 on flat areas to 1 on strong edges: the kernel gets stretched along the edge,
+    // narrowed across it and its negative lobe deepened for a sharper edge
+    len *= 0.5;
+    len *= len;
+    float stretch = 1.0 / max(abs(dir.x), abs(dir.y));
+    float2 len2 = float2(1.0 + (stretch - 1.0) * len, 1.0 - 0.5 * len);
+    float lobe = 0.5 + (1.0 / 4.0 - 0.04 - 0.5) * len;
+    float clip = 1.0 / lobe;
+
+    float3 colour = float3(0.0, 0.0, 0.0);
+    float weight = 0.0;
+    easuTap(colour, weight, float2(0.0, -1.0) - pp, dir, len2, lobe, clip, b);
+    easuTap(colour, weight, float2(1.0, -1.0) - pp, dir, len2, lobe, clip, c);
+    easuTap(colour, weight, float2(-1.0, 1.0) - pp, dir, len2, lobe, clip, i);
+    easuTap(colour, weight, float2(0.0, 1.0) - pp, dir, len2, lobe, clip, j);
+    easuTap(colour, weight, float2(0.0, 0.0) - pp, dir, len2, lobe, clip, f);
+    easuTap(colour, weight, float2(-1.0, 0.0) - pp, dir, len2, lobe, clip, e);
+    easuTap(colour, weight, float2(1.0, 1.0) - pp, dir, len2, lobe, clip, k);
+    easuTap(colour, weight, float2(2.0, 1.0) - pp, dir, len2, lobe, clip, l);
+    easuTap(colour, weight, float2(2.0, 0.0) - pp, dir, len2, lobe, clip, h);
+    easuTap(colour, weight, float2(1.0, 0.0) - pp, dir, len2, lobe, clip, g);
+    easuTap(colour, weight, float2(1.0, 2.0) - pp, dir, len2, lobe, clip, o);
+    easuTap(colour, weight, float2(0.0, 2.0) - pp, dir, len2, lobe, clip, n);
+
+    // de-ringing
+    float3 minColour = min(min(f, g), min(j, k));
+    float3 maxColour = max(max(f, g), max(j, k));
+    target[tid.xy] = float4(clamp(colour / weight, minColour, maxColour), 1.0);
+}
@@ -0,0 +1,53 @@
+#include "upscale.fxh"
+
+// Robust contrast-adaptive sharpening after AMD FidelityFX Super Resolution 1 (RCAS), run on the EASU output:
+// a 5-tap cross with a negative lobe as strong as it can be without pushing any channel out of [0, 1].
+// The input is the unbounded HDR lighting output, where the [0, 1] limit would turn the lobe off on every pixel
+// brighter than 1, so the taps are sharpened in a reversibly tonemapped space and mapped back afterwards.
+
+// Strongest lobe allowed at full sharpness
+#define RCAS_LIMIT (0.25 - 1.0 / 16.0)
+
+// Maps [0, inf) to [0, 1) by the brightest channel, keeping the hue; rcasUntonemap() undoes it
+float3 rcasTonemap(float3 colour)
+{
+    return colour / (1.0 + max(colour.r, max(colour.g, colour.b)));
+}
+
+float3 rcasUntonemap(float3 colour)
+{
+    return colour / max(1.0 - max(colour.r, max(colour.g, colour.b)), 1.0 / 65536.0);
+}
+
+[numthreads(UPSCALE_GROUP_SIZE, UPSCALE_GROUP_SIZE, 1)]
+void main(uint3 tid : SV_DispatchThreadID)
+{
+    if (any(tid.xy >= constants.outputSize))
+    {
+        return;
+    }
+
+    uint2 size = constants.outputSize;
+    int2 p = int2(tid.xy);
+
+    //     b
+    //   d e f
+    //     h
+    float3 b = rcasTonemap(loadSource(p + int2(0, -1), size));
+    float3 d = rcasTonemap(loadSource(p + int2(-1, 0), size));
+    float3 e = rcasTonemap(loadSource(p, size));
+    float3 f = rcasTonemap(loadSource(p + int2(1, 0), size));
+    float3 h = rcasTonemap(loadSource(p + int2(0, 1), size));
+
+    float3 minRing = min(min(b, d), min(f, h));
+    float3 maxRing = max(max(b, d), max(f, h));
+
+    // the lobes at which the result would clip at 0 and at 1, per channel
+    float3 hitMin = min(minRing, e) / max(4.0 * maxRing, 1.0 / 65536.0);
+    float3 hitMax = (1.0 - max(maxRing, e)) / min(4.0 * minRing - 4.0, -1.0 / 65536.0);
+    float3 lobeRGB = max(-hitMin, hitMax);
+    float lobe = max(-RCAS_LIMIT, min(max(lobeRGB.r, max(lobeRGB.g, lobeRGB.b)), 0.0)) * constants.sharpness;
+
+    float3 colour = (lobe * (b + d + f + h) + e) / (4.0 * lobe + 1.0);
+    target[tid.xy] = float4(rcasUntonemap(colour), 1.0);
+}
@@ -0,0 +1,70 @@
+#include "ShadowCascades.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+using Gfx::ShadowCascades;
+
+ShadowCascades::ShadowCascades(uint32_t cascadeCount, uint32_t resolution, float casterDistance, float splitLambda) :
+    m_resolution(resolution),
+    m_casterDistance(casterDistance),
+    m_splitLambda(splitLambda),
+    m_cascades(cascadeCount)
+{
+    if (cascadeCount == 0 || resolution == 0 || casterDistance < 0.0f || splitLambda < 0.0f || splitLambda > 1.0f) {
+        throw std::runtime_error("invalid shadow cascade settings!");
+    }
+}
+
+void ShadowCascades::update(const glm::mat4& cameraView, float fovY, float aspect, float nearPlane, float farPlane, const glm::vec3& lightDirection)
+{
+    auto inverseView = glm::inverse(cameraView);
+
+    // squared distance of a frustum corner from the view axis, per unit of view depth
+    float tanY = std::tan(0.5f * fovY);
+    float tanX = tanY * aspect;
+    float cornerSlope2 = tanX * tanX + tanY * tanY;
+
+    // the light's own basis, which stays put while the camera moves, so snapping in it keeps texels in place
+    auto up = std::abs(lightDirection.z) > 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+    auto lightView = glm::lookAtRH(glm::vec3(0.0f), -lightDirection, up);
+
+    // clip space y points down in Vulkan
+    auto flipY = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f));
+
+    float sliceNear = nearPlane;
+    for (size_t i = 0; i < m_cascades.size(); i++) {
+        float fraction = static_cast<float>(i + 1) / static_cast<float>(m_cascades.size());
+        float logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+        float uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+        float sliceFar = m_splitLambda * logSplit + (1.0f - m_splitLambda) * uniformSplit;
+
+        // the sphere through the corners at both ends of the slice is centred on the view axis; past the far
+        // end, wide slices are bounded best by the sphere around the far corners alone
+        float centreDepth = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + cornerSlope2), sliceFar);
+        float radius = std::sqrt((sliceFar - centreDepth) * (sliceFar - centreDepth) + sliceFar * sliceFar * cornerSlope2);
+
+        auto centre = glm::vec3(lightView * inverseView * glm::vec4(0.0f, 0.0f, -centreDepth, 1.0f));
+
+        float texelSize = 2.0f * radius / static_cast<float>(m_resolution);
+        centre.x = std::floor(centre.x / texelSize) * texelSize;
+        centre.y = std::floor(centre.y / texelSize) * texelSize;
+
+        // the light looks down -z, so distances along its direction are -z
+        float zNear = -centre.z - radius - m_casterDistance;
+        float zFar = -centre.z + radius;
+        auto proj = glm::orthoRH_ZO(centre.x - radius, centre.x + radius, centre.y - radius, centre.y + radius, zNear, zFar);
+
+        auto& cascade = m_cascades[i];
+        cascade.viewProj = flipY * proj * lightView;
+        cascade.splitDistance = sliceFar;
+        cascade.depthRange = zFar - zNear;
+        cascade.texelSize = texelSize;
+
+        sliceNear = sliceFar;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+
+#include <glm/glm.hpp>
+
+namespace Gfx
+{
+	struct ShadowCascade
+	{
+		glm::mat4 viewProj{ 1.0f }; // world space to the cascade's clip space, Vulkan depth range and y down
+		float splitDistance = 0.0f; // view-space distance from the camera the cascade covers up to
+		float depthRange = 0.0f; // world units between its near and far plane
+		float texelSize = 0.0f; // world units per shadow map texel
+	};
+
+	// Fits the cascades of a directional light's shadow map to the camera frustum.
+	//
+	// - The frustum is split between a logarithmic and a uniform distribution (the "practical" split scheme),
+	//   splitLambda weighing the logarithmic one
+	// - Every cascade is an orthographic projection around the bounding sphere of its slice of the frustum.
+	//   The sphere doesn't change as the camera turns, so neither does the cascade size.
+	// - The cascade centre is snapped to whole texels in light space, so shadow edges don't crawl as the camera moves
+	// - The near plane is pulled casterDistance towards the light, so casters outside a slice still shadow it
+	class ShadowCascades
+	{
+	public:
+		ShadowCascades(uint32_t cascadeCount, uint32_t resolution, float casterDistance, float splitLambda = 0.75f);
+		ShadowCascades(const ShadowCascades&) = delete;
+
+		// fovY is the vertical field of view in radians, lightDirection points towards the light
+		void update(const glm::mat4& cameraView, float fovY, float aspect, float nearPlane, float farPlane, const glm::vec3& lightDirection);
+
+		const std::vector<ShadowCascade>& getCascades() const { return m_cascades; }
+		uint32_t getResolution() const { return m_resolution; }
+
+	private:
+		uint32_t m_resolution;
+		float m_casterDistance;
+		float m_splitLambda;
+
+		std::vector<ShadowCascade> m_cascades{};
+	};
+}
@@ -1,10 +1,18 @@
-﻿#include <cstdlib>
+﻿#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <random>
+#include <sstream>
 #include <stdexcept>
 #include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -22,24 +30,189 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <tiny_gltf.h>
 
+#include "Benchmark.hpp"
 #include "Buffer.hpp"
 #include "DescriptorSet.hpp"
+#include "DynamicResolution.hpp"
+#include "FramePacer.hpp"
+#include "GoldenImageTest.hpp"
+#include "GpuParticleSystem.hpp"
 #include "Image.hpp"
+#include "ImageSequenceWriter.hpp"
 #include "Pipeline.hpp"
+#include "ReadbackRing.hpp"
 #include "RenderGraph.hpp"
 #include "RHI.hpp"
+#include "RHIBenchmark.hpp"
+#include "ShaderCompiler.hpp"
+#include "ShadowCascades.hpp"
+#include "SpatialUpscaler.hpp"
 
 #undef max
 
 const float PI = 3.14159265358979323846f;
 
-const uint32_t WIDTH = 800;
-const uint32_t HEIGHT = 600;
+// Whether the G-buffer pass gets a depth prepass, see Options::depthPrepass
+enum class DepthPrepassMode
+{
+    Off,
+    On,
+    Auto,
+};
+
+// Scene scale and run settings, see parseOptions() for the command line
+struct Options
+{
+    uint32_t width = 800;
+    uint32_t height = 600;
+    bool headless = false; // hidden window, the swapchain is still presented
+
+    // Scene scale
+    glm::uvec3 particleGrid{ 3, 3, 3 }; // one particle light per grid cell
+    uint32_t modelInstances = 1;
+    uint32_t particleTextureSize = 1; // every particle gets its own white texture of this size
+    uint32_t gpuParticles = 0; // pool size of the GPU particle fountain, 0 disables it
+
+    // Half-precision (USE_FP16) permutations of the lighting, cloud and postproc shaders, where the device has shaderFloat16
+    bool fp16 = true;
+
+    // Scalarized light loop (USE_WAVE_OPS) in the lighting shader, where fragment shaders have wave intrinsics.
+    // Off by default: every pixel loops over all lights, so the plain loop index is wave-uniform already and the
+    // scalarized walk only adds wave operations per light until lights are binned per tile or cluster.
+    bool waveOps = false;
+
+    // The scene renders at renderScale times the window size per axis; below 1 the frame is upscaled to the
+    // window with Gfx::SpatialUpscaler before postprocessing
+    float renderScale = 1.0f;
+
+    // Dynamic resolution: with a target GPU frame time the render scale follows the GPU load between
+    // minRenderScale and renderScale, see Gfx::DynamicResolution
+    double targetGpuMilliseconds = 0.0; // 0 keeps the render scale fixed
+    std::optional<float> minRenderScale{}; // 0.5, or renderScale if that is lower, when not given
+
+    bool isDynamicResolution() const { return targetGpuMilliseconds > 0.0; }
+
+    // The rain postprocess is drawn additively at the end of the lighting pass, straight into the swapchain
+    // image, instead of a postproc pass reading the lit scene back from an intermediate image.
+    // Only at the full render scale, the upscaler needs the intermediate image.
+    bool fusedPostproc = false;
+
+    // A depth-only prepass over the G-buffer draws, from a position-only vertex stream, after which the G-buffer
+    // pass tests EQUAL without writing depth and shades every pixel once. Auto turns it on if the G-buffer
+    // pass measures more overdraw than DEPTH_PREPASS_OVERDRAW; benchmark, golden image and sequence modes resolve
+    // it to Off, so all their frames render the same way.
+    DepthPrepassMode depthPrepass = DepthPrepassMode::Auto;
+
+    // Cascaded shadow maps: shadowCascades layers of shadowResolution squared texels, whatever the window size
+    uint32_t shadowCascades = 4;
+    uint32_t shadowResolution = 1024;
+
+    // Determinism: a fixed seed places the same particles, a fixed timestep shows the same frames
+    std::optional<uint32_t> seed;
+    double timestep = 0.0; // simulated seconds per frame, 0 follows the wall clock
+
+    // Benchmark mode renders warmupFrames + measuredFrames frames, then writes the report and exits
+    bool benchmark = false;
+    uint32_t warmupFrames = 100;
+    uint32_t measuredFrames = 500;
+    std::string reportPath = "benchmark.json";
+
+    // Runs the RHI microbenchmarks instead of rendering, see Gfx::RHIBenchmark
+    bool rhiBenchmark = false;
+
+    // Golden image mode renders goldenTimes and compares them with the references in goldenDirectory,
+    // see Gfx::GoldenImageTest; goldenUpdate rewrites the references instead
+    std::string goldenDirectory;
+    bool goldenUpdate = false;
+    std::vector<double> goldenTimes{ 0.0, 2.0, 5.0 };
+
+    // Sequence mode renders sequenceFrames frames along cameraPath as fast as possible (no vsync) and writes
+    // them to sequenceDirectory as PNGs, see Gfx::ImageSequenceWriter
+    std::string sequenceDirectory;
+    std::string cameraPath; // JSON keyframes, see loadCameraPath(); the default camera without one
+    std::optional<uint32_t> sequenceFrames; // defaults to the length of the camera path
+    uint32_t writerThreads = 0; // 0 picks half the hardware threads
+
+    // On-demand mode only draws a frame when something changed: input, a finished pipeline build, a pending
+    // readback, or time while animated passes run. Animation starts paused, P toggles it.
+    bool onDemand = false;
+
+    // Interactive frame rate cap (0 = uncapped) and how often to log frame pacing (0 = only at exit)
+    double maxFps = 0.0;
+    double pacingLogSeconds = 0.0;
+
+    // Writes a device memory snapshot (per heap, per category, driver budget) as one JSON line per frame
+    std::string memoryLogPath;
+
+    bool isGoldenTest() const { return !goldenDirectory.empty(); }
+    bool isSequence() const { return !sequenceDirectory.empty(); }
+    bool capturesFrames() const { return isGoldenTest() || isSequence(); }
+};
+
+// Frames rendered after the golden images to get stable pass GPU times for the budgets
+const uint32_t GOLDEN_BUDGET_FRAMES = 120;
+
+// Sequence length without a camera path or --sequence-frames
+const uint32_t DEFAULT_SEQUENCE_FRAMES = 240;
+
+// How often an idle on-demand loop wakes up to look for work finished off the render thread (pipeline builds)
+const double ON_DEMAND_WAIT_SECONDS = 0.1;
+
+// Auto depth prepass: G-buffer fragment shader invocations per rendered pixel, averaged over a window of frames,
+// above which the prepass saves more fragment work than its extra vertex work costs
+const double DEPTH_PREPASS_OVERDRAW = 1.5;
+const uint32_t DEPTH_PREPASS_SAMPLE_FRAMES = 30;
+
+// Camera projection, the shadow cascades are fitted to it
+const float CAMERA_FOV_Y = 45.0f * PI / 180.0f;
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 10.0f;
+
+// Matches MAX_SHADOW_CASCADES in Shaders/common.fxh
+const uint32_t MAX_SHADOW_CASCADES = 4;
+
+// World units the shadow cascades reach towards the light beyond the camera frustum, for casters outside it
+const float SHADOW_CASTER_DISTANCE = 10.0f;
+
+// Shadow depth bias in world units, a constant part plus a part per shadow map texel of the cascade
+const float SHADOW_DEPTH_BIAS = 0.02f;
+const float SHADOW_TEXEL_BIAS = 1.5f;
+
+// Ray-march quality tiers for cloud.frag, baked in through specialization constants
+struct CloudQuality
+{
+    int32_t maxSteps;
+    int32_t lightSteps;
+    float stepSize;
+};
+
+const CloudQuality CLOUD_QUALITY_LOW{ 48, 3, 5.0f };
+const CloudQuality CLOUD_QUALITY_HIGH{ 100, 6, 2.5f };
+
+// Cull and depth state is set while recording in the scene pipelines, so passes that only differ in it can share one
+const std::vector<vk::DynamicState> SCENE_DYNAMIC_STATES = {
+    vk::DynamicState::eCullMode,
+    vk::DynamicState::eDepthTestEnable,
+    vk::DynamicState::eDepthWriteEnable,
+    vk::DynamicState::eDepthCompareOp,
+};
+
+const Gfx::GraphicsState OPAQUE_STATE{};
+
+// for passes that test against a depth buffer bound in a read-only layout
+const Gfx::GraphicsState DEPTH_READ_ONLY_STATE = [] {
+    Gfx::GraphicsState state{};
+    state.depthWriteEnable = false;
+    return state;
+}();
 
-const uint32_t PARTICLE_GRID_X = 3;
-const uint32_t PARTICLE_GRID_Y = 3;
-const uint32_t PARTICLE_GRID_Z = 3;
-const uint32_t PARTICLE_COUNT = PARTICLE_GRID_X * PARTICLE_GRID_Y * PARTICLE_GRID_Z;
+// for the G-buffer pass after the depth prepass, which already wrote the nearest depth of every pixel
+const Gfx::GraphicsState DEPTH_EQUAL_STATE = [] {
+    Gfx::GraphicsState state{};
+    state.depthWriteEnable = false;
+    state.depthCompareOp = vk::CompareOp::eEqual;
+    return state;
+}();
 
 struct Vertex
 {
@@ -82,25 +255,107 @@ struct UniformBufferObject
 {
     glm::mat4 view;
     glm::mat4 proj;
-    glm::mat4 lightView;
-    glm::mat4 lightProj;
+    glm::mat4 cascadeViewProj[MAX_SHADOW_CASCADES];
 	glm::quat rotation;
     glm::vec4 nLightDir;
+    glm::vec4 cascadeSplits; // view-space distance every cascade reaches
+    glm::vec4 cascadeDepthBias; // in the depth units of every cascade
     uint32_t particleCount;
 	float time;
     glm::uvec2 res;
+    uint32_t cascadeCount;
 };
 
+struct Camera
+{
+    glm::vec3 position{ 2.0f, 2.0f, 2.0f };
+    glm::vec3 target{ 0.0f, 0.0f, 0.0f };
+};
+
+// The camera moves linearly between keyframes, and holds still before the first and after the last one
+struct CameraKeyframe
+{
+    double time; // simulation time in seconds
+    Camera camera;
+};
+
+// { "keyframes": [ { "time": 0.0, "position": [ 2, 2, 2 ], "target": [ 0, 0, 0 ] }, ... ] }
+static std::vector<CameraKeyframe> loadCameraPath(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open camera path " + path + "!");
+    }
+
+    auto toVec3 = [](const nlohmann::json& value) {
+        return glm::vec3(value.at(0).get<float>(), value.at(1).get<float>(), value.at(2).get<float>());
+    };
+
+    std::vector<CameraKeyframe> keyframes{};
+    for (const auto& keyframe : nlohmann::json::parse(file).at("keyframes")) {
+        keyframes.push_back({ keyframe.at("time").get<double>(), { toVec3(keyframe.at("position")), toVec3(keyframe.at("target")) } });
+
+        if (keyframes.size() > 1 && keyframes.back().time <= keyframes[keyframes.size() - 2].time) {
+            throw std::runtime_error("camera path keyframes in " + path + " must be in increasing time order!");
+        }
+    }
+
+    if (keyframes.empty()) {
+        throw std::runtime_error("camera path " + path + " has no keyframes!");
+    }
+
+    return keyframes;
+}
+
+static Camera sampleCameraPath(const std::vector<CameraKeyframe>& keyframes, double time) {
+    if (keyframes.empty()) {
+        return Camera{};
+    }
+
+    for (size_t i = 0; i < keyframes.size(); i++) {
+        if (time < keyframes[i].time) {
+            if (i == 0) {
+                return keyframes.front().camera;
+            }
+
+            const auto& from = keyframes[i - 1];
+            const auto& to = keyframes[i];
+            auto t = static_cast<float>((time - from.time) / (to.time - from.time));
+            return { glm::mix(from.camera.position, to.camera.position, t), glm::mix(from.camera.target, to.camera.target, t) };
+        }
+    }
+
+    return keyframes.back().camera;
+}
+
 class HelloTriangleApplication {
 public:
+    explicit HelloTriangleApplication(const Options& options) :
+        options(options),
+        particleCount(options.particleGrid.x * options.particleGrid.y * options.particleGrid.z),
+        animationPaused(options.onDemand)
+    {
+    }
+
     void run() {
         initWindow();
+        if (options.rhiBenchmark) {
+            runRHIBenchmark();
+            cleanup();
+            return;
+        }
         initVulkan();
         mainLoop();
         cleanup();
+
+        if (!testPassed) {
+            throw std::runtime_error("golden image test failed!");
+        }
     }
 
 private:
+    Options options;
+    uint32_t particleCount;
+
     GLFWwindow* window = nullptr;
 
     Gfx::RHI rhi{};
@@ -114,8 +369,11 @@ private:
 
     Gfx::Pipeline particlePipeline = nullptr;
     Gfx::Pipeline shadowPipeline = nullptr;
+    Gfx::Pipeline depthPrepassPipeline = nullptr;
     Gfx::Pipeline gbufferPipeline = nullptr;
     Gfx::Pipeline cloudPipeline = nullptr;
+    Gfx::Pipeline cloudPipelineStandby = nullptr; // the other cloud quality, see toggleCloudQuality()
+    bool cloudStandbyRequested = false;
     Gfx::Pipeline lightingPipeline = nullptr;
     Gfx::Pipeline postprocPipeline = nullptr;
     std::vector<Gfx::Image> textureImages{};
@@ -125,44 +383,130 @@ private:
     std::vector<Gfx::Image> gbufferPositionImages{};
     std::vector<Gfx::Image> gbufferInstanceIDImages{};
     vk::raii::Sampler gbufferSampler = nullptr;
-    std::vector<Gfx::Image> shadowImages{};
+    std::vector<Gfx::Image> shadowImages{}; // one layer per cascade
+    std::unique_ptr<Gfx::ShadowCascades> shadowCascades{};
+    vk::Format shadowFormat = vk::Format::eUndefined;
     vk::raii::Sampler shadowSampler = nullptr;
     std::vector<Gfx::Image> postprocImages{};
     vk::raii::Sampler postprocSampler = nullptr;
     Gfx::Buffer vertexBuffer = nullptr;
+    Gfx::Buffer positionBuffer = nullptr; // vertex positions alone, for the depth prepass
     Gfx::Buffer indexBuffer = nullptr;
     Gfx::Buffer indirectBuffer = nullptr;
     Gfx::Buffer storageBuffer = nullptr;
     std::vector<Gfx::Buffer> uniformBuffers{};
     std::vector<Gfx::DescriptorSet> computeDescriptorSets{};
     std::vector<Gfx::DescriptorSet> shadowDescriptorSets{};
+    std::vector<Gfx::DescriptorSet> depthPrepassDescriptorSets{};
     std::vector<Gfx::DescriptorSet> gbufferDescriptorSets{};
     std::vector<Gfx::DescriptorSet> cloudDescriptorSets{};
     std::vector<Gfx::DescriptorSet> lightingDescriptorSets{};
     std::vector<Gfx::DescriptorSet> postprocDescriptorSets{};
+    std::unique_ptr<Gfx::GpuParticleSystem> gpuParticles{};
+    std::unique_ptr<Gfx::SpatialUpscaler> upscaler{}; // only below a render scale of 1 or with dynamic resolution
+    std::unique_ptr<Gfx::DynamicResolution> dynamicResolution{};
+    float renderScale = 1.0f; // of the frame being recorded
+    bool depthPrepassEnabled = false; // for the frame being recorded, see updateDepthPrepass()
+    bool depthPrepassDecided = false; // Auto has measured its window, depthPrepassEnabled stays as it is
+    double overdrawSum = 0.0; // G-buffer overdraw of the frames measured so far
+    uint32_t overdrawFrames = 0;
+    uint64_t nextOverdrawFrame = 0; // frames before it have been measured
+
+    CloudQuality cloudQuality = CLOUD_QUALITY_HIGH;
+
+    uint64_t frameCount = 0;
+    uint64_t animatedFrameCount = 0; // frames drawn while the animation was running
+    double simulationTime = 0.0; // seconds, drives every animation through ubo.time
+    double gpuParticleTime = 0.0; // simulationTime the GPU particles were last updated to
+    glm::mat4 cameraView{ 1.0f };
+    glm::mat4 cameraProj{ 1.0f };
+    std::chrono::steady_clock::time_point startTime{};
+
+    std::ofstream memoryLog{};
+
+    bool animationPaused = false;
+    bool frameDirty = true; // something changed that the next on-demand frame has to show
+
+    std::vector<CameraKeyframe> cameraPath{};
+
+    Gfx::ReadbackRing::Callback captureCallback{}; // reads back the frame being recorded, consumed by the capture pass
+    std::vector<uint8_t> capturedFrame{};
+    bool testPassed = true;
 
     void initWindow() {
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
         glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_VISIBLE, options.headless ? GLFW_FALSE : GLFW_TRUE);
+
+        window = glfwCreateWindow(options.width, options.height, "Vulkan Renderer", nullptr, nullptr);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+    }
+
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+
+        if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+            app->toggleCloudQuality();
+        }
+        if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+            app->toggleAnimation();
+        }
+
+        app->frameDirty = true;
+    }
+
+    // the window was uncovered or restored, its contents have to be drawn again
+    static void windowRefreshCallback(GLFWwindow* window) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        app->frameDirty = true;
+    }
+
+    void toggleAnimation() {
+        animationPaused = !animationPaused;
 
-        window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Renderer", nullptr, nullptr);
+        // resume where the animation stopped instead of jumping ahead by the paused time
+        startTime = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(simulationTime));
     }
 
     void initVulkan() {
-		rhi.init("Vulkan Renderer", getRequiredExtensions(), glfwGetWin32Window(window));
+		rhi.init("Vulkan Renderer", getRequiredExtensions(), glfwGetWin32Window(window), !options.isSequence());
+
+        if (!options.cameraPath.empty()) {
+            cameraPath = loadCameraPath(options.cameraPath);
+        }
+        if (!options.memoryLogPath.empty()) {
+            memoryLog.open(options.memoryLogPath);
+            if (!memoryLog.is_open()) {
+                throw std::runtime_error("failed to open memory log " + options.memoryLogPath + "!");
+            }
+        }
 
 		loadParticles();
         loadFloor();
         loadModel();
 
+        precompileShaders();
 		createParticlePipeline();
+        createShadowCascades();
         createShadowPipeline();
         createGBufferPipeline();
+        if (options.depthPrepass != DepthPrepassMode::Off) {
+            createDepthPrepassPipeline();
+        }
         createCloudPipeline();
         createLightingPipeline();
         createPostprocPipeline();
+        if (options.gpuParticles > 0) {
+            gpuParticles = std::make_unique<Gfx::GpuParticleSystem>(rhi, options.gpuParticles, rhi.getSurfaceFormat(), rhi.getDepthFormat());
+        }
+        printPipelineCreationReport();
+        if (!options.benchmark && !options.capturesFrames()) {
+            rhi.enableShaderHotReload(); // a rebuild in the middle of a run would skew the results
+        }
 		createTextureResources();
 		createShadowResources();
 		createGBufferResources();
@@ -173,6 +517,9 @@ private:
         createUniformBuffers();
         createStorageBuffer();
         createDescriptorSets();
+        if (options.capturesFrames()) {
+            checkCaptureSupport();
+        }
 
         initRenderGraph();
     }
@@ -183,22 +530,100 @@ private:
         return std::vector<const char*>(glfwExtensions, glfwExtensions + glfwExtensionCount);
     }
 
-    void createParticlePipeline() {
+    // Compiles every Shaders/<name>.<stage>.hlsl missing from the shader cache in parallel,
+    // so pipeline creation below only loads cached SPIR-V
+    void precompileShaders() {
+        const std::pair<const char*, vk::ShaderStageFlagBits> stages[] = {
+            { ".vert", vk::ShaderStageFlagBits::eVertex },
+            { ".frag", vk::ShaderStageFlagBits::eFragment },
+            { ".comp", vk::ShaderStageFlagBits::eCompute },
+        };
+
+        std::vector<Gfx::ShaderDesc> shaders{};
+        for (const auto& entry : std::filesystem::directory_iterator("Shaders")) {
+            if (entry.path().extension() != ".hlsl") {
+                continue;
+            }
+            auto stageExtension = entry.path().stem().extension();
+            for (const auto& [extension, stage] : stages) {
+                if (stageExtension == extension) {
+                    shaders.push_back({ entry.path().generic_string(), stage });
+                }
+            }
+        }
+
+        // the permutations that will be used
+        const std::pair<const char*, std::vector<std::string>> permutations[] = {
+            { "Shaders/lighting.frag.hlsl", getLightingDefines() },
+            { "Shaders/cloud.frag.hlsl", getPrecisionDefines() },
+            { "Shaders/postproc.frag.hlsl", getPostprocDefines() },
+        };
+        for (const auto& [path, defines] : permutations) {
+            if (!defines.empty()) {
+                shaders.push_back({ path, vk::ShaderStageFlagBits::eFragment, defines });
+            }
+        }
+
+        rhi.getShaderCompiler().precompile(shaders);
+    }
+
+    // Permutation defines of the shaders with half-precision math, see real in Shaders/common.fxh
+    std::vector<std::string> getPrecisionDefines() const {
+        if (options.fp16 && rhi.isShaderFloat16Supported()) {
+            return { "USE_FP16=1" };
+        }
+        return {};
+    }
+
+    bool isLightLoopScalarized() const {
+        // WaveActiveAnyTrue, WaveActiveMin and WaveReadLaneFirst
+        auto operations = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eVote | vk::SubgroupFeatureFlagBits::eArithmetic | vk::SubgroupFeatureFlagBits::eBallot;
+        return options.waveOps && rhi.isWaveOpsSupported(vk::ShaderStageFlagBits::eFragment, operations);
+    }
+
+    // Plus the additive-only permutation when the postprocess is fused into the lighting pass
+    std::vector<std::string> getPostprocDefines() const {
+        auto defines = getPrecisionDefines();
+        if (options.fusedPostproc) {
+            defines.push_back("FUSED_POSTPROC=1");
+        }
+        return defines;
+    }
+
+    // Plus the scalarized light loop where fragment shaders have wave intrinsics
+    std::vector<std::string> getLightingDefines() const {
+        auto defines = getPrecisionDefines();
+        if (isLightLoopScalarized()) {
+            defines.push_back("USE_WAVE_OPS=1");
+        }
+        return defines;
+    }
+
+    Gfx::ComputePipelineCreateInfo getParticlePipelineCreateInfo() {
         Gfx::ComputePipelineCreateInfo pipelineCreateInfo{};
-        pipelineCreateInfo.shader = { "Shaders/particle.comp.spv", vk::ShaderStageFlagBits::eCompute };
+        pipelineCreateInfo.name = "particle";
+        pipelineCreateInfo.shader = { "Shaders/particle.comp.hlsl", vk::ShaderStageFlagBits::eCompute };
+        pipelineCreateInfo.shader.setConstant(0, particleCount);
         pipelineCreateInfo.descriptorSetLayoutBindings = {
             { 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
             { 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
         };
 
-        particlePipeline = rhi.createComputePipeline(pipelineCreateInfo);
+        return pipelineCreateInfo;
+    }
+
+    void createParticlePipeline() {
+        particlePipeline = rhi.createComputePipeline(getParticlePipelineCreateInfo());
     }
 
     void createShadowPipeline() {
         Gfx::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+        pipelineCreateInfo.name = "shadow";
+        pipelineCreateInfo.state = OPAQUE_STATE;
+        pipelineCreateInfo.dynamicStates = SCENE_DYNAMIC_STATES;
         pipelineCreateInfo.shaders = {
-            { "Shaders/shadow.vert.spv", vk::ShaderStageFlagBits::eVertex },
-            { "Shaders/shadow.frag.spv", vk::ShaderStageFlagBits::eFragment },
+            { "Shaders/shadow.vert.hlsl", vk::ShaderStageFlagBits::eVertex },
+            { "Shaders/shadow.frag.hlsl", vk::ShaderStageFlagBits::eFragment },
         };
         pipelineCreateInfo.vertexInputBindings = { Vertex::getBindingDescription() };
         pipelineCreateInfo.vertexInputAttributes = Vertex::getAttributeDescriptions();
@@ -206,16 +631,20 @@ private:
             { 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
             { 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
         };
-        pipelineCreateInfo.depthAttachment = { rhi.getDepthFormat() };
+        pipelineCreateInfo.depthAttachment = { shadowFormat };
+        pipelineCreateInfo.viewMask = getShadowViewMask(); // one view per cascade
 
         shadowPipeline = rhi.createGraphicsPipeline(pipelineCreateInfo);
     }
 
     void createGBufferPipeline() {
         Gfx::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+        pipelineCreateInfo.name = "gbuffer";
+        pipelineCreateInfo.state = OPAQUE_STATE;
+        pipelineCreateInfo.dynamicStates = SCENE_DYNAMIC_STATES;
         pipelineCreateInfo.shaders = {
-            { "Shaders/gbuffer.vert.spv", vk::ShaderStageFlagBits::eVertex },
-            { "Shaders/gbuffer.frag.spv", vk::ShaderStageFlagBits::eFragment },
+            { "Shaders/gbuffer.vert.hlsl", vk::ShaderStageFlagBits::eVertex },
+            { "Shaders/gbuffer.frag.hlsl", vk::ShaderStageFlagBits::eFragment },
         };
         pipelineCreateInfo.vertexInputBindings = { Vertex::getBindingDescription() };
         pipelineCreateInfo.vertexInputAttributes = Vertex::getAttributeDescriptions();
@@ -235,25 +664,78 @@ private:
         gbufferPipeline = rhi.createGraphicsPipeline(pipelineCreateInfo);
     }
 
-    void createCloudPipeline() {
+    // Depth only, without a fragment shader; the same transform as the G-buffer, from the position stream
+    void createDepthPrepassPipeline() {
         Gfx::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+        pipelineCreateInfo.name = "depth prepass";
+        pipelineCreateInfo.state = OPAQUE_STATE;
+        pipelineCreateInfo.dynamicStates = SCENE_DYNAMIC_STATES;
         pipelineCreateInfo.shaders = {
-            { "Shaders/cloud.vert.spv", vk::ShaderStageFlagBits::eVertex },
-            { "Shaders/cloud.frag.spv", vk::ShaderStageFlagBits::eFragment },
-        }  ;
+            { "Shaders/depth_prepass.vert.hlsl", vk::ShaderStageFlagBits::eVertex },
+        };
+        pipelineCreateInfo.vertexInputBindings = { { 0, static_cast<uint32_t>(3 * sizeof(float)), vk::VertexInputRate::eVertex } };
+        pipelineCreateInfo.vertexInputAttributes = { { 0, 0, vk::Format::eR32G32B32Sfloat, 0 } };
+        pipelineCreateInfo.descriptorSetLayoutBindings = {
+            { 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
+            { 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eVertex, nullptr },
+        };
+        pipelineCreateInfo.depthAttachment = { rhi.getDepthFormat() };
+
+        depthPrepassPipeline = rhi.createGraphicsPipeline(pipelineCreateInfo);
+    }
+
+    Gfx::GraphicsPipelineCreateInfo getCloudPipelineCreateInfo(const CloudQuality& quality) {
+        Gfx::ShaderDesc fragmentShader{ "Shaders/cloud.frag.hlsl", vk::ShaderStageFlagBits::eFragment, getPrecisionDefines() };
+        fragmentShader
+            .setConstant(0, quality.maxSteps)
+            .setConstant(1, quality.lightSteps)
+            .setConstant(2, quality.stepSize);
+
+        Gfx::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+        pipelineCreateInfo.name = quality.maxSteps == CLOUD_QUALITY_LOW.maxSteps ? "cloud (low)" : "cloud (high)";
+        pipelineCreateInfo.shaders = {
+            { "Shaders/cloud.vert.hlsl", vk::ShaderStageFlagBits::eVertex },
+            fragmentShader,
+        };
         pipelineCreateInfo.descriptorSetLayoutBindings = {
             { 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eFragment, nullptr },
         };
         pipelineCreateInfo.colorAttachments = { { rhi.getSurfaceFormat() } };
 
-        cloudPipeline = rhi.createGraphicsPipeline(pipelineCreateInfo);
+        return pipelineCreateInfo;
+    }
+
+    void createCloudPipeline() {
+        cloudPipeline = rhi.createGraphicsPipeline(getCloudPipelineCreateInfo(cloudQuality));
+    }
+
+    // Requests the other cloud quality permutation in the background the first time; the current pipeline
+    // is bound as its fallback until it is ready, so switching never stalls a frame
+    void toggleCloudQuality() {
+        bool lowQuality = cloudQuality.maxSteps != CLOUD_QUALITY_LOW.maxSteps;
+        cloudQuality = lowQuality ? CLOUD_QUALITY_LOW : CLOUD_QUALITY_HIGH;
+
+        if (!cloudStandbyRequested) {
+            cloudPipelineStandby = rhi.requestGraphicsPipeline(getCloudPipelineCreateInfo(cloudQuality), &cloudPipeline);
+            cloudStandbyRequested = true;
+        }
+
+        // both stay alive, frames in flight may still use the one switched away from
+        std::swap(cloudPipeline, cloudPipelineStandby);
     }
 
     void createLightingPipeline() {
+        // particle light count is fixed at load time, so bake it in to unroll the light loop
+        Gfx::ShaderDesc fragmentShader{ "Shaders/lighting.frag.hlsl", vk::ShaderStageFlagBits::eFragment, getLightingDefines() };
+        fragmentShader.setConstant(0, particleCount);
+
         Gfx::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+        pipelineCreateInfo.name = "lighting";
+        pipelineCreateInfo.state = DEPTH_READ_ONLY_STATE;
+        pipelineCreateInfo.dynamicStates = SCENE_DYNAMIC_STATES;
         pipelineCreateInfo.shaders = {
-            { "Shaders/lighting.vert.spv", vk::ShaderStageFlagBits::eVertex },
-            { "Shaders/lighting.frag.spv", vk::ShaderStageFlagBits::eFragment },
+            { "Shaders/lighting.vert.hlsl", vk::ShaderStageFlagBits::eVertex },
+            fragmentShader,
         };
         pipelineCreateInfo.descriptorSetLayoutBindings = {
             { 0, vk::DescriptorType::eUniformBuffer,        1, vk::ShaderStageFlagBits::eFragment, nullptr },
@@ -272,9 +754,10 @@ private:
 
     void createPostprocPipeline() {
         Gfx::GraphicsPipelineCreateInfo pipelineCreateInfo{};
+        pipelineCreateInfo.name = "postproc";
         pipelineCreateInfo.shaders = {
-            { "Shaders/postproc.vert.spv", vk::ShaderStageFlagBits::eVertex },
-            { "Shaders/postproc.frag.spv", vk::ShaderStageFlagBits::eFragment },
+            { "Shaders/postproc.vert.hlsl", vk::ShaderStageFlagBits::eVertex },
+            { "Shaders/postproc.frag.hlsl", vk::ShaderStageFlagBits::eFragment, getPostprocDefines() },
         };
         pipelineCreateInfo.descriptorSetLayoutBindings = {
             { 0, vk::DescriptorType::eUniformBuffer,        1, vk::ShaderStageFlagBits::eFragment, nullptr },
@@ -282,6 +765,17 @@ private:
         };
         pipelineCreateInfo.colorAttachments = { { rhi.getSurfaceFormat() } };
 
+        if (options.fusedPostproc) {
+            // adds the rain on top of what the lighting pass wrote, inside its rendering scope
+            pipelineCreateInfo.name = "postproc (fused)";
+            pipelineCreateInfo.descriptorSetLayoutBindings.resize(1);
+            pipelineCreateInfo.colorAttachments[0].blendEnable = true;
+            pipelineCreateInfo.colorAttachments[0].dstBlendFactor = vk::BlendFactor::eOne;
+            pipelineCreateInfo.depthAttachment = { rhi.getDepthFormat() };
+            pipelineCreateInfo.state.depthTestEnable = false;
+            pipelineCreateInfo.state.depthWriteEnable = false;
+        }
+
         postprocPipeline = rhi.createGraphicsPipeline(pipelineCreateInfo);
     }
 
@@ -354,7 +848,7 @@ private:
 
         vk::DrawIndexedIndirectCommand drawCmd{
             static_cast<uint32_t>(sphereIndices.size()), // index count
-            PARTICLE_COUNT, // instance count
+            particleCount, // instance count
             static_cast<uint32_t>(indices.size()), // first index
             static_cast<int32_t>(vertices.size()), // vertex offset
             static_cast<uint32_t>(instances.size()) // first instance
@@ -365,19 +859,20 @@ private:
         vertices.insert(vertices.end(), sphere.begin(), sphere.end());
         indices.insert(indices.end(), sphereIndices.begin(), sphereIndices.end());
 
-        Texture texture{ { 255, 255, 255, 255 }, 1, 1 }; // white 1x1 texture
+        auto size = static_cast<int>(options.particleTextureSize);
+        Texture texture{ std::vector<uint8_t>(size * size * 4, 255), size, size }; // white texture
 
-		textures.resize(textures.size() + PARTICLE_COUNT, std::move(texture));
+		textures.resize(textures.size() + particleCount, std::move(texture));
 
-        std::mt19937 rng(std::random_device{}());
+        std::mt19937 rng(options.seed ? *options.seed : std::random_device{}());
 
         glm::vec3 center{ -1, 0, 0.5 };
 
-        for (uint32_t i = 0; i < PARTICLE_GRID_X; i++)
+        for (uint32_t i = 0; i < options.particleGrid.x; i++)
         {
-            for (uint32_t j = 0; j < PARTICLE_GRID_Y; j++)
+            for (uint32_t j = 0; j < options.particleGrid.y; j++)
             {
-                for (uint32_t k = 0; k < PARTICLE_GRID_Z; k++)
+                for (uint32_t k = 0; k < options.particleGrid.z; k++)
                 {
                     float f = 0.1f;
 					float x = i * f, y = j * f, z = k * f;
@@ -565,7 +1060,7 @@ private:
             for (auto& primitive : mesh.primitives) {
                 vk::DrawIndexedIndirectCommand drawCmd{
                     0, // index count
-                    1, // instance count
+                    options.modelInstances, // instance count
                     static_cast<uint32_t>(indices.size()), // first index
                     static_cast<int32_t>(vertices.size()), // vertex offset
                     static_cast<uint32_t>(instances.size()) // first instance
@@ -591,13 +1086,25 @@ private:
 
         stbi_image_free(pixels);
 
-		textures.emplace_back(std::move(texture));
+        // textures are indexed by instance, so every copy of the model gets its own
+		textures.resize(textures.size() + options.modelInstances, std::move(texture));
 
-        Instance instance{};
-        instance.model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0, 0.0, -0.5));
-        instance.colour = glm::vec3(1.0f, 1.0f, 1.0f);
+        // extra copies are laid out on a square grid around the original position
+        auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(options.modelInstances))));
+        auto rows = columns == 0 ? 0 : (options.modelInstances + columns - 1) / columns;
+        const float spacing = 0.75f;
 
-        instances.emplace_back(std::move(instance));
+        for (uint32_t i = 0; i < options.modelInstances; i++)
+        {
+            auto x = (static_cast<float>(i % columns) - 0.5f * static_cast<float>(columns - 1)) * spacing;
+            auto y = (static_cast<float>(i / columns) - 0.5f * static_cast<float>(rows - 1)) * spacing;
+
+            Instance instance{};
+            instance.model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, -0.5));
+            instance.colour = glm::vec3(1.0f, 1.0f, 1.0f);
+
+            instances.emplace_back(std::move(instance));
+        }
     }
 
     void createTextureResources() {
@@ -615,7 +1122,7 @@ private:
             imageInfo.extent.width = texture.width;
             imageInfo.extent.height = texture.height;
 
-			auto textureImage = rhi.createImage(imageInfo);
+			auto textureImage = rhi.createImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::Texture);
 
             rhi.updateImage(textureImage, texture.imageData);
             textureImages.emplace_back(std::move(textureImage));
@@ -632,23 +1139,49 @@ private:
         textureSampler = vk::raii::Sampler(rhi.getDevice(), samplerInfo);
     }
 
+    // The cascades are refitted every frame in updateUniformBuffer(), their depth ranges only depend on the
+    // projection though, so the first fit already tells whether 16-bit depth is precise enough
+    void createShadowCascades() {
+        auto limits = rhi.getPhysicalDevice().getProperties().limits;
+        if (options.shadowResolution > limits.maxImageDimension2D) {
+            throw std::runtime_error("shadow resolution " + std::to_string(options.shadowResolution) + " exceeds the device limit of " + std::to_string(limits.maxImageDimension2D) + "!");
+        }
+
+        shadowCascades = std::make_unique<Gfx::ShadowCascades>(options.shadowCascades, options.shadowResolution, SHADOW_CASTER_DISTANCE);
+        shadowCascades->update(glm::mat4(1.0f), CAMERA_FOV_Y, getCameraAspect(), CAMERA_NEAR, CAMERA_FAR, glm::vec3(0.0f, 0.0f, 1.0f));
+
+        // D16 as long as its depth steps over the deepest cascade stay well under the depth bias
+        float maxDepthRange = 0.0f;
+        for (const auto& cascade : shadowCascades->getCascades()) {
+            maxDepthRange = std::max(maxDepthRange, cascade.depthRange);
+        }
+        shadowFormat = maxDepthRange / 65535.0f * 8.0f <= SHADOW_DEPTH_BIAS ? vk::Format::eD16Unorm : rhi.getDepthFormat();
+    }
+
+    uint32_t getShadowViewMask() const {
+        return (1u << options.shadowCascades) - 1;
+    }
+
+    float getCameraAspect() const {
+        auto swapChainExtent = rhi.getSwapChainExtent();
+        return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
+    }
+
     void createShadowResources() {
         shadowImages.reserve(rhi.getMaxFramesInFlight());
 
-        auto extent = rhi.getSwapChainExtent();
-
         vk::ImageCreateInfo imageInfo{};
         imageInfo.imageType = vk::ImageType::e2D;
-		imageInfo.format = rhi.getDepthFormat();
-        imageInfo.extent.width = extent.width;
-        imageInfo.extent.height = extent.height;
+		imageInfo.format = shadowFormat;
+        imageInfo.extent.width = options.shadowResolution;
+        imageInfo.extent.height = options.shadowResolution;
         imageInfo.extent.depth = 1;
         imageInfo.mipLevels = 1;
-        imageInfo.arrayLayers = 1;
+        imageInfo.arrayLayers = options.shadowCascades;
         imageInfo.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
 
         for (size_t i = 0; i < rhi.getMaxFramesInFlight(); ++i) {
-            shadowImages.emplace_back(std::move(rhi.createImage(imageInfo)));
+            shadowImages.emplace_back(std::move(rhi.createImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::Shadow, vk::ImageViewType::e2DArray)));
         }
 
         vk::SamplerCreateInfo samplerInfo{};
@@ -660,6 +1193,10 @@ private:
     }
 
     void createPostprocResources() {
+        if (options.fusedPostproc) {
+            return; // the scene is drawn into the swapchain image
+        }
+
         postprocImages.reserve(rhi.getMaxFramesInFlight());
 
         auto extent = rhi.getSwapChainExtent();
@@ -675,7 +1212,7 @@ private:
         imageInfo.usage         = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
 
         for (size_t i = 0; i < rhi.getMaxFramesInFlight(); ++i) {
-            postprocImages.emplace_back(rhi.createImage(imageInfo));
+            postprocImages.emplace_back(rhi.createImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::RenderTarget));
         }
 
         vk::SamplerCreateInfo samplerInfo{};
@@ -684,6 +1221,43 @@ private:
         samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
 
         postprocSampler = vk::raii::Sampler(rhi.getDevice(), samplerInfo);
+
+        // the scene is rendered into the top left of the postproc images, so they stay at the window size
+        // and the render scale can change from frame to frame
+        renderScale = options.renderScale;
+        if (options.isDynamicResolution()) {
+            dynamicResolution = std::make_unique<Gfx::DynamicResolution>(options.targetGpuMilliseconds, *options.minRenderScale, options.renderScale);
+        }
+        if (options.renderScale < 1.0f || dynamicResolution) {
+            std::vector<vk::ImageView> upscalerInputs(postprocImages.size());
+            for (size_t i = 0; i < postprocImages.size(); ++i) {
+                upscalerInputs[i] = *postprocImages[i].getImageView();
+            }
+            upscaler = std::make_unique<Gfx::SpatialUpscaler>(rhi, upscalerInputs, rhi.getSwapChainExtent());
+        }
+    }
+
+    // Size the scene passes render at: the G-buffer, depth, clouds, lighting and particles
+    vk::Extent2D getRenderExtent() const {
+        auto extent = rhi.getSwapChainExtent();
+        if (!upscaler) {
+            return extent;
+        }
+
+        return vk::Extent2D{
+            std::max(static_cast<uint32_t>(extent.width * renderScale), 1u),
+            std::max(static_cast<uint32_t>(extent.height * renderScale), 1u),
+        };
+    }
+
+    // Color target of the cloud, lighting and particle passes
+    const vk::raii::ImageView& getSceneColorView(uint32_t imageIndex) const {
+        return options.fusedPostproc ? rhi.getSwapChainImageView(imageIndex) : postprocImages[imageIndex].getImageView();
+    }
+
+    static void setViewport(const vk::raii::CommandBuffer& cmd, vk::Extent2D extent) {
+        cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f));
+        cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), extent));
     }
 
     void createVertexBuffer() {
@@ -691,8 +1265,23 @@ private:
         bufferInfo.size = sizeof(vertices[0]) * vertices.size();
         bufferInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
 
-        vertexBuffer = rhi.createBuffer(bufferInfo);
+        vertexBuffer = rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::Geometry);
 		rhi.updateBuffer(vertexBuffer, vertices);
+
+        if (options.depthPrepass == DepthPrepassMode::Off) {
+            return;
+        }
+
+        // tightly packed, 12 bytes per vertex
+        std::vector<float> positions{};
+        positions.reserve(3 * vertices.size());
+        for (const auto& vertex : vertices) {
+            positions.insert(positions.end(), { vertex.position.x, vertex.position.y, vertex.position.z });
+        }
+
+        bufferInfo.size = sizeof(positions[0]) * positions.size();
+        positionBuffer = rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::Geometry);
+        rhi.updateBuffer(positionBuffer, positions);
 	}
 
     void createIndexBuffer() {
@@ -700,7 +1289,7 @@ private:
         bufferInfo.size = sizeof(indices[0]) * indices.size();
         bufferInfo.usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst;
 
-        indexBuffer = rhi.createBuffer(bufferInfo);
+        indexBuffer = rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::Geometry);
 		rhi.updateBuffer(indexBuffer, indices);
     }
 
@@ -709,7 +1298,7 @@ private:
         bufferInfo.size = sizeof(drawCmds[0]) * drawCmds.size();
         bufferInfo.usage = vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst;
 
-        indirectBuffer = rhi.createBuffer(bufferInfo);
+        indirectBuffer = rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::Geometry);
         rhi.updateBuffer(indirectBuffer, drawCmds);
 	}
 
@@ -723,7 +1312,8 @@ private:
         for (size_t i = 0; i < rhi.getMaxFramesInFlight(); i++) {
             auto uniformBuffer = rhi.createBuffer(bufferInfo,
                 vk::MemoryPropertyFlagBits::eHostVisible |
-                vk::MemoryPropertyFlagBits::eHostCoherent);
+                vk::MemoryPropertyFlagBits::eHostCoherent,
+                Gfx::MemoryCategory::Uniform);
             uniformBuffer.map();
             uniformBuffers.emplace_back(std::move(uniformBuffer));
         }
@@ -734,10 +1324,36 @@ private:
         bufferInfo.size = sizeof(instances[0]) * instances.size();
         bufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
 
-        storageBuffer = rhi.createBuffer(bufferInfo);
+        storageBuffer = rhi.createBuffer(bufferInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::Geometry);
         rhi.updateBuffer(storageBuffer, instances);
     }
 
+    void checkCaptureSupport() {
+        if (!(rhi.getSwapChainUsage() & vk::ImageUsageFlagBits::eTransferSrc)) {
+            throw std::runtime_error("swapchain images can't be read back on this surface!");
+        }
+
+        auto format = rhi.getSurfaceFormat();
+        if (format != vk::Format::eB8G8R8A8Srgb && format != vk::Format::eB8G8R8A8Unorm &&
+            format != vk::Format::eR8G8B8A8Srgb && format != vk::Format::eR8G8B8A8Unorm) {
+            throw std::runtime_error("unsupported swapchain format for readback!");
+        }
+    }
+
+    // RGBA8 copy of the last captured frame
+    std::vector<uint8_t> readCapture() {
+        auto rgba = std::move(capturedFrame);
+
+        auto format = rhi.getSurfaceFormat();
+        if (format == vk::Format::eB8G8R8A8Srgb || format == vk::Format::eB8G8R8A8Unorm) {
+            for (size_t i = 0; i < rgba.size(); i += 4) {
+                std::swap(rgba[i], rgba[i + 2]);
+            }
+        }
+
+        return rgba;
+    }
+
     void createGBufferResources() {
         auto extent = rhi.getSwapChainExtent();
 
@@ -762,10 +1378,10 @@ private:
         instanceIDInfo.format = vk::Format::eR32Uint;
 
         for (size_t i = 0; i < rhi.getMaxFramesInFlight(); i++) {
-            gbufferAlbedoImages.emplace_back(rhi.createImage(albedoInfo));
-            gbufferNormalImages.emplace_back(rhi.createImage(normalInfo));
-            gbufferPositionImages.emplace_back(rhi.createImage(positionInfo));
-            gbufferInstanceIDImages.emplace_back(rhi.createImage(instanceIDInfo));
+            gbufferAlbedoImages.emplace_back(rhi.createImage(albedoInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::GBuffer));
+            gbufferNormalImages.emplace_back(rhi.createImage(normalInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::GBuffer));
+            gbufferPositionImages.emplace_back(rhi.createImage(positionInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::GBuffer));
+            gbufferInstanceIDImages.emplace_back(rhi.createImage(instanceIDInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, Gfx::MemoryCategory::GBuffer));
         }
 
         vk::SamplerCreateInfo samplerInfo{};
@@ -792,6 +1408,7 @@ private:
 
         Gfx::DescriptorSetConfig computeConfig{};
         computeConfig.layout   = particlePipeline.getDescriptorSetLayout();
+        computeConfig.name     = "particle descriptor set";
         computeConfig.bindings = {
             { vk::DescriptorType::eUniformBuffer, std::vector<vk::DescriptorBufferInfo>(uboInfos) },
             { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ ssboInfo } },
@@ -799,6 +1416,7 @@ private:
 
         Gfx::DescriptorSetConfig shadowConfig{};
         shadowConfig.layout = shadowPipeline.getDescriptorSetLayout();
+        shadowConfig.name   = "shadow descriptor set";
         shadowConfig.bindings = {
             { vk::DescriptorType::eUniformBuffer, std::vector<vk::DescriptorBufferInfo>(uboInfos) },
             { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ ssboInfo } },
@@ -816,6 +1434,7 @@ private:
 
         Gfx::DescriptorSetConfig gbufferConfig{};
         gbufferConfig.layout   = gbufferPipeline.getDescriptorSetLayout();
+        gbufferConfig.name     = "gbuffer descriptor set";
         gbufferConfig.bindings = {
             computeConfig.bindings[0],
             computeConfig.bindings[1],
@@ -824,15 +1443,16 @@ private:
 
         Gfx::DescriptorSetConfig cloudConfig{};
         cloudConfig.layout = cloudPipeline.getDescriptorSetLayout();
+        cloudConfig.name   = "cloud descriptor set";
         cloudConfig.bindings = {
             { vk::DescriptorType::eUniformBuffer, std::vector<vk::DescriptorBufferInfo>(uboInfos) },
         };
 
-        std::vector<std::vector<vk::DescriptorImageInfo>> postprocImageInfos(maxFramesInFlight);
-        for (size_t i = 0; i < maxFramesInFlight; i++) {
+        std::vector<std::vector<vk::DescriptorImageInfo>> postprocImageInfos(options.fusedPostproc ? 0 : maxFramesInFlight);
+        for (size_t i = 0; i < postprocImageInfos.size(); i++) {
             vk::DescriptorImageInfo colorInfo{};
             colorInfo.sampler     = postprocSampler;
-            colorInfo.imageView   = postprocImages[i].getImageView();
+            colorInfo.imageView   = upscaler ? upscaler->getOutput(i).getImageView() : postprocImages[i].getImageView();
             colorInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
             postprocImageInfos[i]    = { colorInfo };
         }
@@ -869,6 +1489,7 @@ private:
 
         Gfx::DescriptorSetConfig lightingConfig{};
         lightingConfig.layout = lightingPipeline.getDescriptorSetLayout();
+        lightingConfig.name   = "lighting descriptor set";
         lightingConfig.bindings = {
             { vk::DescriptorType::eUniformBuffer, std::vector<vk::DescriptorBufferInfo>(uboInfos) },
             { vk::DescriptorType::eStorageBuffer, std::vector<vk::DescriptorBufferInfo>{ ssboInfo } },
@@ -881,10 +1502,14 @@ private:
 
         Gfx::DescriptorSetConfig postprocConfig{};
         postprocConfig.layout   = postprocPipeline.getDescriptorSetLayout();
+        postprocConfig.name     = "postproc descriptor set";
         postprocConfig.bindings = {
             computeConfig.bindings[0],
             { vk::DescriptorType::eCombinedImageSampler, std::vector<std::vector<vk::DescriptorImageInfo>>(postprocImageInfos) },
         };
+        if (options.fusedPostproc) {
+            postprocConfig.bindings.resize(1);
+        }
 
         auto [computeSets, shadowSets, gbufferSets, cloudSets, lightingSets, postprocSets] = rhi.createDescriptorSets(std::array{ computeConfig, shadowConfig, gbufferConfig, cloudConfig, lightingConfig, postprocConfig });
         computeDescriptorSets  = std::move(computeSets);
@@ -893,6 +1518,13 @@ private:
         cloudDescriptorSets = std::move(cloudSets);
         lightingDescriptorSets = std::move(lightingSets);
         postprocDescriptorSets = std::move(postprocSets);
+
+        if (options.depthPrepass != DepthPrepassMode::Off) {
+            Gfx::DescriptorSetConfig depthPrepassConfig = shadowConfig; // same bindings, the prepass pipeline's layout
+            depthPrepassConfig.layout = depthPrepassPipeline.getDescriptorSetLayout();
+            depthPrepassConfig.name   = "depth prepass descriptor set";
+            depthPrepassDescriptorSets = std::move(rhi.createDescriptorSets({ depthPrepassConfig })[0]);
+        }
     }
 
     void initRenderGraph()
@@ -920,11 +1552,27 @@ private:
                 nullptr);
 
             // shader uses [numthreads(64,1,1)], so ceil(instanceCount / 64) groups in X
-            cmd.dispatch((PARTICLE_COUNT + 63) / 64, 1, 1);
+            cmd.dispatch((particleCount + 63) / 64, 1, 1);
         };
 
+        particlePass.animated = true;
         graph.addPass(particlePass);
 
+        if (gpuParticles) {
+            Gfx::RenderPassNode gpuParticleUpdatePass{ "GpuParticleUpdatePass" };
+
+            // emit and simulate synchronize themselves, see Gfx::GpuParticleSystem
+            gpuParticleUpdatePass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
+            {
+                auto deltaTime = static_cast<float>(std::max(simulationTime - gpuParticleTime, 0.0));
+                gpuParticleTime = simulationTime;
+                gpuParticles->update(cmd, imageIndex, deltaTime);
+            };
+
+            gpuParticleUpdatePass.animated = true;
+            graph.addPass(gpuParticleUpdatePass);
+        }
+
         // Shadow pass: render scene from light into depth buffer
         Gfx::RenderPassNode shadowPass{ "ShadowPass" };
 
@@ -941,15 +1589,15 @@ private:
 
         shadowPass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
         {
-            auto swapChainExtent = rhi.getSwapChainExtent();
+            vk::Extent2D shadowExtent{ options.shadowResolution, options.shadowResolution };
 
             updateUniformBuffer(imageIndex);
 
             cmd.bindVertexBuffers(0, *vertexBuffer, { 0 });
             cmd.bindIndexBuffer(*indexBuffer, 0, vk::IndexType::eUint32);
 
-            cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f));
-            cmd.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapChainExtent));
+            // the shadow map resolution follows neither the window size nor the render scale
+            setViewport(cmd, shadowExtent);
 
             vk::ClearValue clearDepth = vk::ClearDepthStencilValue(1.0f, 0.0f);
             vk::RenderingAttachmentInfo shadowAttachmentInfo{};
@@ -962,25 +1610,31 @@ private:
             vk::RenderingInfo renderingInfo{};
             renderingInfo.renderArea.offset.x = 0;
             renderingInfo.renderArea.offset.y = 0;
-            renderingInfo.renderArea.extent = swapChainExtent;
+            renderingInfo.renderArea.extent = shadowExtent;
             renderingInfo.layerCount = 1;
+            renderingInfo.viewMask = getShadowViewMask(); // every draw renders all cascades, one per layer
             renderingInfo.pDepthAttachment = &shadowAttachmentInfo;
 
             cmd.beginRendering(renderingInfo);
 
             cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, shadowPipeline);
+            shadowPipeline.setState(cmd, OPAQUE_STATE);
             cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, shadowPipeline.getPipelineLayout(), 0, *shadowDescriptorSets[imageIndex], nullptr);
             cmd.drawIndexedIndirect(*indirectBuffer, static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)), drawCmds.size() - 1, static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
 
             cmd.endRendering();
         };
 
+        shadowPass.animated = true;
         graph.addPass(shadowPass);
 
         std::vector<vk::Image> postprocImageHandles(postprocImages.size());
         for (size_t i = 0; i < postprocImages.size(); ++i) {
             postprocImageHandles[i] = *postprocImages[i];
         }
+        if (options.fusedPostproc) {
+            postprocImageHandles = rhi.getSwapChain().getImages();
+        }
 
         Gfx::RenderPassNode cloudPass{ "CloudPass" };
 
@@ -996,24 +1650,25 @@ private:
 
         cloudPass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
         {
-            auto swapChainExtent = rhi.getSwapChainExtent();
+            auto renderExtent = getRenderExtent();
 
             vk::ClearValue clearColor = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
             vk::RenderingAttachmentInfo colorAttachmentInfo{};
-            colorAttachmentInfo.imageView = postprocImages[imageIndex].getImageView();
+            colorAttachmentInfo.imageView = getSceneColorView(imageIndex);
             colorAttachmentInfo.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
             colorAttachmentInfo.loadOp = vk::AttachmentLoadOp::eClear;
             colorAttachmentInfo.storeOp = vk::AttachmentStoreOp::eStore;
             colorAttachmentInfo.clearValue = clearColor;
 
             vk::RenderingInfo renderingInfo{};
-            renderingInfo.renderArea.extent = swapChainExtent;
+            renderingInfo.renderArea.extent = renderExtent;
             renderingInfo.layerCount = 1;
             renderingInfo.colorAttachmentCount = 1;
             renderingInfo.pColorAttachments = &colorAttachmentInfo;
 
             cmd.beginRendering(renderingInfo);
 
+            setViewport(cmd, renderExtent);
             cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, cloudPipeline);
             cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, cloudPipeline.getPipelineLayout(), 0, *cloudDescriptorSets[imageIndex], nullptr);
             cmd.draw(3, 1, 0, 0); // fullscreen triangle — no vertex buffer needed
@@ -1021,6 +1676,9 @@ private:
             cmd.endRendering();
         };
 
+        cloudPass.pipelines = { &cloudPipeline };
+
+        cloudPass.animated = true;
         graph.addPass(cloudPass);
 
         // GBuffer pass: render scene from camera into intermediate color image, sampling shadow map
@@ -1060,11 +1718,80 @@ private:
         sceneDepthTransition.dstAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
         sceneDepthTransition.srcStageMask  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
         sceneDepthTransition.dstStageMask  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
-        gbufferPass.attachmentInfos.emplace_back(std::move(sceneDepthTransition));
+
+        depthPrepassEnabled = options.depthPrepass == DepthPrepassMode::On;
+
+        if (options.depthPrepass != DepthPrepassMode::Off) {
+            // Depth prepass: the G-buffer draws, depth only; records nothing while depthPrepassEnabled is off
+            Gfx::RenderPassNode depthPrepass{ "DepthPrepass" };
+            depthPrepass.attachmentInfos.emplace_back(std::move(sceneDepthTransition));
+
+            depthPrepass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
+            {
+                if (!depthPrepassEnabled) {
+                    return;
+                }
+
+                auto renderExtent = getRenderExtent();
+
+                vk::ClearValue clearDepth = vk::ClearDepthStencilValue(1, 0);
+                vk::RenderingAttachmentInfo depthAttachmentInfo{};
+                depthAttachmentInfo.imageView   = rhi.getDepthImageView(imageIndex);
+                depthAttachmentInfo.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal;
+                depthAttachmentInfo.loadOp      = vk::AttachmentLoadOp::eClear;
+                depthAttachmentInfo.storeOp     = vk::AttachmentStoreOp::eStore;
+                depthAttachmentInfo.clearValue  = clearDepth;
+
+                vk::RenderingInfo renderingInfo{};
+                renderingInfo.renderArea.extent = renderExtent;
+                renderingInfo.layerCount        = 1;
+                renderingInfo.pDepthAttachment  = &depthAttachmentInfo;
+
+                cmd.beginRendering(renderingInfo);
+
+                setViewport(cmd, renderExtent);
+
+                cmd.bindVertexBuffers(0, *positionBuffer, { 0 });
+                cmd.bindIndexBuffer(*indexBuffer, 0, vk::IndexType::eUint32);
+                cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, depthPrepassPipeline);
+                depthPrepassPipeline.setState(cmd, OPAQUE_STATE);
+                cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, depthPrepassPipeline.getPipelineLayout(), 0, *depthPrepassDescriptorSets[imageIndex], nullptr);
+                cmd.drawIndexedIndirect(*indirectBuffer, 0, drawCmds.size(), static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
+
+                cmd.endRendering();
+            };
+
+            depthPrepass.pipelines = { &depthPrepassPipeline };
+
+            depthPrepass.animated = true;
+            graph.addPass(depthPrepass);
+        }
+        else {
+            gbufferPass.attachmentInfos.emplace_back(std::move(sceneDepthTransition));
+        }
+
+        // Counts the shaded fragments for the auto depth prepass, see updateDepthPrepass()
+        gbufferPass.countFragments = options.depthPrepass == DepthPrepassMode::Auto;
 
         gbufferPass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
         {
-            auto swapChainExtent = rhi.getSwapChainExtent();
+            auto renderExtent = getRenderExtent();
+            // the graph skips the prepass while its pipeline is still building
+            bool depthPrepassed = depthPrepassEnabled && depthPrepassPipeline.isUsable();
+
+            if (depthPrepassed) {
+                // the prepass depth writes, before this pass tests against them
+                vk::MemoryBarrier2 depthBarrier{};
+                depthBarrier.srcStageMask  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
+                depthBarrier.srcAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+                depthBarrier.dstStageMask  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
+                depthBarrier.dstAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentRead;
+
+                vk::DependencyInfo dependencyInfo{};
+                dependencyInfo.memoryBarrierCount = 1;
+                dependencyInfo.pMemoryBarriers    = &depthBarrier;
+                cmd.pipelineBarrier2(dependencyInfo);
+            }
 
             vk::ClearValue clearColor = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
             std::vector<vk::RenderingAttachmentInfo> colorAttachmentInfos{};
@@ -1087,12 +1814,12 @@ private:
             vk::RenderingAttachmentInfo depthAttachmentInfo{};
             depthAttachmentInfo.imageView   = rhi.getDepthImageView(imageIndex);
             depthAttachmentInfo.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal;
-            depthAttachmentInfo.loadOp      = vk::AttachmentLoadOp::eClear;
+            depthAttachmentInfo.loadOp      = depthPrepassed ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
             depthAttachmentInfo.storeOp     = vk::AttachmentStoreOp::eStore;
             depthAttachmentInfo.clearValue  = clearDepth;
 
             vk::RenderingInfo renderingInfo{};
-            renderingInfo.renderArea.extent    = swapChainExtent;
+            renderingInfo.renderArea.extent    = renderExtent;
             renderingInfo.layerCount           = 1;
             renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachmentInfos.size());
             renderingInfo.pColorAttachments    = colorAttachmentInfos.data();
@@ -1100,13 +1827,17 @@ private:
 
             cmd.beginRendering(renderingInfo);
 
+            setViewport(cmd, renderExtent);
+
             cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, gbufferPipeline);
+            gbufferPipeline.setState(cmd, depthPrepassed ? DEPTH_EQUAL_STATE : OPAQUE_STATE);
             cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, gbufferPipeline.getPipelineLayout(), 0, *gbufferDescriptorSets[imageIndex], nullptr);
             cmd.drawIndexedIndirect(*indirectBuffer, 0, drawCmds.size(), static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
 
             cmd.endRendering();
         };
 
+        gbufferPass.animated = true;
         graph.addPass(gbufferPass);
 
         Gfx::RenderPassNode lightingPass{ "LightingPass" };
@@ -1153,10 +1884,10 @@ private:
 
         lightingPass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
         {
-            auto swapChainExtent = rhi.getSwapChainExtent();
+            auto renderExtent = getRenderExtent();
 
             vk::RenderingAttachmentInfo colorAttachmentInfo{};
-            colorAttachmentInfo.imageView   = postprocImages[imageIndex].getImageView();
+            colorAttachmentInfo.imageView   = getSceneColorView(imageIndex);
             colorAttachmentInfo.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
             colorAttachmentInfo.loadOp      = vk::AttachmentLoadOp::eLoad;
             colorAttachmentInfo.storeOp     = vk::AttachmentStoreOp::eStore;
@@ -1168,7 +1899,7 @@ private:
             depthAttachmentInfo.storeOp = vk::AttachmentStoreOp::eDontCare;
 
             vk::RenderingInfo renderingInfo{};
-            renderingInfo.renderArea.extent    = swapChainExtent;
+            renderingInfo.renderArea.extent    = renderExtent;
             renderingInfo.layerCount           = 1;
             renderingInfo.colorAttachmentCount = 1;
             renderingInfo.pColorAttachments    = &colorAttachmentInfo;
@@ -1176,27 +1907,109 @@ private:
 
             cmd.beginRendering(renderingInfo);
 
+            setViewport(cmd, renderExtent);
+
             cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, lightingPipeline);
+            lightingPipeline.setState(cmd, DEPTH_READ_ONLY_STATE);
             cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, lightingPipeline.getPipelineLayout(), 0, *lightingDescriptorSets[imageIndex], nullptr);
             cmd.draw(3, 1, 0, 0); // fullscreen triangle — no vertex buffer needed
 
+            // the rain only adds light, so it blends onto the lit scene in place; the GPU particles are
+            // additive as well and come out the same drawn after it
+            if (options.fusedPostproc) {
+                cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, postprocPipeline);
+                cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, postprocPipeline.getPipelineLayout(), 0, *postprocDescriptorSets[imageIndex], nullptr);
+                cmd.draw(3, 1, 0, 0);
+            }
+
             cmd.endRendering();
         };
 
+        lightingPass.animated = options.fusedPostproc;
         graph.addPass(lightingPass);
 
-        // Post-processing pass: sample intermediate color image, apply rain/water distortion, write to swap chain
-        Gfx::RenderPassNode postprocPass{ "PostprocPass" };
+        if (gpuParticles) {
+            // Additive billboards on top of the lit scene, depth tested against the gbuffer depth
+            Gfx::RenderPassNode gpuParticleDrawPass{ "GpuParticleDrawPass" };
+            gpuParticleDrawPass.attachmentInfos.emplace_back(postprocImageTransition);
 
+            gpuParticleDrawPass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
+            {
+                auto renderExtent = getRenderExtent();
+
+                // the graph's transitions into this pass keep the layouts and record nothing, so order the
+                // lighting output before blending onto it and the scene depth before testing against it
+                std::array<vk::MemoryBarrier2, 2> barriers{};
+                barriers[0].srcStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+                barriers[0].srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
+                barriers[0].dstStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+                barriers[0].dstAccessMask = vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite;
+                barriers[1].srcStageMask  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
+                barriers[1].srcAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+                barriers[1].dstStageMask  = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests;
+                barriers[1].dstAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentRead;
+
+                vk::DependencyInfo dependencyInfo{};
+                dependencyInfo.memoryBarrierCount = static_cast<uint32_t>(barriers.size());
+                dependencyInfo.pMemoryBarriers    = barriers.data();
+                cmd.pipelineBarrier2(dependencyInfo);
+
+                vk::RenderingAttachmentInfo colorAttachmentInfo{};
+                colorAttachmentInfo.imageView   = getSceneColorView(imageIndex);
+                colorAttachmentInfo.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+                colorAttachmentInfo.loadOp      = vk::AttachmentLoadOp::eLoad;
+                colorAttachmentInfo.storeOp     = vk::AttachmentStoreOp::eStore;
+
+                vk::RenderingAttachmentInfo depthAttachmentInfo{};
+                depthAttachmentInfo.imageView   = rhi.getDepthImageView(imageIndex);
+                depthAttachmentInfo.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal;
+                depthAttachmentInfo.loadOp      = vk::AttachmentLoadOp::eLoad;
+                depthAttachmentInfo.storeOp     = vk::AttachmentStoreOp::eDontCare;
+
+                vk::RenderingInfo renderingInfo{};
+                renderingInfo.renderArea.extent    = renderExtent;
+                renderingInfo.layerCount           = 1;
+                renderingInfo.colorAttachmentCount = 1;
+                renderingInfo.pColorAttachments    = &colorAttachmentInfo;
+                renderingInfo.pDepthAttachment     = &depthAttachmentInfo;
+
+                cmd.beginRendering(renderingInfo);
+
+                setViewport(cmd, renderExtent);
+                gpuParticles->draw(cmd, imageIndex, cameraView, cameraProj);
+
+                cmd.endRendering();
+            };
+
+            gpuParticleDrawPass.animated = true;
+            graph.addPass(gpuParticleDrawPass);
+        }
+
+        // Transition intermediate color image: color attachment -> shader read, by the upscaler or the postproc pass
         postprocImageTransition.oldLayout     = vk::ImageLayout::eColorAttachmentOptimal;
         postprocImageTransition.newLayout     = vk::ImageLayout::eShaderReadOnlyOptimal;
         postprocImageTransition.srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
         postprocImageTransition.dstAccessMask = vk::AccessFlagBits2::eShaderRead;
         postprocImageTransition.srcStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
         postprocImageTransition.dstStageMask  = vk::PipelineStageFlagBits2::eFragmentShader;
-        postprocPass.attachmentInfos.emplace_back(std::move(postprocImageTransition));
 
-        // Transition swap chain image: undefined -> color attachment
+        // Upscale pass: EASU + RCAS from the render extent to the window size, the postproc pass samples the result
+        if (upscaler) {
+            Gfx::RenderPassNode upscalePass{ "UpscalePass" };
+            postprocImageTransition.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+            upscalePass.attachmentInfos.emplace_back(std::move(postprocImageTransition));
+
+            upscalePass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
+            {
+                upscaler->record(cmd, imageIndex, getRenderExtent());
+            };
+
+            upscalePass.animated = true;
+            graph.addPass(upscalePass);
+        }
+
+        // Transition swap chain image: undefined -> color attachment, already done by the cloud pass when the
+        // postprocess is fused into the lighting pass
         Gfx::RenderPassNode::AttachmentTransitionInfo swapchainTransition{ rhi.getSwapChain().getImages(), vk::ImageAspectFlagBits::eColor };
         swapchainTransition.oldLayout     = vk::ImageLayout::eUndefined;
         swapchainTransition.newLayout     = vk::ImageLayout::eColorAttachmentOptimal;
@@ -1204,44 +2017,103 @@ private:
         swapchainTransition.dstAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
         swapchainTransition.srcStageMask  = vk::PipelineStageFlagBits2::eTopOfPipe;
         swapchainTransition.dstStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
-        postprocPass.attachmentInfos.emplace_back(swapchainTransition); // keep copy — reused in present transition
 
-        postprocPass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
-        {
-            auto swapChainExtent = rhi.getSwapChainExtent();
+        if (!options.fusedPostproc) {
+            // Post-processing pass: sample intermediate color image, apply rain/water distortion, write to swap chain
+            Gfx::RenderPassNode postprocPass{ "PostprocPass" };
 
-            vk::ClearValue clearColor = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
-            vk::RenderingAttachmentInfo colorAttachmentInfo{};
-            colorAttachmentInfo.imageView   = rhi.getSwapChainImageView(imageIndex);
-            colorAttachmentInfo.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
-            colorAttachmentInfo.loadOp      = vk::AttachmentLoadOp::eClear;
-            colorAttachmentInfo.storeOp     = vk::AttachmentStoreOp::eStore;
-            colorAttachmentInfo.clearValue  = clearColor;
+            if (!upscaler) {
+                postprocPass.attachmentInfos.emplace_back(std::move(postprocImageTransition));
+            }
 
-            vk::RenderingInfo renderingInfo{};
-            renderingInfo.renderArea.extent    = swapChainExtent;
-            renderingInfo.layerCount           = 1;
-            renderingInfo.colorAttachmentCount = 1;
-            renderingInfo.pColorAttachments    = &colorAttachmentInfo;
+            postprocPass.attachmentInfos.emplace_back(swapchainTransition); // keep copy — reused in present transition
 
-            cmd.beginRendering(renderingInfo);
+            postprocPass.recordFunc = [this](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
+            {
+                auto swapChainExtent = rhi.getSwapChainExtent();
+
+                vk::ClearValue clearColor = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
+                vk::RenderingAttachmentInfo colorAttachmentInfo{};
+                colorAttachmentInfo.imageView   = rhi.getSwapChainImageView(imageIndex);
+                colorAttachmentInfo.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+                colorAttachmentInfo.loadOp      = vk::AttachmentLoadOp::eClear;
+                colorAttachmentInfo.storeOp     = vk::AttachmentStoreOp::eStore;
+                colorAttachmentInfo.clearValue  = clearColor;
+
+                vk::RenderingInfo renderingInfo{};
+                renderingInfo.renderArea.extent    = swapChainExtent;
+                renderingInfo.layerCount           = 1;
+                renderingInfo.colorAttachmentCount = 1;
+                renderingInfo.pColorAttachments    = &colorAttachmentInfo;
+
+                cmd.beginRendering(renderingInfo);
+
+                setViewport(cmd, swapChainExtent);
+                cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, postprocPipeline);
+                cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, postprocPipeline.getPipelineLayout(), 0, *postprocDescriptorSets[imageIndex], nullptr);
+                cmd.draw(3, 1, 0, 0); // fullscreen triangle — no vertex buffer needed
+
+                cmd.endRendering();
+            };
+
+            postprocPass.animated = true;
+            graph.addPass(postprocPass);
+        }
 
-            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, postprocPipeline);
-            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, postprocPipeline.getPipelineLayout(), 0, *postprocDescriptorSets[imageIndex], nullptr);
-            cmd.draw(3, 1, 0, 0); // fullscreen triangle — no vertex buffer needed
+        // Golden image and sequence modes copy the finished frame out before it is presented. Only the frames with
+        // a captureCallback do, so the transitions to the copy and back are recorded here rather than by the graph.
+        if (options.capturesFrames()) {
+            Gfx::RenderPassNode capturePass{ "CapturePass" };
 
-            cmd.endRendering();
-        };
+            capturePass.recordFunc = [this, swapChainImages = swapchainTransition.images](vk::raii::CommandBuffer& cmd, uint32_t imageIndex)
+            {
+                if (!captureCallback) {
+                    return;
+                }
 
-        graph.addPass(postprocPass);
+                auto swapChainExtent = rhi.getSwapChainExtent();
+
+                vk::ImageMemoryBarrier2 barrier{};
+                barrier.image            = swapChainImages[imageIndex];
+                barrier.oldLayout        = vk::ImageLayout::eColorAttachmentOptimal;
+                barrier.newLayout        = vk::ImageLayout::eTransferSrcOptimal;
+                barrier.srcStageMask     = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+                barrier.srcAccessMask    = vk::AccessFlagBits2::eColorAttachmentWrite;
+                barrier.dstStageMask     = vk::PipelineStageFlagBits2::eCopy;
+                barrier.dstAccessMask    = vk::AccessFlagBits2::eTransferRead;
+                barrier.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+
+                vk::DependencyInfo dependencyInfo{};
+                dependencyInfo.imageMemoryBarrierCount = 1;
+                dependencyInfo.pImageMemoryBarriers    = &barrier;
+                cmd.pipelineBarrier2(dependencyInfo);
+
+                Gfx::ReadbackImageRegion region{};
+                region.image = swapChainImages[imageIndex];
+                region.extent = vk::Extent3D{ swapChainExtent.width, swapChainExtent.height, 1 };
+                rhi.getReadback().readImage(cmd, region, std::move(captureCallback));
+                captureCallback = nullptr;
+
+                // back to the layout the present transition expects, in the stage it waits on so the two chain;
+                // the copy only reads, so there is nothing to make visible
+                std::swap(barrier.oldLayout, barrier.newLayout);
+                barrier.srcStageMask  = vk::PipelineStageFlagBits2::eCopy;
+                barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+                barrier.dstStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+                barrier.dstAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
+                cmd.pipelineBarrier2(dependencyInfo);
+            };
+
+            graph.addPass(capturePass);
+        }
 
         // Present transition: swap chain color attachment -> presentable
         Gfx::RenderPassNode presentTransition{ "PresentTransition" };
         swapchainTransition.oldLayout     = vk::ImageLayout::eColorAttachmentOptimal;
-        swapchainTransition.newLayout     = vk::ImageLayout::ePresentSrcKHR;
         swapchainTransition.srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite;
-        swapchainTransition.dstAccessMask = vk::AccessFlagBits2::eNone;
         swapchainTransition.srcStageMask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+        swapchainTransition.newLayout     = vk::ImageLayout::ePresentSrcKHR;
+        swapchainTransition.dstAccessMask = vk::AccessFlagBits2::eNone;
         swapchainTransition.dstStageMask  = vk::PipelineStageFlagBits2::eBottomOfPipe;
         presentTransition.attachmentInfos.emplace_back(std::move(swapchainTransition));
 
@@ -1251,42 +2123,405 @@ private:
     }
 
     void updateUniformBuffer(uint32_t currentImage) {
-        static auto startTime = std::chrono::high_resolution_clock::now();
+        auto time = static_cast<float>(simulationTime);
 
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-
-		auto swapChainExtent = rhi.getSwapChainExtent();
+        auto camera = sampleCameraPath(cameraPath, simulationTime);
 
         UniformBufferObject ubo{};
-        ubo.view = lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height), 0.1f, 10.0f);
+        ubo.view = lookAt(camera.position, camera.target, glm::vec3(0.0f, 0.0f, 1.0f));
+        ubo.proj = glm::perspective(CAMERA_FOV_Y, getCameraAspect(), CAMERA_NEAR, CAMERA_FAR);
         ubo.proj[1][1] *= -1;
+        cameraView = ubo.view;
+        cameraProj = ubo.proj;
         ubo.rotation = glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 		auto nLightDir = -glm::normalize(glm::vec3(-1.0f, 1.0, -1.0));
 		ubo.nLightDir = glm::vec4(nLightDir, 0.0f);
-        ubo.lightView = lookAt(nLightDir, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.lightProj = glm::ortho(-3.0f, 3.0f, -3.0f, 3.0f, 0.1f, 10.0f);
-        ubo.lightProj[1][1] *= -1;
-		ubo.particleCount = PARTICLE_COUNT;
+
+        shadowCascades->update(ubo.view, CAMERA_FOV_Y, getCameraAspect(), CAMERA_NEAR, CAMERA_FAR, nLightDir);
+        const auto& cascades = shadowCascades->getCascades();
+        for (size_t i = 0; i < cascades.size(); i++) {
+            ubo.cascadeViewProj[i] = cascades[i].viewProj;
+            ubo.cascadeSplits[i] = cascades[i].splitDistance;
+            ubo.cascadeDepthBias[i] = (SHADOW_DEPTH_BIAS + SHADOW_TEXEL_BIAS * cascades[i].texelSize) / cascades[i].depthRange;
+        }
+        ubo.cascadeCount = static_cast<uint32_t>(cascades.size());
+
+		ubo.particleCount = particleCount;
 		ubo.time = time;
-        ubo.res.x = swapChainExtent.width;
-        ubo.res.y = swapChainExtent.height;
+        auto renderExtent = getRenderExtent();
+        ubo.res.x = renderExtent.width;
+        ubo.res.y = renderExtent.height;
 
         memcpy(uniformBuffers[currentImage].getMappedData(), &ubo, sizeof(ubo));
     }
 
+    void advanceTime() {
+        if (frameCount == 0) {
+            startTime = std::chrono::steady_clock::now();
+        }
+        frameCount++;
+
+        if (animationPaused) {
+            return;
+        }
+
+        // multiply instead of accumulating, so frame N shows the same time in every run
+        simulationTime = options.timestep > 0.0
+            ? static_cast<double>(animatedFrameCount) * options.timestep
+            : std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        animatedFrameCount++;
+    }
+
+    // Feeds the GPU time of the last finished frame to the dynamic resolution controller and takes the
+    // render scale of the next one from it
+    void updateRenderScale() {
+        if (!dynamicResolution) {
+            return;
+        }
+
+        if (const auto& timing = graph.getLastFrameTiming()) {
+            // the passes rendered at the render extent; the rest of the frame, shadows at their own resolution
+            // and everything at the output size, costs the same at any scale
+            static const std::array<const char*, 5> scaledPasses = { "CloudPass", "DepthPrepass", "GBufferPass", "LightingPass", "GpuParticleDrawPass" };
+
+            double scaledMilliseconds = 0.0;
+            for (const auto& pass : timing->passes) {
+                if (std::find(scaledPasses.begin(), scaledPasses.end(), pass.name) != scaledPasses.end()) {
+                    scaledMilliseconds += pass.gpuMilliseconds;
+                }
+            }
+            dynamicResolution->addFrame(timing->frame, scaledMilliseconds, timing->gpuMilliseconds - scaledMilliseconds);
+        }
+        renderScale = dynamicResolution->beginFrame(graph.getCurrentFrame());
+    }
+
+    // Auto depth prepass: the G-buffer pass counts its fragment shader invocations over the first window of frames,
+    // and if they average more than DEPTH_PREPASS_OVERDRAW per rendered pixel the prepass is on for the rest of the
+    // run. Either way the counting stops there; with the prepass on it would only give the covered pixels anyway.
+    // The count is divided by the whole render area, sky and clouds included, so a frame that is mostly sky
+    // reads as less overdraw than its geometry has. Without pipeline statistics the count stays 0 and so does
+    // the prepass.
+    void updateDepthPrepass() {
+        if (options.depthPrepass != DepthPrepassMode::Auto || depthPrepassDecided) {
+            return;
+        }
+
+        const auto& timing = graph.getLastFrameTiming();
+        if (!timing || timing->frame < nextOverdrawFrame) {
+            return;
+        }
+        nextOverdrawFrame = timing->frame + 1;
+
+        auto gbufferTiming = std::find_if(timing->passes.begin(), timing->passes.end(), [](const Gfx::PassTiming& pass) { return pass.name == "GBufferPass"; });
+        if (gbufferTiming == timing->passes.end() || gbufferTiming->fragmentShaderInvocations == 0) {
+            return; // no statistics, or the pass was skipped for a pipeline still building
+        }
+
+        // the frame was measured a few frames ago, the render extent may have moved a little since with dynamic resolution
+        auto renderExtent = getRenderExtent();
+        overdrawSum += static_cast<double>(gbufferTiming->fragmentShaderInvocations) / (static_cast<double>(renderExtent.width) * renderExtent.height);
+        if (++overdrawFrames < DEPTH_PREPASS_SAMPLE_FRAMES) {
+            return;
+        }
+
+        double overdraw = overdrawSum / overdrawFrames;
+        depthPrepassDecided = true;
+        graph.stopCountingFragments("GBufferPass");
+
+        if (overdraw > DEPTH_PREPASS_OVERDRAW) {
+            depthPrepassEnabled = true;
+            std::cout << "depth prepass enabled, G-buffer overdraw " << overdraw << std::endl;
+        }
+    }
+
     void drawFrame() {
+        advanceTime();
+        updateRenderScale();
+        updateDepthPrepass();
         graph.executeFrame();
+
+        if (memoryLog.is_open()) {
+            auto snapshot = rhi.getMemorySnapshot().toJson();
+            snapshot["frame"] = frameCount - 1;
+            memoryLog << snapshot.dump() << '\n';
+        }
     }
 
     void mainLoop() {
+        if (options.benchmark) {
+            runBenchmark();
+            return;
+        }
+        if (options.isGoldenTest()) {
+            runGoldenTest();
+            return;
+        }
+        if (options.isSequence()) {
+            runSequence();
+            return;
+        }
+
+        Gfx::FramePacer pacer(options.maxFps);
+
+        auto loopStart = std::chrono::steady_clock::now();
+        auto lastPacingLog = loopStart;
+        double idleSeconds = 0.0;
+
         while (!glfwWindowShouldClose(window)) {
+            if (options.onDemand && !needsFrame()) {
+                // input wakes this up right away, the timeout picks up pipelines finished on the workers
+                auto idleStart = std::chrono::steady_clock::now();
+                glfwWaitEventsTimeout(ON_DEMAND_WAIT_SECONDS);
+                idleSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - idleStart).count();
+                pacer.resync(); // the gap while idle is no stutter
+                continue;
+            }
+
+            pacer.wait(); // before polling, so the frame sees the freshest input
+            glfwPollEvents();
+            frameDirty = false;
+            drawFrame();
+
+            if (options.pacingLogSeconds > 0.0 &&
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - lastPacingLog).count() >= options.pacingLogSeconds) {
+                printPacingStats("frame pacing", pacer.getWindowStats());
+                pacer.resetWindow();
+                lastPacingLog = std::chrono::steady_clock::now();
+            }
+        }
+
+        rhi.getDevice().waitIdle();
+
+        printPacingStats("frame pacing (whole run)", pacer.getStats());
+
+        if (options.onDemand) {
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loopStart).count();
+            std::cout << "on-demand: drew " << frameCount << " frames in " << seconds << " s, idle "
+                << 100.0 * idleSeconds / seconds << "% of the time" << std::endl;
+        }
+
+        printPipelineStats();
+    }
+
+    bool needsFrame() {
+        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED)) {
+            return false; // nothing to see, the refresh callback fires again once it is restored
+        }
+
+        return frameDirty
+            || (!animationPaused && graph.hasActiveAnimatedPasses())
+            || rhi.hasPendingPipelineSwaps()
+            || rhi.getReadback().hasPendingRequests();
+    }
+
+    void runBenchmark() {
+        Gfx::Benchmark benchmark(options.warmupFrames, options.measuredFrames);
+
+        while (!benchmark.isFinished() && !glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            drawFrame();
+
+            if (const auto& timing = graph.getLastFrameTiming()) {
+                benchmark.addFrame(*timing);
+            }
+        }
+
+        rhi.getDevice().waitIdle();
+
+        nlohmann::json scene = {
+            { "width", rhi.getSwapChainExtent().width },
+            { "height", rhi.getSwapChainExtent().height },
+            { "particleGrid", { options.particleGrid.x, options.particleGrid.y, options.particleGrid.z } },
+            { "particleLights", particleCount },
+            { "particleTextureSize", options.particleTextureSize },
+            { "modelInstances", options.modelInstances },
+            { "gpuParticles", options.gpuParticles },
+            { "fp16", !getPrecisionDefines().empty() },
+            { "scalarizedLightLoop", isLightLoopScalarized() },
+            { "renderScale", upscaler ? options.renderScale : 1.0f },
+            { "targetGpuMilliseconds", options.targetGpuMilliseconds },
+            { "minRenderScale", dynamicResolution ? *options.minRenderScale : options.renderScale },
+            { "fusedPostproc", options.fusedPostproc },
+            { "depthPrepass", depthPrepassEnabled },
+            { "shadowCascades", options.shadowCascades },
+            { "shadowResolution", options.shadowResolution },
+            { "shadowFormat", vk::to_string(shadowFormat) },
+            { "instances", instances.size() },
+            { "textures", textures.size() },
+            { "triangles", indices.size() / 3 },
+            { "seed", *options.seed },
+            { "timestep", options.timestep },
+        };
+
+        benchmark.writeReport(options.reportPath, rhi, scene);
+        std::cout << "benchmark report written to " << options.reportPath << std::endl;
+    }
+
+    void runGoldenTest() {
+        Gfx::GoldenImageTest test(options.goldenDirectory, options.goldenUpdate);
+        auto extent = rhi.getSwapChainExtent();
+
+        for (auto time : options.goldenTimes) {
+            // every frame in flight is rendered at the same time, so nothing of earlier times is left in the capture
+            for (uint32_t i = 0; i < rhi.getMaxFramesInFlight(); i++) {
+                glfwPollEvents();
+                if (i + 1 == rhi.getMaxFramesInFlight()) {
+                    captureCallback = [this](const void* data, vk::DeviceSize size) {
+                        auto bytes = static_cast<const uint8_t*>(data);
+                        capturedFrame.assign(bytes, bytes + size);
+                    };
+                }
+                simulationTime = time;
+                graph.executeFrame();
+            }
+
+            rhi.getReadback().flush();
+
+            char name[32];
+            snprintf(name, sizeof(name), "time_%.2f", time);
+            test.checkImage(name, readCapture(), extent.width, extent.height);
+        }
+
+        std::vector<Gfx::FrameTiming> timings{};
+        for (uint32_t i = 0; i < GOLDEN_BUDGET_FRAMES; i++) {
             glfwPollEvents();
             drawFrame();
+
+            const auto& timing = graph.getLastFrameTiming();
+            if (timing && (timings.empty() || timing->frame > timings.back().frame)) {
+                timings.push_back(*timing);
+            }
         }
 
         rhi.getDevice().waitIdle();
+
+        test.checkBudgets(timings);
+
+        auto report = test.getReport();
+        report["device"] = Gfx::Benchmark::getDeviceInfo(rhi);
+
+        auto reportPath = options.goldenDirectory + "/report.json";
+        std::ofstream file(reportPath);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open golden image report " + reportPath + "!");
+        }
+        file << report.dump(2) << std::endl;
+
+        testPassed = test.hasPassed();
+    }
+
+    void runSequence() {
+        Gfx::ImageSequenceWriter writer(options.sequenceDirectory, options.writerThreads);
+
+        auto extent = rhi.getSwapChainExtent();
+        auto format = rhi.getSurfaceFormat();
+        bool bgra = format == vk::Format::eB8G8R8A8Srgb || format == vk::Format::eB8G8R8A8Unorm;
+
+        uint32_t frames = options.sequenceFrames
+            ? *options.sequenceFrames
+            : cameraPath.empty()
+                ? DEFAULT_SEQUENCE_FRAMES
+                : static_cast<uint32_t>(cameraPath.back().time / options.timestep) + 1;
+
+        std::vector<Gfx::FrameTiming> timings{};
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint32_t frame = 0; frame < frames && !glfwWindowShouldClose(window); frame++) {
+            glfwPollEvents();
+
+            // the readback completes getMaxFramesInFlight() frames later, and is encoded while those render
+            captureCallback = [&writer, frame, extent, bgra](const void* data, vk::DeviceSize size) {
+                auto bytes = static_cast<const uint8_t*>(data);
+                writer.write(frame, std::vector<uint8_t>(bytes, bytes + size), extent.width, extent.height, bgra);
+            };
+            drawFrame();
+
+            const auto& timing = graph.getLastFrameTiming();
+            if (timing && (timings.empty() || timing->frame > timings.back().frame)) {
+                timings.push_back(*timing);
+            }
+        }
+
+        rhi.getReadback().flush();
+        writer.finish();
+
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        auto written = std::max(writer.getWrittenFrames(), 1u);
+
+        double gpuMilliseconds = 0.0;
+        for (const auto& timing : timings) {
+            gpuMilliseconds += timing.gpuMilliseconds;
+        }
+
+        std::cout << "wrote " << writer.getWrittenFrames() << " frames to " << options.sequenceDirectory
+            << " in " << seconds << " s (" << writer.getWrittenFrames() / seconds << " fps)" << std::endl;
+        std::cout << "GPU " << (timings.empty() ? 0.0 : gpuMilliseconds / timings.size()) << " ms/frame, "
+            << "encode " << writer.getEncodeMilliseconds() / written << " ms/frame on "
+            << "writer threads, render thread blocked on writers for " << writer.getBlockedMilliseconds() << " ms" << std::endl;
+    }
+
+    void runRHIBenchmark() {
+        rhi.init("Vulkan Renderer", getRequiredExtensions(), glfwGetWin32Window(window));
+        precompileShaders();
+
+        auto report = Gfx::RHIBenchmark(rhi).run(getCloudPipelineCreateInfo(cloudQuality), getParticlePipelineCreateInfo());
+        report["device"] = Gfx::Benchmark::getDeviceInfo(rhi);
+
+        std::ofstream file(options.reportPath);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open benchmark report " + options.reportPath + "!");
+        }
+        file << report.dump(2) << std::endl;
+
+        std::cout << "RHI benchmark report written to " << options.reportPath << std::endl;
+    }
+
+    void printPacingStats(const char* label, const Gfx::PacingStats& stats) {
+        std::cout << label << ": " << stats.frames << " frames, mean " << stats.meanMilliseconds
+            << " ms, p50 " << stats.p50Milliseconds << " ms, p95 " << stats.p95Milliseconds
+            << " ms, p99 " << stats.p99Milliseconds << " ms, max " << stats.maxMilliseconds
+            << " ms, " << stats.stutters << " stutters" << std::endl;
+    }
+
+    // Slowest first, the shaders worth trimming for startup time
+    void printPipelineCreationReport() {
+        auto pipelines = rhi.getPipelineStats();
+        std::sort(pipelines.begin(), pipelines.end(), [](const auto& a, const auto& b) {
+            return a.feedback.milliseconds > b.feedback.milliseconds;
+        });
+
+        std::cout << "pipeline creation:" << std::endl;
+        for (const auto& stats : pipelines) {
+            const auto& feedback = stats.feedback;
+            std::cout << "  " << stats.name << ": ";
+            if (!feedback.valid) {
+                std::cout << "no feedback from the driver" << std::endl;
+                continue;
+            }
+
+            std::cout << feedback.milliseconds << " ms" << (feedback.cacheHit ? " (cache hit)" : "");
+            for (const auto& stage : feedback.stages) {
+                std::cout << ", " << vk::to_string(stage.stage);
+                if (stage.valid) {
+                    std::cout << " " << stage.milliseconds << " ms" << (stage.cacheHit ? " (cache hit)" : "");
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    void printPipelineStats() {
+        for (const auto& stats : rhi.getPipelineStats()) {
+            std::cout << stats.name << ": ";
+            if (stats.ready) {
+                std::cout << "ready after " << stats.waitMilliseconds << " ms" << (stats.optimized ? "" : " (fast linked)");
+            }
+            else {
+                std::cout << "never became ready";
+            }
+            std::cout << ", " << stats.fallbackFrames << " fallback frames, " << stats.skippedFrames << " skipped frames" << std::endl;
+        }
     }
 
     void cleanup() {
@@ -1296,12 +2531,232 @@ private:
     }
 };
 
-int main() {
+// --benchmark                   render --warmup N + --frames N frames headless, then write --report <file.json>
+// --rhi-bench                   run the RHI microbenchmarks, then write --report <file.json>
+// --golden <dir>                compare frames rendered at --golden-times <t0,t1,...> with <dir>/*.png and check
+//                               the pass GPU budgets in <dir>/golden.json; --golden-update rewrites the references
+// --sequence <dir>              render --sequence-frames N frames along --camera-path <file.json> without vsync and
+//                               write them to <dir>/frame_NNNNN.png on --writer-threads N threads
+// --on-demand                   only draw frames when something changed, animation starts paused (P toggles it)
+// --max-fps <N>                 cap the interactive frame rate
+// --pacing-log <seconds>        log frame pacing (interval percentiles, stutters) every N seconds
+// --memory-log <file.jsonl>     dump device memory per heap and category, with the driver budget, every frame
+// --resolution <W>x<H>
+// --headless                    render to a hidden window
+// --particles <X>x<Y>x<Z>       particle light grid
+// --instances <N>               copies of the model
+// --texture-size <N>            size of the per-particle textures
+// --gpu-particles <N>           add a GPU-simulated particle fountain with a pool of N particles
+// --no-fp16                     keep the lighting, cloud and postproc shaders in 32-bit floats, e.g. to benchmark
+//                               against their half-precision permutations
+// --wave-ops                    scalarize the light loop of the lighting shader with wave intrinsics
+// --render-scale <s>            render the scene at s (0.25 to 1) times the window size and upscale it with EASU + RCAS
+// --dynamic-resolution <ms>     adjust the render scale every frame to keep the GPU frame time under <ms>, between
+//                               --min-render-scale <s> (default 0.5) and --render-scale; not in benchmark, golden
+//                               image or sequence mode, whose frames must not depend on the GPU load
+// --fused-postproc              add the rain in the lighting pass instead of a separate postproc pass, without the
+//                               intermediate color image; not with a render scale below 1 or dynamic resolution
+// --depth-prepass <on|off|auto> depth-only prepass before the G-buffer pass; auto (default) enables it if the
+//                               G-buffer overdraw over the first frames is above 1.5 fragments per rendered pixel.
+//                               Benchmark, golden image and sequence modes take auto as off
+// --shadow-cascades <N>         shadow map cascades, 1 to 4 (default 4)
+// --shadow-resolution <N>       width and height of every shadow cascade (default 1024)
+// --seed <N>, --timestep <seconds>
+//
+// Benchmark, golden image and sequence modes default to seed 0 and a 1/60 s timestep, so runs with the same settings
+// render the same frames
+static Options parseOptions(int argc, char** argv) {
+    Options options{};
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        auto number = [&]() { return static_cast<uint32_t>(std::stoul(value())); };
+
+        if (arg == "--benchmark") {
+            options.benchmark = true;
+            options.headless = true;
+        }
+        else if (arg == "--rhi-bench") {
+            options.rhiBenchmark = true;
+            options.headless = true;
+        }
+        else if (arg == "--golden") {
+            options.goldenDirectory = value();
+            options.headless = true;
+        }
+        else if (arg == "--golden-update") {
+            options.goldenUpdate = true;
+        }
+        else if (arg == "--golden-times") {
+            options.goldenTimes.clear();
+            std::stringstream times(value());
+            std::string time;
+            while (std::getline(times, time, ',')) {
+                options.goldenTimes.push_back(std::stod(time));
+            }
+        }
+        else if (arg == "--sequence") {
+            options.sequenceDirectory = value();
+            options.headless = true;
+        }
+        else if (arg == "--camera-path") {
+            options.cameraPath = value();
+        }
+        else if (arg == "--sequence-frames") {
+            options.sequenceFrames = number();
+        }
+        else if (arg == "--writer-threads") {
+            options.writerThreads = number();
+        }
+        else if (arg == "--on-demand") {
+            options.onDemand = true;
+        }
+        else if (arg == "--max-fps") {
+            options.maxFps = std::stod(value());
+        }
+        else if (arg == "--pacing-log") {
+            options.pacingLogSeconds = std::stod(value());
+        }
+        else if (arg == "--memory-log") {
+            options.memoryLogPath = value();
+        }
+        else if (arg == "--headless") {
+            options.headless = true;
+        }
+        else if (arg == "--warmup") {
+            options.warmupFrames = number();
+        }
+        else if (arg == "--frames") {
+            options.measuredFrames = number();
+        }
+        else if (arg == "--report") {
+            options.reportPath = value();
+        }
+        else if (arg == "--resolution") {
+            if (sscanf(value().c_str(), "%ux%u", &options.width, &options.height) != 2) {
+                throw std::invalid_argument("expected --resolution <width>x<height>");
+            }
+        }
+        else if (arg == "--particles") {
+            if (sscanf(value().c_str(), "%ux%ux%u", &options.particleGrid.x, &options.particleGrid.y, &options.particleGrid.z) != 3) {
+                throw std::invalid_argument("expected --particles <x>x<y>x<z>");
+            }
+        }
+        else if (arg == "--instances") {
+            options.modelInstances = number();
+        }
+        else if (arg == "--texture-size") {
+            options.particleTextureSize = std::max(number(), 1u);
+        }
+        else if (arg == "--gpu-particles") {
+            options.gpuParticles = number();
+        }
+        else if (arg == "--no-fp16") {
+            options.fp16 = false;
+        }
+        else if (arg == "--wave-ops") {
+            options.waveOps = true;
+        }
+        else if (arg == "--render-scale") {
+            options.renderScale = std::stof(value());
+            if (options.renderScale < 0.25f || options.renderScale > 1.0f) {
+                throw std::invalid_argument("expected --render-scale between 0.25 and 1");
+            }
+        }
+        else if (arg == "--dynamic-resolution") {
+            options.targetGpuMilliseconds = std::stod(value());
+            if (options.targetGpuMilliseconds <= 0.0) {
+                throw std::invalid_argument("expected a positive --dynamic-resolution frame time");
+            }
+        }
+        else if (arg == "--min-render-scale") {
+            options.minRenderScale = std::stof(value());
+            if (*options.minRenderScale < 0.25f || *options.minRenderScale > 1.0f) {
+                throw std::invalid_argument("expected --min-render-scale between 0.25 and 1");
+            }
+        }
+        else if (arg == "--fused-postproc") {
+            options.fusedPostproc = true;
+        }
+        else if (arg == "--depth-prepass") {
+            auto mode = value();
+            if (mode == "on") {
+                options.depthPrepass = DepthPrepassMode::On;
+            }
+            else if (mode == "off") {
+                options.depthPrepass = DepthPrepassMode::Off;
+            }
+            else if (mode == "auto") {
+                options.depthPrepass = DepthPrepassMode::Auto;
+            }
+            else {
+                throw std::invalid_argument("expected --depth-prepass on, off or auto");
+            }
+        }
+        else if (arg == "--shadow-cascades") {
+            options.shadowCascades = number();
+            if (options.shadowCascades < 1 || options.shadowCascades > MAX_SHADOW_CASCADES) {
+                throw std::invalid_argument("expected --shadow-cascades between 1 and " + std::to_string(MAX_SHADOW_CASCADES));
+            }
+        }
+        else if (arg == "--shadow-resolution") {
+            options.shadowResolution = number();
+            if (options.shadowResolution == 0) {
+                throw std::invalid_argument("expected a positive --shadow-resolution");
+            }
+        }
+        else if (arg == "--seed") {
+            options.seed = number();
+        }
+        else if (arg == "--timestep") {
+            options.timestep = std::stod(value());
+        }
+        else {
+            throw std::invalid_argument("unknown option " + arg);
+        }
+    }
+
+    if (options.minRenderScale > options.renderScale) {
+        throw std::invalid_argument("--min-render-scale must not exceed --render-scale");
+    }
+    options.minRenderScale = options.minRenderScale.value_or(std::min(0.5f, options.renderScale));
+
+    // the render scale would follow the wall-clock GPU load, so the same settings wouldn't render the same frames
+    if (options.isDynamicResolution() && (options.benchmark || options.capturesFrames())) {
+        throw std::invalid_argument("--dynamic-resolution can't be used with --benchmark, --golden or --sequence");
+    }
+
+    if (options.fusedPostproc && (options.renderScale < 1.0f || options.isDynamicResolution())) {
+        throw std::invalid_argument("--fused-postproc needs the full render scale, the upscaler reads the intermediate image");
+    }
+
+    if (options.benchmark || options.capturesFrames()) {
+        options.seed = options.seed.value_or(0);
+        options.timestep = options.timestep > 0.0 ? options.timestep : 1.0 / 60.0;
+
+        // switching partway would mix two configurations in the measured and captured frames
+        if (options.depthPrepass == DepthPrepassMode::Auto) {
+            options.depthPrepass = DepthPrepassMode::Off;
+        }
+    }
+
+    return options;
+}
+
+int main(int argc, char** argv) {
     try {
-        HelloTriangleApplication app;
+        HelloTriangleApplication app(parseOptions(argc, argv));
         app.run();
     }
     catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
 
@@ -0,0 +1,172 @@
+#include "SpatialUpscaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using Gfx::SpatialUpscaler;
+
+// UPSCALE_GROUP_SIZE in Shaders/upscale.fxh, in both dimensions
+static const uint32_t groupSize = 8;
+
+static const vk::Format imageFormat = vk::Format::eR16G16B16A16Sfloat;
+
+static vk::ImageMemoryBarrier2 makeImageBarrier(vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+    vk::PipelineStageFlags2 srcStageMask, vk::AccessFlags2 srcAccessMask, vk::PipelineStageFlags2 dstStageMask, vk::AccessFlags2 dstAccessMask) {
+    vk::ImageMemoryBarrier2 barrier{};
+    barrier.image = image;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcStageMask = srcStageMask;
+    barrier.srcAccessMask = srcAccessMask;
+    barrier.dstStageMask = dstStageMask;
+    barrier.dstAccessMask = dstAccessMask;
+    barrier.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+    return barrier;
+}
+
+static void recordImageBarriers(const vk::raii::CommandBuffer& cmd, const std::vector<vk::ImageMemoryBarrier2>& barriers) {
+    vk::DependencyInfo dependencyInfo{};
+    dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+    dependencyInfo.pImageMemoryBarriers = barriers.data();
+    cmd.pipelineBarrier2(dependencyInfo);
+}
+
+SpatialUpscaler::SpatialUpscaler(RHI& rhi, const std::vector<vk::ImageView>& inputViews, vk::Extent2D outputExtent) :
+    m_rhi(rhi),
+    m_outputExtent(outputExtent),
+    m_easuPipeline(nullptr),
+    m_rcasPipeline(nullptr)
+{
+    if (inputViews.size() != m_rhi.getMaxFramesInFlight()) {
+        throw std::runtime_error("upscaler needs an input for every frame in flight!");
+    }
+
+    m_constants.outputSize = m_outputExtent;
+    setSharpness(0.2f);
+
+    createImages();
+    createPipelines();
+    createDescriptorSets(inputViews);
+}
+
+void SpatialUpscaler::setSharpness(float stops)
+{
+    m_constants.sharpness = std::exp2(-std::max(stops, 0.0f));
+}
+
+void SpatialUpscaler::createImages()
+{
+    vk::ImageCreateInfo imageInfo{};
+    imageInfo.imageType = vk::ImageType::e2D;
+    imageInfo.format = imageFormat;
+    imageInfo.extent.width = m_outputExtent.width;
+    imageInfo.extent.height = m_outputExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+
+    m_easuImages.reserve(m_rhi.getMaxFramesInFlight());
+    m_outputImages.reserve(m_rhi.getMaxFramesInFlight());
+    for (uint32_t i = 0; i < m_rhi.getMaxFramesInFlight(); i++) {
+        m_easuImages.emplace_back(m_rhi.createImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTarget));
+        m_outputImages.emplace_back(m_rhi.createImage(imageInfo, vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTarget));
+    }
+}
+
+void SpatialUpscaler::createPipelines()
+{
+    ComputePipelineCreateInfo createInfo{};
+    createInfo.descriptorSetLayoutBindings = {
+        { 0, vk::DescriptorType::eSampledImage, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+        { 1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+    };
+    createInfo.pushConstantSize = sizeof(Constants);
+
+    createInfo.name = "upscale easu";
+    createInfo.shader = { "Shaders/upscale_easu.comp.hlsl", vk::ShaderStageFlagBits::eCompute };
+    m_easuPipeline = m_rhi.createComputePipeline(createInfo);
+
+    createInfo.name = "upscale rcas";
+    createInfo.shader = { "Shaders/upscale_rcas.comp.hlsl", vk::ShaderStageFlagBits::eCompute };
+    m_rcasPipeline = m_rhi.createComputePipeline(createInfo);
+}
+
+void SpatialUpscaler::createDescriptorSets(const std::vector<vk::ImageView>& inputViews)
+{
+    auto frameCount = m_rhi.getMaxFramesInFlight();
+
+    std::vector<std::vector<vk::DescriptorImageInfo>> inputInfos(frameCount);
+    std::vector<std::vector<vk::DescriptorImageInfo>> easuSampledInfos(frameCount);
+    std::vector<std::vector<vk::DescriptorImageInfo>> easuStorageInfos(frameCount);
+    std::vector<std::vector<vk::DescriptorImageInfo>> outputInfos(frameCount);
+    for (size_t i = 0; i < frameCount; i++) {
+        inputInfos[i] = { { nullptr, inputViews[i], vk::ImageLayout::eShaderReadOnlyOptimal } };
+        easuSampledInfos[i] = { { nullptr, *m_easuImages[i].getImageView(), vk::ImageLayout::eShaderReadOnlyOptimal } };
+        easuStorageInfos[i] = { { nullptr, *m_easuImages[i].getImageView(), vk::ImageLayout::eGeneral } };
+        outputInfos[i] = { { nullptr, *m_outputImages[i].getImageView(), vk::ImageLayout::eGeneral } };
+    }
+
+    std::vector<DescriptorSetConfig> configs = {
+        {
+            *m_easuPipeline.getDescriptorSetLayout(),
+            {
+                { vk::DescriptorType::eSampledImage, inputInfos },
+                { vk::DescriptorType::eStorageImage, easuStorageInfos },
+            },
+            "upscale easu descriptor set"
+        },
+        {
+            *m_rcasPipeline.getDescriptorSetLayout(),
+            {
+                { vk::DescriptorType::eSampledImage, easuSampledInfos },
+                { vk::DescriptorType::eStorageImage, outputInfos },
+            },
+            "upscale rcas descriptor set"
+        },
+    };
+
+    auto sets = m_rhi.createDescriptorSets(configs);
+    m_easuDescriptorSets = std::move(sets[0]);
+    m_rcasDescriptorSets = std::move(sets[1]);
+}
+
+void SpatialUpscaler::record(const vk::raii::CommandBuffer& cmd, uint32_t frameIndex, vk::Extent2D inputExtent)
+{
+    m_constants.inputSize.width = std::clamp(inputExtent.width, 1u, m_outputExtent.width);
+    m_constants.inputSize.height = std::clamp(inputExtent.height, 1u, m_outputExtent.height);
+
+    auto easuImage = *m_easuImages[frameIndex];
+    auto outputImage = *m_outputImages[frameIndex];
+    auto computeStage = vk::PipelineStageFlagBits2::eComputeShader;
+
+    // both images are overwritten completely, only the reads of their last use have to finish
+    recordImageBarriers(cmd, {
+        makeImageBarrier(easuImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+            computeStage, vk::AccessFlagBits2::eNone, computeStage, vk::AccessFlagBits2::eShaderStorageWrite),
+        makeImageBarrier(outputImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+            vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eNone, computeStage, vk::AccessFlagBits2::eShaderStorageWrite),
+    });
+
+    dispatch(cmd, m_easuPipeline, m_easuDescriptorSets, frameIndex);
+
+    recordImageBarriers(cmd, {
+        makeImageBarrier(easuImage, vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+            computeStage, vk::AccessFlagBits2::eShaderStorageWrite, computeStage, vk::AccessFlagBits2::eShaderSampledRead),
+    });
+
+    dispatch(cmd, m_rcasPipeline, m_rcasDescriptorSets, frameIndex);
+
+    recordImageBarriers(cmd, {
+        makeImageBarrier(outputImage, vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+            computeStage, vk::AccessFlagBits2::eShaderStorageWrite, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead),
+    });
+}
+
+void SpatialUpscaler::dispatch(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const std::vector<DescriptorSet>& descriptorSets, uint32_t frameIndex) const
+{
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline.getPipelineLayout(), 0, *descriptorSets[frameIndex], nullptr);
+    cmd.pushConstants<Constants>(*pipeline.getPipelineLayout(), vk::ShaderStageFlagBits::eCompute, 0, m_constants);
+    cmd.dispatch((m_outputExtent.width + groupSize - 1) / groupSize, (m_outputExtent.height + groupSize - 1) / groupSize, 1);
+}
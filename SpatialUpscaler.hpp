@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include "DescriptorSet.hpp"
+#include "Image.hpp"
+#include "Pipeline.hpp"
+#include "RHI.hpp"
+
+namespace Gfx
+{
+	// Spatial upscaling after AMD FidelityFX Super Resolution 1: an edge-adaptive upsampling pass (EASU) followed
+	// by contrast-adaptive sharpening (RCAS), both compute shaders, see Shaders/upscale_*.comp.hlsl.
+	//
+	// - The input is the top left inputExtent texels of one sampled image per frame, so the render resolution
+	//   can change from frame to frame without reallocating anything
+	// - The output is an RGBA16F image per frame at the output extent. The input may be unbounded HDR colour,
+	//   RCAS sharpens it in a reversibly tonemapped space.
+	// - record() expects the input in shader-read-only layout, visible to compute shaders, and leaves the
+	//   output in shader-read-only layout, visible to fragment shaders
+	class SpatialUpscaler
+	{
+	public:
+		// inputViews: the image view of the input of every frame in flight
+		SpatialUpscaler(RHI& rhi, const std::vector<vk::ImageView>& inputViews, vk::Extent2D outputExtent);
+		SpatialUpscaler(const SpatialUpscaler&) = delete;
+
+		vk::Extent2D getOutputExtent() const { return m_outputExtent; }
+		const Image& getOutput(uint32_t frameIndex) const { return m_outputImages[frameIndex]; }
+
+		// RCAS strength in stops: 0 is the strongest, every stop halves it
+		void setSharpness(float stops);
+
+		void record(const vk::raii::CommandBuffer& cmd, uint32_t frameIndex, vk::Extent2D inputExtent);
+
+	private:
+		// Matches UpscaleConstants in Shaders/upscale.fxh
+		struct Constants
+		{
+			vk::Extent2D inputSize;
+			vk::Extent2D outputSize;
+			float sharpness;
+			uint32_t padding;
+		};
+
+		void createImages();
+		void createPipelines();
+		void createDescriptorSets(const std::vector<vk::ImageView>& inputViews);
+		void dispatch(const vk::raii::CommandBuffer& cmd, const Pipeline& pipeline, const std::vector<DescriptorSet>& descriptorSets, uint32_t frameIndex) const;
+
+	private:
+		RHI& m_rhi;
+		vk::Extent2D m_outputExtent;
+		Constants m_constants{};
+
+		std::vector<Image> m_easuImages{};
+		std::vector<Image> m_outputImages{};
+
+		Pipeline m_easuPipeline;
+		Pipeline m_rcasPipeline;
+
+		std::vector<DescriptorSet> m_easuDescriptorSets{};
+		std::vector<DescriptorSet> m_rcasDescriptorSets{};
+	};
+}
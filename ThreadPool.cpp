@@ -0,0 +1,60 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+using Gfx::ThreadPool;
+
+static thread_local bool workerThread = false;
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+
+    m_threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_jobs = {};
+    }
+    m_condition.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+bool ThreadPool::isWorkerThread()
+{
+    return workerThread;
+}
+
+void ThreadPool::workerLoop()
+{
+    workerThread = true;
+
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop();
+        }
+
+        // packaged_task captures exceptions into the future, so jobs never throw here
+        job();
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Gfx
+{
+	// Fixed-size pool of worker threads for background jobs (shader compilation, pipeline builds, ...).
+	// Jobs still queued when the pool is destroyed are dropped; their futures report a broken promise.
+	class ThreadPool
+	{
+	public:
+		// threadCount == 0 picks hardware concurrency minus one (the render thread), at least one
+		explicit ThreadPool(uint32_t threadCount = 0);
+		ThreadPool(const ThreadPool&) = delete;
+		~ThreadPool();
+
+		template<typename F>
+		std::future<std::invoke_result_t<std::decay_t<F>>> submit(F&& func)
+		{
+			using R = std::invoke_result_t<std::decay_t<F>>;
+
+			auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+			auto future = task->get_future();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_jobs.emplace([task]() { (*task)(); });
+			}
+			m_condition.notify_one();
+			return future;
+		}
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+		// Whether the calling thread is a worker of any pool. A job that waits on other jobs may starve the pool
+		// and deadlock, so code that can run on either side does such work inline on a worker.
+		static bool isWorkerThread();
+
+	private:
+		void workerLoop();
+
+	private:
+		std::vector<std::thread> m_threads;
+		std::queue<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stopping = false;
+	};
+}